@@ -0,0 +1,613 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+// headless benchmark for the wrapper layer, drives dNewtonWorld directly with a set of canonical scenes
+// and prints step time, the wrapper time around the newton update and memory for each one.
+//
+// NewtonBenchmark [-frames n] [-threads n] [-async] [-scene name] [-trace file] [-csv]
+//
+// wrapper time is the frame time minus the time newton reports for its own update, that is
+// force accumulators, callbacks, the command buffer and the transform pass.
+
+#include "stdafx.h"
+#include "dAlloc.h"
+#include "dNewtonBody.h"
+#include "dNewtonWorld.h"
+#include "dNewtonJoint.h"
+#include "dNewtonProfiler.h"
+#include "dNewtonCollision.h"
+#include "dNewtonJointHinge.h"
+#include "dNewtonJointBallAndSocket.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#define D_BENCHMARK_FPS				60.0f
+#define D_BENCHMARK_FRAMES			600
+#define D_BENCHMARK_WARMUP_FRAMES	30
+
+
+// small deterministic generator, so every run builds the same scenes
+class dBenchmarkRandom
+{
+	public:
+	dBenchmarkRandom(unsigned seed)
+		:m_seed(seed)
+	{
+	}
+
+	dFloat Get(dFloat minValue, dFloat maxValue)
+	{
+		m_seed = m_seed * 1664525u + 1013904223u;
+		return minValue + (maxValue - minValue) * dFloat(m_seed >> 8) / dFloat(1 << 24);
+	}
+
+	unsigned m_seed;
+};
+
+class dBenchmarkScene
+{
+	public:
+	dBenchmarkScene(const char* const name)
+		:m_name(name)
+	{
+	}
+
+	virtual ~dBenchmarkScene()
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world) = 0;
+
+	// called from the world update callback, before the step is handed to newton
+	virtual void OnUpdate(dFloat timestep)
+	{
+	}
+
+	// called between frames, the time goes to the query column and not to the step
+	virtual void OnQuery(dNewtonWorld* const world)
+	{
+	}
+
+	void Destroy(dNewtonWorld* const world)
+	{
+		world->WaitForUpdateToFinish();
+		for (size_t i = 0; i < m_joints.size(); i ++) {
+			m_joints[i]->Destroy();
+			delete m_joints[i];
+		}
+		for (size_t i = 0; i < m_bodies.size(); i ++) {
+			world->DestroyBody(m_bodies[i]);
+		}
+		for (size_t i = 0; i < m_collisions.size(); i ++) {
+			delete m_collisions[i];
+		}
+		m_joints.clear();
+		m_bodies.clear();
+		m_collisions.clear();
+	}
+
+	// the body takes over the shape, so every body gets its own collision wrapper
+	dNewtonDynamicBody* AddBody(dNewtonWorld* const world, dNewtonCollision* const collision, dFloat x, dFloat y, dFloat z, dFloat mass)
+	{
+		dMatrix matrix(dGetIdentityMatrix());
+		matrix.m_posit = dVector(x, y, z, 1.0f);
+		dNewtonDynamicBody* const body = new dNewtonDynamicBody(world, collision, matrix, mass);
+		m_collisions.push_back(collision);
+		m_bodies.push_back(body);
+		return body;
+	}
+
+	dNewtonDynamicBody* AddFloor(dNewtonWorld* const world, dFloat size)
+	{
+		return AddBody(world, new dNewtonCollisionBox(world, size, 1.0f, size), 0.0f, -0.5f, 0.0f, 0.0f);
+	}
+
+	const char* m_name;
+	std::vector<dNewtonBody*> m_bodies;
+	std::vector<dNewtonJoint*> m_joints;
+	std::vector<dNewtonCollision*> m_collisions;
+};
+
+// the world callbacks carry no user data
+static dBenchmarkScene* g_activeScene = NULL;
+
+static void OnBenchmarkUpdate(dFloat timestep)
+{
+	g_activeScene->OnUpdate(timestep);
+}
+
+static void OnBenchmarkTransformUpdate()
+{
+}
+
+
+class dBoxPyramidScene: public dBenchmarkScene
+{
+	public:
+	dBoxPyramidScene()
+		:dBenchmarkScene("box_pyramids")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		const int pyramidCount = 4;
+		const int baseCount = 20;
+		const dFloat size = 1.0f;
+
+		AddFloor(world, 200.0f);
+		for (int i = 0; i < pyramidCount; i ++) {
+			const dFloat z = (i - pyramidCount / 2) * 8.0f;
+			for (int row = 0; row < baseCount; row ++) {
+				const int count = baseCount - row;
+				const dFloat y = size * 0.5f + row * size;
+				for (int j = 0; j < count; j ++) {
+					const dFloat x = (j - count * 0.5f + 0.5f) * size * 1.01f;
+					AddBody(world, new dNewtonCollisionBox(world, size, size, size), x, y, z, 1.0f);
+				}
+			}
+		}
+	}
+};
+
+class dSleepingBodiesScene: public dBenchmarkScene
+{
+	public:
+	dSleepingBodiesScene()
+		:dBenchmarkScene("sleeping_10k")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		const int gridSize = 100;
+		const dFloat spacing = 2.0f;
+
+		AddFloor(world, gridSize * spacing + 10.0f);
+		for (int i = 0; i < gridSize; i ++) {
+			for (int j = 0; j < gridSize; j ++) {
+				const dFloat x = (i - gridSize / 2) * spacing;
+				const dFloat z = (j - gridSize / 2) * spacing;
+				dNewtonBody* const body = AddBody(world, new dNewtonCollisionBox(world, 1.0f, 1.0f, 1.0f), x, 0.5f, z, 1.0f);
+				body->SetSleepState(true);
+			}
+		}
+	}
+};
+
+class dRagdollPileScene: public dBenchmarkScene
+{
+	public:
+	dRagdollPileScene()
+		:dBenchmarkScene("ragdoll_piles")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		const int pileCount = 4;
+		const int ragdollsPerPile = 16;
+
+		AddFloor(world, 200.0f);
+		for (int i = 0; i < pileCount; i ++) {
+			const dFloat x = (i - pileCount / 2) * 6.0f;
+			for (int j = 0; j < ragdollsPerPile; j ++) {
+				AddRagdoll(world, x + (j & 1) * 0.3f, 2.0f + j * 2.2f, (j & 2) * 0.2f);
+			}
+		}
+	}
+
+	private:
+	class dPart
+	{
+		public:
+		int m_parent;
+		dFloat m_size[3];
+		dFloat m_posit[3];
+		dFloat m_pivot[3];
+		dFloat m_mass;
+	};
+
+	void AddRagdoll(dNewtonWorld* const world, dFloat x, dFloat y, dFloat z)
+	{
+		// torso, head and two segments per limb, the pivots are relative to the torso center
+		static const dPart parts[] = {
+			{ -1, { 0.60f, 0.80f, 0.30f }, { 0.00f, 0.00f, 0.0f }, { 0.00f, 0.00f, 0.0f }, 10.0f },
+			{ 0, { 0.30f, 0.30f, 0.30f }, { 0.00f, 0.60f, 0.0f }, { 0.00f, 0.42f, 0.0f }, 2.0f },
+			{ 0, { 0.40f, 0.15f, 0.15f }, { -0.52f, 0.30f, 0.0f }, { -0.31f, 0.30f, 0.0f }, 1.5f },
+			{ 2, { 0.40f, 0.12f, 0.12f }, { -0.94f, 0.30f, 0.0f }, { -0.73f, 0.30f, 0.0f }, 1.0f },
+			{ 0, { 0.40f, 0.15f, 0.15f }, { 0.52f, 0.30f, 0.0f }, { 0.31f, 0.30f, 0.0f }, 1.5f },
+			{ 4, { 0.40f, 0.12f, 0.12f }, { 0.94f, 0.30f, 0.0f }, { 0.73f, 0.30f, 0.0f }, 1.0f },
+			{ 0, { 0.18f, 0.45f, 0.18f }, { -0.18f, -0.64f, 0.0f }, { -0.18f, -0.41f, 0.0f }, 3.0f },
+			{ 6, { 0.15f, 0.45f, 0.15f }, { -0.18f, -1.11f, 0.0f }, { -0.18f, -0.88f, 0.0f }, 2.0f },
+			{ 0, { 0.18f, 0.45f, 0.18f }, { 0.18f, -0.64f, 0.0f }, { 0.18f, -0.41f, 0.0f }, 3.0f },
+			{ 8, { 0.15f, 0.45f, 0.15f }, { 0.18f, -1.11f, 0.0f }, { 0.18f, -0.88f, 0.0f }, 2.0f },
+		};
+		const int partCount = sizeof(parts) / sizeof(parts[0]);
+
+		dNewtonBody* bodies[partCount];
+		for (int i = 0; i < partCount; i ++) {
+			const dPart& part = parts[i];
+			dNewtonCollision* const collision = (i == 1) ?
+				(dNewtonCollision*) new dNewtonCollisionSphere(world, part.m_size[0] * 0.5f) :
+				(dNewtonCollision*) new dNewtonCollisionBox(world, part.m_size[0], part.m_size[1], part.m_size[2]);
+			bodies[i] = AddBody(world, collision, x + part.m_posit[0], y + part.m_posit[1], z + part.m_posit[2], part.m_mass);
+		}
+
+		for (int i = 1; i < partCount; i ++) {
+			const dPart& part = parts[i];
+
+			// the pivot matrix is local to the child body
+			dMatrix pivot(dGetIdentityMatrix());
+			pivot.m_posit = dVector(part.m_pivot[0] - part.m_posit[0], part.m_pivot[1] - part.m_posit[1], part.m_pivot[2] - part.m_posit[2], 1.0f);
+			m_joints.push_back(new dNewtonJointBallAndSocket(pivot, bodies[i]->GetBody(), bodies[part.m_parent]->GetBody()));
+		}
+	}
+};
+
+class dRaycastFanScene: public dBenchmarkScene
+{
+	public:
+	dRaycastFanScene()
+		:dBenchmarkScene("raycast_fans")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		dBenchmarkRandom random(1234);
+
+		AddFloor(world, 200.0f);
+		for (int i = 0; i < 2000; i ++) {
+			const dFloat x = random.Get(-60.0f, 60.0f);
+			const dFloat z = random.Get(-60.0f, 60.0f);
+			const dFloat sx = random.Get(0.5f, 3.0f);
+			const dFloat sy = random.Get(0.5f, 6.0f);
+			const dFloat sz = random.Get(0.5f, 3.0f);
+			AddBody(world, new dNewtonCollisionBox(world, sx, sy, sz), x, sy * 0.5f, z, 0.0f);
+		}
+		for (int i = 0; i < 200; i ++) {
+			const dFloat x = random.Get(-40.0f, 40.0f);
+			const dFloat z = random.Get(-40.0f, 40.0f);
+			AddBody(world, new dNewtonCollisionSphere(world, 0.5f), x, random.Get(8.0f, 20.0f), z, 1.0f);
+		}
+	}
+
+	virtual void OnQuery(dNewtonWorld* const world)
+	{
+		// four fans of rays sweeping the scene from a few meters above the ground
+		const int fanCount = 4;
+		const int raysPerFan = 256;
+		const dFloat length = 80.0f;
+		for (int i = 0; i < fanCount; i ++) {
+			const dFloat px = (i & 1) ? -30.0f : 30.0f;
+			const dFloat pz = (i & 2) ? -30.0f : 30.0f;
+			for (int j = 0; j < raysPerFan; j ++) {
+				const dFloat angle = 2.0f * dPi * j / raysPerFan;
+				const dFloat dx = length * dCos(angle);
+				const dFloat dz = length * dSin(angle);
+				world->Raycast(px, 2.0f, pz, px + dx, 0.5f, pz + dz, 0);
+			}
+		}
+	}
+};
+
+// the managed vehicle controller is not wired up in the wrapper yet, the convoy uses
+// box chassis on hinged sphere wheels, which loads the solver with the same joint count
+class dVehicleConvoyScene: public dBenchmarkScene
+{
+	public:
+	dVehicleConvoyScene()
+		:dBenchmarkScene("vehicle_convoys")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		const int laneCount = 8;
+		const int vehiclesPerLane = 16;
+
+		AddFloor(world, 400.0f);
+		for (int i = 0; i < laneCount; i ++) {
+			for (int j = 0; j < vehiclesPerLane; j ++) {
+				AddVehicle(world, (i - laneCount / 2) * 5.0f, 1.0f, (j - vehiclesPerLane / 2) * 7.0f);
+			}
+		}
+	}
+
+	virtual void OnUpdate(dFloat timestep)
+	{
+		for (size_t i = 0; i < m_chassis.size(); i ++) {
+			m_chassis[i]->AddForce(0.0f, 0.0f, 6000.0f);
+		}
+	}
+
+	private:
+	void AddVehicle(dNewtonWorld* const world, dFloat x, dFloat y, dFloat z)
+	{
+		dNewtonBody* const chassis = AddBody(world, new dNewtonCollisionBox(world, 2.0f, 0.8f, 4.0f), x, y + 0.6f, z, 1000.0f);
+		m_chassis.push_back(chassis);
+
+		for (int i = 0; i < 4; i ++) {
+			const dFloat wx = (i & 1) ? 1.2f : -1.2f;
+			const dFloat wz = (i & 2) ? 1.4f : -1.4f;
+			dNewtonBody* const wheel = AddBody(world, new dNewtonCollisionSphere(world, 0.4f), x + wx, y, z + wz, 40.0f);
+
+			// hinge pin along the wheel axle, the front axis of the pivot matrix
+			dMatrix pivot(dGetIdentityMatrix());
+			m_joints.push_back(new dNewtonJointHinge(pivot, wheel->GetBody(), chassis->GetBody()));
+		}
+	}
+
+	std::vector<dNewtonBody*> m_chassis;
+};
+
+class dHeightfieldDebrisScene: public dBenchmarkScene
+{
+	public:
+	dHeightfieldDebrisScene()
+		:dBenchmarkScene("heightfield_debris")
+	{
+	}
+
+	virtual void Build(dNewtonWorld* const world)
+	{
+		const int resolution = 129;
+		const dFloat size = 256.0f;
+
+		std::vector<dFloat> elevations(resolution * resolution);
+		for (int i = 0; i < resolution; i ++) {
+			for (int j = 0; j < resolution; j ++) {
+				const dFloat u = dFloat(i) / (resolution - 1);
+				const dFloat v = dFloat(j) / (resolution - 1);
+				elevations[i * resolution + j] = 4.0f * dSin(u * 6.0f * dPi) * dCos(v * 4.0f * dPi);
+			}
+		}
+
+		dNewtonCollision* const terrain = new dNewtonCollisionHeightField(world, &elevations[0], resolution, dVector(size, 1.0f, size, 0.0f));
+		AddBody(world, terrain, -size * 0.5f, 0.0f, -size * 0.5f, 0.0f);
+
+		dBenchmarkRandom random(4321);
+		for (int i = 0; i < 3000; i ++) {
+			const dFloat x = random.Get(-100.0f, 100.0f);
+			const dFloat y = random.Get(8.0f, 40.0f);
+			const dFloat z = random.Get(-100.0f, 100.0f);
+			dNewtonCollision* collision = NULL;
+			switch (i % 3)
+			{
+				case 0:
+					collision = new dNewtonCollisionBox(world, random.Get(0.3f, 1.5f), random.Get(0.3f, 1.5f), random.Get(0.3f, 1.5f));
+					break;
+				case 1:
+					collision = new dNewtonCollisionSphere(world, random.Get(0.2f, 0.8f));
+					break;
+				default:
+					collision = new dNewtonCollisionCylinder(world, 0.3f, 0.3f, random.Get(0.5f, 2.0f));
+					break;
+			}
+			AddBody(world, collision, x, y, z, 1.0f);
+		}
+	}
+};
+
+
+class dBenchmarkResult
+{
+	public:
+	const char* m_name;
+	int m_bodyCount;
+	int m_jointCount;
+	dFloat m_buildTime;
+	dFloat m_averageFrameTime;
+	dFloat m_worstFrameTime;
+	dFloat m_p95FrameTime;
+	dFloat m_averageUpdateTime;
+	dFloat m_averageWrapperTime;
+	dFloat m_averageQueryTime;
+	int m_averageContactJoints;
+	long long m_currentBytes;
+	long long m_peakBytes;
+	long long m_liveAllocations;
+};
+
+class dBenchmarkOptions
+{
+	public:
+	dBenchmarkOptions()
+		:m_sceneName(NULL)
+		,m_traceFileName(NULL)
+		,m_frames(D_BENCHMARK_FRAMES)
+		,m_threads(1)
+		,m_async(false)
+		,m_csv(false)
+	{
+	}
+
+	const char* m_sceneName;
+	const char* m_traceFileName;
+	int m_frames;
+	int m_threads;
+	bool m_async;
+	bool m_csv;
+};
+
+static void RunScene(dBenchmarkScene* const scene, const dBenchmarkOptions& options, dBenchmarkResult& result)
+{
+	dNewtonWorld* const world = new dNewtonWorld();
+	world->SetFrameRate(D_BENCHMARK_FPS);
+	world->SetThreadsCount(options.m_threads);
+	world->SetAsyncUpdate(options.m_async);
+	world->SetCallbacks(OnBenchmarkUpdate, OnBenchmarkTransformUpdate);
+	world->SetProfiling(true);
+	if (options.m_traceFileName) {
+		world->SetTracing(1 << 20);
+	}
+	g_activeScene = scene;
+
+	const dLong buildStart = dNewtonGetTimeInMicroseconds();
+	scene->Build(world);
+	world->WaitForUpdateToFinish();
+	const dLong buildEnd = dNewtonGetTimeInMicroseconds();
+
+	const dFloat timestep = 1.0f / D_BENCHMARK_FPS;
+	for (int i = 0; i < D_BENCHMARK_WARMUP_FRAMES; i ++) {
+		world->Update(timestep);
+	}
+
+	std::vector<dFloat> frameTimes;
+	frameTimes.reserve(options.m_frames);
+	double updateTime = 0.0;
+	double wrapperTime = 0.0;
+	double queryTime = 0.0;
+	long long contactJoints = 0;
+	for (int i = 0; i < options.m_frames; i ++) {
+		const dLong frameStart = dNewtonGetTimeInMicroseconds();
+		world->Update(timestep);
+		const dLong frameEnd = dNewtonGetTimeInMicroseconds();
+		scene->OnQuery(world);
+		const dLong queryEnd = dNewtonGetTimeInMicroseconds();
+
+		// in async mode the profile describes the step that just finished
+		const dNewtonStepProfile* const profile = (dNewtonStepProfile*)world->GetStepProfile();
+		const dFloat frameTime = dFloat(frameEnd - frameStart) * 0.001f;
+		frameTimes.push_back(frameTime);
+		updateTime += profile->m_updateTime;
+		wrapperTime += dMax(frameTime - profile->m_updateTime, dFloat(0.0f));
+		queryTime += dFloat(queryEnd - frameEnd) * 0.001f;
+		contactJoints += profile->m_contactJointCount;
+	}
+
+	const dNewtonMemoryStats* const memory = (dNewtonMemoryStats*)world->GetMemoryStats();
+	result.m_name = scene->m_name;
+	result.m_bodyCount = memory->m_bodyCount;
+	result.m_jointCount = memory->m_jointCount;
+	result.m_currentBytes = memory->m_currentBytes;
+	result.m_peakBytes = memory->m_peakBytes;
+	result.m_liveAllocations = memory->m_liveAllocations;
+	result.m_buildTime = dFloat(buildEnd - buildStart) * 0.001f;
+
+	const int frames = dMax(options.m_frames, 1);
+	double frameSum = 0.0;
+	for (size_t i = 0; i < frameTimes.size(); i ++) {
+		frameSum += frameTimes[i];
+	}
+	std::sort(frameTimes.begin(), frameTimes.end());
+	result.m_averageFrameTime = dFloat(frameSum / frames);
+	result.m_worstFrameTime = frameTimes.size() ? frameTimes.back() : 0.0f;
+	result.m_p95FrameTime = frameTimes.size() ? frameTimes[(frameTimes.size() * 95) / 100] : 0.0f;
+	result.m_averageUpdateTime = dFloat(updateTime / frames);
+	result.m_averageWrapperTime = dFloat(wrapperTime / frames);
+	result.m_averageQueryTime = dFloat(queryTime / frames);
+	result.m_averageContactJoints = int(contactJoints / frames);
+
+	if (options.m_traceFileName) {
+		char fileName[512];
+		sprintf(fileName, "%s_%s.json", options.m_traceFileName, scene->m_name);
+		world->SaveTrace(fileName);
+	}
+
+	scene->Destroy(world);
+	g_activeScene = NULL;
+	delete world;
+}
+
+static void PrintResult(const dBenchmarkResult& result, bool csv)
+{
+	const dFloat megaBytes = 1.0f / (1024.0f * 1024.0f);
+	if (csv) {
+		printf("%s,%d,%d,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%.3f,%.3f,%lld\n", result.m_name, result.m_bodyCount, result.m_jointCount,
+			result.m_buildTime, result.m_averageFrameTime, result.m_p95FrameTime, result.m_worstFrameTime, result.m_averageUpdateTime,
+			result.m_averageWrapperTime, result.m_averageQueryTime, result.m_averageContactJoints,
+			result.m_currentBytes * megaBytes, result.m_peakBytes * megaBytes, result.m_liveAllocations);
+	} else {
+		printf("%-20s %7d %6d %9.2f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8d %9.2f %9.2f\n", result.m_name, result.m_bodyCount, result.m_jointCount,
+			result.m_buildTime, result.m_averageFrameTime, result.m_p95FrameTime, result.m_worstFrameTime, result.m_averageUpdateTime,
+			result.m_averageWrapperTime, result.m_averageQueryTime, result.m_averageContactJoints,
+			result.m_currentBytes * megaBytes, result.m_peakBytes * megaBytes);
+	}
+	fflush(stdout);
+}
+
+static bool ParseOptions(int argc, char** argv, dBenchmarkOptions& options)
+{
+	for (int i = 1; i < argc; i ++) {
+		if (!strcmp(argv[i], "-frames") && (i + 1 < argc)) {
+			options.m_frames = dMax(atoi(argv[++ i]), 1);
+		} else if (!strcmp(argv[i], "-threads") && (i + 1 < argc)) {
+			options.m_threads = dMax(atoi(argv[++ i]), 1);
+		} else if (!strcmp(argv[i], "-scene") && (i + 1 < argc)) {
+			options.m_sceneName = argv[++ i];
+		} else if (!strcmp(argv[i], "-trace") && (i + 1 < argc)) {
+			options.m_traceFileName = argv[++ i];
+		} else if (!strcmp(argv[i], "-async")) {
+			options.m_async = true;
+		} else if (!strcmp(argv[i], "-csv")) {
+			options.m_csv = true;
+		} else {
+			printf("usage: %s [-frames n] [-threads n] [-async] [-scene name] [-trace file] [-csv]\n", argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	dBenchmarkOptions options;
+	if (!ParseOptions(argc, argv, options)) {
+		return 1;
+	}
+
+	dBoxPyramidScene pyramids;
+	dSleepingBodiesScene sleeping;
+	dRagdollPileScene ragdolls;
+	dRaycastFanScene raycasts;
+	dVehicleConvoyScene convoys;
+	dHeightfieldDebrisScene heightfield;
+	dBenchmarkScene* const scenes[] = { &pyramids, &sleeping, &ragdolls, &raycasts, &convoys, &heightfield };
+	const int sceneCount = sizeof(scenes) / sizeof(scenes[0]);
+
+	if (options.m_csv) {
+		printf("scene,bodies,joints,build_ms,frame_ms,p95_ms,worst_ms,newton_ms,wrapper_ms,query_ms,contact_joints,memory_mb,peak_mb,live_allocations\n");
+	} else {
+		printf("frames %d, threads %d, %s update, times in milliseconds per frame, memory in MB\n", options.m_frames, options.m_threads, options.m_async ? "async" : "sync");
+		printf("%-20s %7s %6s %9s %8s %8s %8s %8s %8s %8s %8s %9s %9s\n", "scene", "bodies", "joints", "build", "frame", "p95", "worst", "newton", "wrapper", "query", "contacts", "memory", "peak");
+	}
+
+	int runCount = 0;
+	for (int i = 0; i < sceneCount; i ++) {
+		if (options.m_sceneName && strcmp(options.m_sceneName, scenes[i]->m_name)) {
+			continue;
+		}
+		dBenchmarkResult result;
+		RunScene(scenes[i], options, result);
+		PrintResult(result, options.m_csv);
+		runCount ++;
+	}
+
+	if (!runCount) {
+		printf("unknown scene %s\n", options.m_sceneName);
+		return 1;
+	}
+	return 0;
+}
@@ -79,12 +79,66 @@ public class NewtonBody: MonoBehaviour
 
     public virtual void InitRigidBody()
     {
-        CreateBodyAndCollision();
+        int sceneID = Utils.HierarchyHash(transform);
+        m_body = TakeSerializedBody(sceneID);
+        if (m_body == null)
+        {
+            CreateBodyAndCollision();
+            SetBodyProperties();
+        }
+        FinishRigidBody(sceneID);
+    }
+
+    // NewtonWorld builds the plain bodies of a scene with one dNewtonWorld::CreateBodies call.
+    // returns true when the descriptor was filled, otherwise the body was initialized on its own
+    internal virtual bool AddToBatch(ref NewtonBodyDesc desc)
+    {
+        int sceneID = Utils.HierarchyHash(transform);
+        m_body = TakeSerializedBody(sceneID);
+        if (m_body != null)
+        {
+            FinishRigidBody(sceneID);
+            return false;
+        }
+
+        m_collision = new NewtonBodyCollision(this);
+        desc.matrix = Matrix4x4.TRS(transform.position, transform.rotation, Vector3.one);
+        desc.velocity = Vector3.zero;
+        desc.omega = Vector3.zero;
+        desc.mass = m_mass;
+        desc.kinematic = 0;
+        desc.collision = dNewtonCollision.getCPtr(m_collision.GetShape()).Handle;
+        return true;
+    }
+
+    // takes the body CreateBodies built for the descriptor filled by AddToBatch
+    internal void InitBatchedBody(IntPtr body)
+    {
+        m_body = WrapBatchedBody(body);
+        SetBodyProperties();
+        FinishRigidBody(Utils.HierarchyHash(transform));
+    }
+
+    protected virtual dNewtonBody WrapBatchedBody(IntPtr body)
+    {
+        return new dNewtonDynamicBody(body, true);
+    }
 
+    void SetBodyProperties()
+    {
         SetCenterOfMass();
 
         m_body.SetLinearDamping(m_linearDamping);
         m_body.SetAngularDamping(m_angularDamping.x, m_angularDamping.y, m_angularDamping.z);
+    }
+
+    void FinishRigidBody(int sceneID)
+    {
+        m_body.SetSceneID(sceneID);
+        if (m_networkID >= 0)
+        {
+            m_body.SetNetworkID(m_networkID);
+        }
 
         var handle = GCHandle.Alloc(this);
         m_body.SetUserData(GCHandle.ToIntPtr(handle));
@@ -99,12 +153,20 @@ public class NewtonBody: MonoBehaviour
 
     public virtual void DestroyRigidBody()
     {
+        // streamed chunks live in the scene shape of the body, they have to leave before it goes
+        NewtonWorldPartition partition = GetComponent<NewtonWorldPartition>();
+        if (partition != null)
+        {
+            partition.DestroyPartition();
+        }
+
         if (m_body != null)
         {
             var handle = GCHandle.FromIntPtr(m_body.GetUserData());
             handle.Free();
 
-            m_body.Dispose();
+            // the world defers the delete while a step is in flight
+            m_world.GetWorld().DestroyBody(m_body);
             m_body = null;
         }
 
@@ -120,6 +182,77 @@ public class NewtonBody: MonoBehaviour
         return m_body;
     }
 
+    // the NewtonBody handle joints are built on, a body created during a step only exists
+    // after the step, so this is the one place that waits for the update to finish
+    public IntPtr GetNewtonBody()
+    {
+        if (m_body.IsPending())
+        {
+            m_world.GetWorld().WaitForUpdateToFinish();
+        }
+        return m_body.GetBody();
+    }
+
+    // splits the compound body in one native call, childGroups has a group per compound child, see
+    // dNewtonWorld::FractureBody. fragments[i] takes over the body made of group i + 1, it is placed
+    // on this body and needs no colliders. returns how many fragments got a body
+    public int Fracture(int[] childGroups, NewtonBody[] fragments)
+    {
+        if (m_body == null)
+        {
+            return 0;
+        }
+
+        dNewtonWorld world = m_world.GetWorld();
+        GCHandle groupsHandle = GCHandle.Alloc(childGroups, GCHandleType.Pinned);
+        world.FractureBody(m_body, groupsHandle.AddrOfPinnedObject(), childGroups.Length);
+        groupsHandle.Free();
+
+        int count = 0;
+        for (int i = 0; i < fragments.Length; i++)
+        {
+            dNewtonBody body = world.TakeFracturedBody(i + 1);
+            if (body == null)
+            {
+                continue;
+            }
+            if (fragments[i] == null)
+            {
+                world.DestroyBody(body);
+                continue;
+            }
+            fragments[i].transform.position = transform.position;
+            fragments[i].transform.rotation = transform.rotation;
+            fragments[i].AdoptBody(m_world, body);
+            count++;
+        }
+        world.ReleaseFracturedBodies();
+        return count;
+    }
+
+    // takes over a body the native side built with its shapes, as a fracture fragment
+    public void AdoptBody(NewtonWorld world, dNewtonBody body)
+    {
+        if (m_world != null)
+        {
+            m_world.UnregisterBody(this);
+        }
+        DestroyRigidBody();
+
+        m_world = world;
+        m_body = body;
+        m_body.SetSceneID(Utils.HierarchyHash(transform));
+        if (m_networkID >= 0)
+        {
+            m_body.SetNetworkID(m_networkID);
+        }
+
+        var handle = GCHandle.Alloc(this);
+        m_body.SetUserData(GCHandle.ToIntPtr(handle));
+
+        m_world.RegisterBody(this);
+    }
+
     public void CalculateBuoyancyForces(Vector4 plane, ref Vector3 force, ref Vector3 torque, float bodyDensity)
     {
         if(m_body != null)
@@ -328,6 +461,12 @@ public class NewtonBody: MonoBehaviour
         }
     }
 
+    // a body loaded from a serialized scene comes with its shapes built, it owns its collision
+    protected virtual dNewtonBody TakeSerializedBody(int sceneID)
+    {
+        return m_world.GetWorld().TakeSerializedBody(sceneID);
+    }
+
     protected virtual void CreateBodyAndCollision()
     {
         m_collision = new NewtonBodyCollision(this);
@@ -345,6 +484,7 @@ public class NewtonBody: MonoBehaviour
     public Vector3 m_torqueAcc { get; set; }
     public float m_linearDamping = 0.1f;
     public Vector3 m_angularDamping = new Vector3(0.1f, 0.1f, 0.1f);
+    public int m_networkID = -1;
 
     internal dNewtonBody m_body = null;
     internal NewtonBodyCollision m_collision = null;
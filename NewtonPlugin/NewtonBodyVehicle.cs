@@ -54,6 +54,19 @@ class NewtonBodyVehicle: NewtonBody
         m_body = new dNewtonVehicle(m_world.GetWorld(), m_collision.GetShape(), Utils.ToMatrix(transform.position, transform.rotation), m_mass);
     }
 
+    // vehicles are not saved with the scene
+    protected override dNewtonBody TakeSerializedBody(int sceneID)
+    {
+        return null;
+    }
+
+    // vehicles build their own controller, they never go in the scene batch
+    internal override bool AddToBatch(ref NewtonBodyDesc desc)
+    {
+        InitRigidBody();
+        return false;
+    }
+
     public override void InitRigidBody()
     {
         Debug.Log("init vehicle");
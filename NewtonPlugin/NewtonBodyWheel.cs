@@ -75,6 +75,12 @@ class NewtonBodyWheel: NewtonBody
         m_wheel = null;
     }
 
+    internal override bool AddToBatch(ref NewtonBodyDesc desc)
+    {
+        InitRigidBody();
+        return false;
+    }
+
     public override void InitRigidBody()
     {
         if (m_owner == null)
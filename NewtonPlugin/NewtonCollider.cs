@@ -94,6 +94,50 @@ abstract public class NewtonCollider: MonoBehaviour
         return false;
     }
 
+    // cooking serializes the built shape, loading it skips building meshes and hulls again at level load.
+    // the bytes are kept with the collider and must be cooked again when the source data changes
+    public bool CookShape(NewtonWorld world)
+    {
+        m_cookedShape = null;
+        dNewtonCollision shape = Create(world);
+        if (shape == null)
+        {
+            return false;
+        }
+
+        byte[] data = new byte[shape.Cook(IntPtr.Zero, 0)];
+        GCHandle handle = GCHandle.Alloc(data, GCHandleType.Pinned);
+        int size = shape.Cook(handle.AddrOfPinnedObject(), data.Length);
+        handle.Free();
+        shape.Dispose();
+
+        if (size == 0)
+        {
+            return false;
+        }
+        m_cookedShape = data;
+        return true;
+    }
+
+    // returns null when there is no cooked shape or it was cooked by another newton build
+    protected dNewtonCollision CreateCookedShape(NewtonWorld world)
+    {
+        if ((m_cookedShape == null) || (m_cookedShape.Length == 0))
+        {
+            return null;
+        }
+
+        GCHandle handle = GCHandle.Alloc(m_cookedShape, GCHandleType.Pinned);
+        dNewtonCollision collision = new dNewtonCollisionCooked(world.GetWorld(), handle.AddrOfPinnedObject(), m_cookedShape.Length);
+        handle.Free();
+        if (collision.IsValid() == false)
+        {
+            collision.Dispose();
+            collision = null;
+        }
+        return collision;
+    }
+
     public virtual  Vector3 GetScale()
     {
         Vector3 scale = m_scale;
@@ -198,6 +242,8 @@ abstract public class NewtonCollider: MonoBehaviour
     public bool m_isTrigger = false;
     public bool m_showGizmo = true;
     public bool m_inheritTransformScale = true;
+    [HideInInspector]
+    public byte[] m_cookedShape = null;
 
     // Reuse the same buffer for debug display
     static Vector3 m_lineP0 = Vector3.zero;
@@ -20,6 +20,36 @@
 
 using UnityEngine;
 using System;
+using System.Runtime.InteropServices;
+
+// same layout as dNewtonCompoundChild, see there for the params of each shape type
+[StructLayout(LayoutKind.Sequential)]
+public struct NewtonCompoundChild
+{
+    public void SetMatrix(Vector3 posit, Quaternion rotation)
+    {
+        dMatrix matrix = Utils.ToMatrix(posit, rotation);
+        dVector[] rows = { matrix.m_front, matrix.m_up, matrix.m_right, matrix.m_posit };
+        m_matrix = new float[16];
+        for (int i = 0; i < 4; i++)
+        {
+            m_matrix[i * 4 + 0] = rows[i].m_x;
+            m_matrix[i * 4 + 1] = rows[i].m_y;
+            m_matrix[i * 4 + 2] = rows[i].m_z;
+            m_matrix[i * 4 + 3] = rows[i].m_w;
+        }
+    }
+
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 16)]
+    public float[] m_matrix;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+    public float[] m_params;
+    [MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)]
+    public float[] m_scale;
+    public int m_shapeType;
+    public int m_materialID;
+    public int m_layer;
+}
 
 public class NewtonCompoundCollider: NewtonCollider
 {
@@ -30,4 +60,40 @@ public class NewtonCompoundCollider: NewtonCollider
         SetLayer(collider);
         return collider;
     }
+
+    // builds all children with one native call instead of a wrapper and a call per child,
+    // hull children index points, three floats per point. returns how many were added
+    static public int AddChildren(dNewtonCollisionCompound compound, NewtonCompoundChild[] children, float[] points)
+    {
+        int size = Marshal.SizeOf(typeof(NewtonCompoundChild));
+        IntPtr childrenPtr = Marshal.AllocHGlobal(size * children.Length);
+        for (int i = 0; i < children.Length; i++)
+        {
+            Marshal.StructureToPtr(children[i], new IntPtr(childrenPtr.ToInt64() + i * size), false);
+        }
+
+        int pointCount = (points != null) ? points.Length / 3 : 0;
+        GCHandle pointsHandle = GCHandle.Alloc((points != null) ? points : new float[0], GCHandleType.Pinned);
+        int added = compound.AddCollisions(childrenPtr, children.Length, pointsHandle.AddrOfPinnedObject(), pointCount);
+        pointsHandle.Free();
+        Marshal.FreeHGlobal(childrenPtr);
+        return added;
+    }
+
+    // reads every child back with two native calls
+    static public NewtonCompoundChild[] GetChildren(dNewtonCollisionCompound compound)
+    {
+        int count = compound.GetChildCount();
+        int size = Marshal.SizeOf(typeof(NewtonCompoundChild));
+        IntPtr childrenPtr = Marshal.AllocHGlobal(size * Math.Max(count, 1));
+        count = Math.Min(count, compound.GetChildren(childrenPtr, count));
+
+        NewtonCompoundChild[] children = new NewtonCompoundChild[count];
+        for (int i = 0; i < count; i++)
+        {
+            children[i] = (NewtonCompoundChild)Marshal.PtrToStructure(new IntPtr(childrenPtr.ToInt64() + i * size), typeof(NewtonCompoundChild));
+        }
+        Marshal.FreeHGlobal(childrenPtr);
+        return children;
+    }
 }
@@ -37,6 +37,14 @@ public class NewtonConvexHullCollider : NewtonCollider
             return null;
         }
 
+        dNewtonCollision cooked = CreateCookedShape(world);
+        if (cooked != null)
+        {
+            SetMaterial(cooked);
+            SetLayer(cooked);
+            return cooked;
+        }
+
         float[] array = new float[3 * m_mesh.vertices.Length];
         for (int i = 0; i < m_mesh.vertices.Length; i ++)
         {
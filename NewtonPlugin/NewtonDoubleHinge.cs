@@ -30,8 +30,8 @@ public class NewtonDoubleHinge : NewtonJoint
     {
         NewtonBody child = GetComponent<NewtonBody>();
         dMatrix matrix = Utils.ToMatrix(m_posit, Quaternion.Euler(m_rotation));
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        m_joint = new dNewtonJointDoubleHinge(matrix, child.GetBody().GetBody(), otherBody);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        m_joint = new dNewtonJointDoubleHinge(matrix, child.GetNewtonBody(), otherBody);
 
         Stiffness = m_stiffness;
         EnableLimits_0 = m_enableLimits_0;
@@ -174,8 +174,8 @@ public class NewtonDoubleHingeActuator : NewtonJoint
     {
         NewtonBody child = GetComponent<NewtonBody>();
         dMatrix matrix = Utils.ToMatrix(m_posit, Quaternion.Euler(m_rotation));
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        m_joint = new dNewtonJointDoubleHingeActuator(matrix, child.GetBody().GetBody(), otherBody);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        m_joint = new dNewtonJointDoubleHingeActuator(matrix, child.GetNewtonBody(), otherBody);
 
         TargetAngle0 = m_targetAngle0;
         AngularRate0 = m_angularRate0;
@@ -37,11 +37,11 @@ public class NewtonGear: NewtonJoint
         Vector4 parentPin = localMatrix1.GetColumn(0);
 
         NewtonBody child = GetComponent<NewtonBody>();
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
 
         dVector childPin_ = new dVector(childPin.x, childPin.y, childPin.z, 0.0f);
         dVector parentPin_ = new dVector(parentPin.x, parentPin.y, parentPin.z, 0.0f);
-        m_joint = new dNewtonJointGear(m_gearRatio, childPin_, parentPin_, child.GetBody().GetBody(), otherBody);
+        m_joint = new dNewtonJointGear(m_gearRatio, childPin_, parentPin_, child.GetNewtonBody(), otherBody);
     }
 
     void OnDrawGizmosSelected()
@@ -90,14 +90,14 @@ public class NewtonDifferentialGear : NewtonJoint
         Vector4 referencePin = localMatrix2.GetColumn(0);
 
         NewtonBody child = GetComponent<NewtonBody>();
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        IntPtr referenceBody = (m_referenceBody != null) ? m_referenceBody.GetBody().GetBody() : new IntPtr(0);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        IntPtr referenceBody = (m_referenceBody != null) ? m_referenceBody.GetNewtonBody() : new IntPtr(0);
 
         dVector dChildPin = new dVector(childPin.x, childPin.y, childPin.z, 0.0f);
         dVector dParentPin = new dVector(parentPin.x, parentPin.y, parentPin.z, 0.0f);
         dVector dReferencePin = new dVector(referencePin.x, referencePin.y, referencePin.z, 0.0f);
 
-        m_joint = new dNewtonJointDifferentialGear(m_gearRatio, dChildPin, dParentPin, dReferencePin, child.GetBody().GetBody(), otherBody, referenceBody);
+        m_joint = new dNewtonJointDifferentialGear(m_gearRatio, dChildPin, dParentPin, dReferencePin, child.GetNewtonBody(), otherBody, referenceBody);
     }
 
     void OnDrawGizmosSelected()
@@ -59,36 +59,43 @@ class NewtonHeighfieldCollider: NewtonCollider
     public override dNewtonCollision Create(NewtonWorld world)
     {
         TerrainData data = m_terrain.terrainData;
-        //Debug.Log("xxxx  " + data.alphamapWidth + "   xxx  " + data.detailHeight);
-        //Debug.Log("xxxx  " + data.heightmapScale);
-        //Debug.Log("xxxx  " + data.size);
-
         int resolution = data.heightmapResolution;
-        dVector scale = new dVector(data.size.x, data.size.y, data.size.z, 0.0f);
 
         m_oldSize = data.size;
         m_oldResolution = resolution;
 
-        data.GetHeights(0, 0, resolution, resolution);
+        // unity heights are normalized, 16 bit samples keep that precision in half the memory of floats
+        ushort[] elevation = GetElevations(data);
+        m_elevationHash = HashElevations(elevation);
+        byte[] attributes = GetAttributes(data);
 
-        int hash = 0;
-        float elevationScale = data.size.y;
-        float[] elevation = new float [resolution * resolution];
-        for (int z = 0; z < resolution; z ++)
+        float verticalScale = data.size.y / 65535.0f;
+        float cellSizeX = data.size.x / (resolution - 1);
+        float cellSizeZ = data.size.z / (resolution - 1);
+        int format = (int)dNewtonCollisionHeightField.dElevationFormat.m_unsigned16;
+
+        GCHandle elevationHandle = GCHandle.Alloc(elevation, GCHandleType.Pinned);
+        GCHandle attributesHandle = GCHandle.Alloc(attributes, GCHandleType.Pinned);
+        GCHandle materialsHandle = GCHandle.Alloc(GetMaterialTable(), GCHandleType.Pinned);
+        IntPtr attributesPtr = (attributes.Length != 0) ? attributesHandle.AddrOfPinnedObject() : IntPtr.Zero;
+
+        dNewtonCollision collider = null;
+        bool deformable = m_deformable && IsSoleCollider();
+        if (UseTiles(resolution))
         {
-            for (int x = 0; x < resolution; x++)
-            {
-                float value = data.GetHeight(x, z);
-                elevation[z * resolution + x] = value;
-                hash = Utils.dRand((int)(elevationScale * value), hash);
-            }
+            dNewtonCollisionTiledHeightField tiled = new dNewtonCollisionTiledHeightField(world.GetWorld(), elevationHandle.AddrOfPinnedObject(), format, resolution, resolution, attributesPtr, verticalScale, cellSizeX, cellSizeZ, m_tileSize, deformable);
+            tiled.SetMaterialTable(materialsHandle.AddrOfPinnedObject(), m_layerMaterials.Length);
+            collider = tiled;
         }
-        m_elevationHash = hash;
-
-        IntPtr elevationPtr = Marshal.AllocHGlobal(resolution * resolution * Marshal.SizeOf(typeof(float)));
-        Marshal.Copy(elevation, 0, elevationPtr, elevation.Length);
-        dNewtonCollision collider = new dNewtonCollisionHeightField(world.GetWorld(), elevationPtr, resolution, scale);
-        Marshal.FreeHGlobal(elevationPtr);
+        else
+        {
+            dNewtonCollisionHeightField heightField = new dNewtonCollisionHeightField(world.GetWorld(), elevationHandle.AddrOfPinnedObject(), format, resolution, resolution, attributesPtr, verticalScale, cellSizeX, cellSizeZ, deformable);
+            heightField.SetMaterialTable(materialsHandle.AddrOfPinnedObject(), m_layerMaterials.Length);
+            collider = heightField;
+        }
+        materialsHandle.Free();
+        attributesHandle.Free();
+        elevationHandle.Free();
 
         SetDefualtParams();
         SetMaterial(collider);
@@ -96,20 +103,132 @@ class NewtonHeighfieldCollider: NewtonCollider
         return collider;
     }
 
-    private bool ElevationHasChanged ()
+    // one bulk read of the heightmap instead of a GetHeight call per sample
+    private ushort[] GetElevations(TerrainData data)
     {
-        TerrainData data = m_terrain.terrainData;
         int resolution = data.heightmapResolution;
-        float scale = data.size.y;
+        float[,] heights = data.GetHeights(0, 0, resolution, resolution);
+        ushort[] elevation = new ushort[resolution * resolution];
+        for (int z = 0; z < resolution; z++)
+        {
+            for (int x = 0; x < resolution; x++)
+            {
+                elevation[z * resolution + x] = (ushort)Mathf.RoundToInt(Mathf.Clamp01(heights[z, x]) * 65535.0f);
+            }
+        }
+        return elevation;
+    }
 
+    private int HashElevations(ushort[] elevation)
+    {
         int hash = 0;
+        for (int i = 0; i < elevation.Length; i++)
+        {
+            hash = Utils.dRand(elevation[i], hash);
+        }
+        return hash;
+    }
+
+    // every sample takes the strongest splat layer under it, the layer indexes m_layerMaterials.
+    // an empty array means the whole terrain uses the collider material
+    private byte[] GetAttributes(TerrainData data)
+    {
+        int layers = Math.Min(data.alphamapLayers, 256);
+        if ((m_layerMaterials.Length == 0) || (layers == 0))
+        {
+            return new byte[0];
+        }
+
+        int resolution = data.heightmapResolution;
+        int alphaWidth = data.alphamapWidth;
+        int alphaHeight = data.alphamapHeight;
+        float[,,] alphas = data.GetAlphamaps(0, 0, alphaWidth, alphaHeight);
+        byte[] attributes = new byte[resolution * resolution];
         for (int z = 0; z < resolution; z++)
         {
+            int az = z * (alphaHeight - 1) / (resolution - 1);
             for (int x = 0; x < resolution; x++)
             {
-                hash = Utils.dRand((int) (data.GetHeight(x, z) * scale), hash);
+                int ax = x * (alphaWidth - 1) / (resolution - 1);
+                int best = 0;
+                for (int i = 1; i < layers; i++)
+                {
+                    if (alphas[az, ax, i] > alphas[az, ax, best])
+                    {
+                        best = i;
+                    }
+                }
+                attributes[z * resolution + x] = (byte)best;
             }
         }
+        return attributes;
+    }
+
+    private int[] GetMaterialTable()
+    {
+        int[] table = new int[Math.Max(m_layerMaterials.Length, 1)];
+        for (int i = 0; i < m_layerMaterials.Length; i++)
+        {
+            table[i] = m_layerMaterials[i] ? m_layerMaterials[i].GetInstanceID() : 0;
+        }
+        return table;
+    }
+
+    // tiles make a scene shape, newton can not place it in a compound or another scene,
+    // so only the sole collider of a plain body is tiled
+    private bool UseTiles(int resolution)
+    {
+        return (m_tileSize > 0) && (m_tileSize < resolution - 1) && IsSoleCollider();
+    }
+
+    // a deformed shape may be rebuilt and swapped into its body, so it must be the body shape itself
+    private bool IsSoleCollider()
+    {
+        NewtonBody body = GetComponentInParent<NewtonBody>();
+        return (body != null) && (body.m_isScene == false) && (body.GetComponentsInChildren<NewtonCollider>().Length == 1);
+    }
+
+    // writes normalized heights laid out like TerrainData.SetHeights into the running collision, the terrain
+    // itself is not touched. returns false when the region left the height range and the shape was rebuilt,
+    // an edit made while the world steps asynchronously is applied at its next update and returns true
+    public bool UpdateRegion(int xBase, int zBase, float[,] heights)
+    {
+        NewtonBody body = GetComponentInParent<NewtonBody>();
+        if (!m_deformable || (body == null) || (body.m_collision == null))
+        {
+            return true;
+        }
+
+        int height = heights.GetLength(0);
+        int width = heights.GetLength(1);
+        float verticalSize = m_terrain.terrainData.size.y;
+        float[] elevation = new float[width * height];
+        for (int z = 0; z < height; z++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                elevation[z * width + x] = Mathf.Clamp01(heights[z, x]) * verticalSize;
+            }
+        }
+
+        bool inPlace = true;
+        GCHandle elevationHandle = GCHandle.Alloc(elevation, GCHandleType.Pinned);
+        dNewtonCollision shape = body.m_collision.GetShape();
+        if (shape is dNewtonCollisionTiledHeightField)
+        {
+            inPlace = ((dNewtonCollisionTiledHeightField)shape).UpdateRegion(xBase, zBase, width, height, elevationHandle.AddrOfPinnedObject());
+        }
+        else if (shape is dNewtonCollisionHeightField)
+        {
+            inPlace = ((dNewtonCollisionHeightField)shape).UpdateRegion(xBase, zBase, width, height, elevationHandle.AddrOfPinnedObject());
+        }
+        elevationHandle.Free();
+        return inPlace;
+    }
+
+    private bool ElevationHasChanged ()
+    {
+        int hash = HashElevations(GetElevations(m_terrain.terrainData));
         bool state = (hash != m_elevationHash);
         m_elevationHash = hash;
         return state;
@@ -131,6 +250,12 @@ class NewtonHeighfieldCollider: NewtonCollider
     }
 
     public Terrain m_terrain = null;
+    // cells per tile side, zero builds one heightfield
+    public int m_tileSize = 0;
+    // material of each terrain layer, contacts use the layer painted strongest under the contact
+    public NewtonMaterial[] m_layerMaterials = new NewtonMaterial[0];
+    // keeps the samples private to this collider so UpdateRegion can edit them at run time
+    public bool m_deformable = false;
     private int m_oldResolution = 0;
     private int m_elevationHash = 0;
     private Vector3 m_oldSize;
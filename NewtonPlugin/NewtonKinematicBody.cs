@@ -0,0 +1,64 @@
+﻿/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+using System;
+using UnityEngine;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+
+[DisallowMultipleComponent]
+[AddComponentMenu("Newton Physics/Kinematic Body")]
+public class NewtonKinematicBody: NewtonBody
+{
+    // drives the body so it reaches the pose after timestep seconds of simulation,
+    // the velocities are computed natively from the pose the body actually reached
+    public void MoveTo(Vector3 position, Quaternion rotation, float timestep)
+    {
+        if (m_body != null)
+        {
+            dNewtonKinematicBody body = (dNewtonKinematicBody)m_body;
+            body.MoveTo(position.x, position.y, position.z, rotation.w, rotation.x, rotation.y, rotation.z, timestep);
+        }
+    }
+
+    protected override void CreateBodyAndCollision()
+    {
+        m_collision = new NewtonBodyCollision(this);
+        m_body = new dNewtonKinematicBody(m_world.GetWorld(), m_collision.GetShape(), Utils.ToMatrix(transform.position, transform.rotation));
+    }
+
+    // the claimed body would only come back as a plain dNewtonBody proxy, so kinematic bodies are always rebuilt
+    protected override dNewtonBody TakeSerializedBody(int sceneID)
+    {
+        return null;
+    }
+
+    internal override bool AddToBatch(ref NewtonBodyDesc desc)
+    {
+        bool batched = base.AddToBatch(ref desc);
+        desc.kinematic = 1;
+        return batched;
+    }
+
+    protected override dNewtonBody WrapBatchedBody(IntPtr body)
+    {
+        return new dNewtonKinematicBody(body, true);
+    }
+}
@@ -31,12 +31,12 @@ public class NewtonPlane3DOF: NewtonJoint
         NewtonBody child = GetComponent<NewtonBody>();
         Matrix4x4 localMatrix = Matrix4x4.identity;
         localMatrix.SetTRS(m_posit, Quaternion.Euler(m_rotation), Vector3.one);
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
 
         Vector3 pin = localMatrix.GetColumn(0);
         dVector normal = new dVector(pin.x, pin.y, pin.z, 0.0f);
         dVector posit = new dVector(m_posit.x, m_posit.y, m_posit.z, 1.0f);
-        m_joint = new dNewtonJointPlane3DOF(posit, normal, child.GetBody().GetBody(), otherBody);
+        m_joint = new dNewtonJointPlane3DOF(posit, normal, child.GetNewtonBody(), otherBody);
         Stiffness = m_stiffness;
     }
 
@@ -64,12 +64,12 @@ public class NewtonPlane5DOF : NewtonJoint
         NewtonBody child = GetComponent<NewtonBody>();
         Matrix4x4 localMatrix = Matrix4x4.identity;
         localMatrix.SetTRS(m_posit, Quaternion.Euler(m_rotation), Vector3.one);
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
 
         Vector3 pin = localMatrix.GetColumn(0);
         dVector normal = new dVector(pin.x, pin.y, pin.z, 0.0f);
         dVector posit = new dVector(m_posit.x, m_posit.y, m_posit.z, 1.0f);
-        m_joint = new dNewtonJointPlane3DOF(posit, normal, child.GetBody().GetBody(), otherBody);
+        m_joint = new dNewtonJointPlane3DOF(posit, normal, child.GetNewtonBody(), otherBody);
         Stiffness = m_stiffness;
     }
 
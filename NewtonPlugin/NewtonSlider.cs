@@ -30,8 +30,8 @@ public class NewtonSlider: NewtonJoint
     {
         NewtonBody child = GetComponent<NewtonBody>();
         dMatrix matrix = Utils.ToMatrix(m_posit, Quaternion.Euler(m_rotation));
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        m_joint = new dNewtonJointSlider(matrix, child.GetBody().GetBody(), otherBody);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        m_joint = new dNewtonJointSlider(matrix, child.GetNewtonBody(), otherBody);
 
         Stiffness = m_stiffness;
         EnableLimits = m_enableLimits;
@@ -193,8 +193,8 @@ public class NewtonSliderActuator : NewtonJoint
     {
         NewtonBody child = GetComponent<NewtonBody>();
         dMatrix matrix = Utils.ToMatrix(m_posit, Quaternion.Euler(m_rotation));
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        m_joint = new dNewtonJointSliderActuator(matrix, child.GetBody().GetBody(), otherBody);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        m_joint = new dNewtonJointSliderActuator(matrix, child.GetNewtonBody(), otherBody);
 
         Speed = m_speed;
         MaxForce = m_maxForce;
@@ -31,8 +31,8 @@ public class NewtonJointSlidingHinge: NewtonJoint
         NewtonBody child = GetComponent<NewtonBody>();
 
         dMatrix matrix = Utils.ToMatrix(m_posit, Quaternion.Euler(m_rotation));
-        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetBody().GetBody() : new IntPtr(0);
-        m_joint = new dNewtonJointSlidingHinge(matrix, child.GetBody().GetBody(), otherBody);
+        IntPtr otherBody = (m_otherBody != null) ? m_otherBody.GetNewtonBody() : new IntPtr(0);
+        m_joint = new dNewtonJointSlidingHinge(matrix, child.GetNewtonBody(), otherBody);
 
         Stiffness = m_stiffness;
         EnableLimits = m_enableLimits;
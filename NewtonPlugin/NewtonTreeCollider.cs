@@ -45,6 +45,15 @@ public class NewtonTreeCollider : NewtonCollider
 
     public override dNewtonCollision Create(NewtonWorld world)
     {
+        dNewtonCollision shared = CreateSharedShape(world);
+        if (shared != null)
+        {
+            m_isTrigger = false;
+            SetMaterial(shared);
+            SetLayer(shared);
+            return shared;
+        }
+
         if (m_mesh == null)
         {
             return null;
@@ -54,7 +63,87 @@ public class NewtonTreeCollider : NewtonCollider
         {
             return null;
         }
+
+        m_isTrigger = false;
+        dNewtonCollision cooked = CreateCookedShape(world);
+        if (cooked != null)
+        {
+            SetMaterial(cooked);
+            SetLayer(cooked);
+            return cooked;
+        }
         
+        float[] points;
+        int[] indices;
+        int[] attributes;
+        GetMeshData(out points, out indices, out attributes);
+
+        // the whole mesh crosses to native code in one call
+        GCHandle pointsHandle = GCHandle.Alloc(points, GCHandleType.Pinned);
+        GCHandle indicesHandle = GCHandle.Alloc(indices, GCHandleType.Pinned);
+        GCHandle attributesHandle = GCHandle.Alloc(attributes, GCHandleType.Pinned);
+        dNewtonCollision collision = null;
+        if (UseChunkedBuild(attributes.Length))
+        {
+            collision = new dNewtonCollisionChunkedMesh(world.GetWorld(), pointsHandle.AddrOfPinnedObject(), points.Length / 3, indicesHandle.AddrOfPinnedObject(), indices.Length, attributesHandle.AddrOfPinnedObject(), m_trianglesPerChunk, m_optimize);
+        }
+        else
+        {
+            dNewtonCollisionMesh mesh = new dNewtonCollisionMesh(world.GetWorld());
+            mesh.BeginFace();
+            mesh.AddMesh(pointsHandle.AddrOfPinnedObject(), points.Length / 3, indicesHandle.AddrOfPinnedObject(), indices.Length, attributesHandle.AddrOfPinnedObject());
+            mesh.EndFace(m_optimize);
+            collision = mesh;
+        }
+        attributesHandle.Free();
+        indicesHandle.Free();
+        pointsHandle.Free();
+
+        m_isTrigger = false;
+        SetMaterial(collision);
+        SetLayer(collision);
+        return collision;
+    }
+
+    // the shared geometry file is mapped once per process, every world loading this collider uses the same memory.
+    // cooking writes the scaled mesh with the submesh index as the face attribute
+    public bool CookSharedGeometry()
+    {
+        if ((m_mesh == null) || string.IsNullOrEmpty(m_sharedGeometryFile))
+        {
+            return false;
+        }
+
+        float[] points;
+        int[] indices;
+        int[] attributes;
+        GetMeshData(out points, out indices, out attributes);
+
+        GCHandle pointsHandle = GCHandle.Alloc(points, GCHandleType.Pinned);
+        GCHandle indicesHandle = GCHandle.Alloc(indices, GCHandleType.Pinned);
+        GCHandle attributesHandle = GCHandle.Alloc(attributes, GCHandleType.Pinned);
+        bool cooked = dNewtonCollisionSharedMesh.CookMesh(m_sharedGeometryFile, pointsHandle.AddrOfPinnedObject(), points.Length / 3, indicesHandle.AddrOfPinnedObject(), attributesHandle.AddrOfPinnedObject(), attributes.Length);
+        attributesHandle.Free();
+        indicesHandle.Free();
+        pointsHandle.Free();
+        return cooked;
+    }
+
+    // large meshes are split in chunks built on the world threads. the result is a scene shape, newton
+    // can not place it in a compound or another scene, so only the sole collider of a plain body uses it
+    bool UseChunkedBuild(int triangleCount)
+    {
+        if ((m_trianglesPerChunk <= 0) || (triangleCount <= m_trianglesPerChunk * 2))
+        {
+            return false;
+        }
+        NewtonBody body = GetComponentInParent<NewtonBody>();
+        return (body != null) && (body.m_isScene == false) && (body.GetComponentsInChildren<NewtonCollider>().Length == 1);
+    }
+
+    // scaled vertex positions and the triangles of every submesh, the submesh index is the face attribute
+    void GetMeshData(out float[] points, out int[] indices, out int[] attributes)
+    {
         Vector3 scale = GetBaseScale();
         if (m_freezeScale == false)
         {
@@ -62,42 +151,41 @@ public class NewtonTreeCollider : NewtonCollider
         }
 
         Vector3[] vertices = m_mesh.vertices;
-        float[] triVertices = new float[3 * 3];
-        IntPtr floatsPtr = Marshal.AllocHGlobal(3 * 3 * Marshal.SizeOf(typeof(float)));
+        points = new float[vertices.Length * 3];
+        for (int i = 0; i < vertices.Length; i++)
+        {
+            points[i * 3 + 0] = vertices[i].x * scale.x;
+            points[i * 3 + 1] = vertices[i].y * scale.y;
+            points[i * 3 + 2] = vertices[i].z * scale.z;
+        }
 
-        dNewtonCollisionMesh collision = new dNewtonCollisionMesh(world.GetWorld());
-        collision.BeginFace();
-        for (int i = 0; i < m_mesh.subMeshCount; i++)
+        indices = m_mesh.triangles;
+        attributes = new int[indices.Length / 3];
+        for (int i = 0, face = 0; i < m_mesh.subMeshCount; i++)
         {
-            int[] submesh = m_mesh.GetTriangles(i);
-            for (int j = 0; j < submesh.Length; j += 3)
+            int faceCount = m_mesh.GetTriangles(i).Length / 3;
+            for (int j = 0; j < faceCount; j++)
             {
-                int k = submesh[j];
-                triVertices[0] = vertices[k].x * scale.x;
-                triVertices[1] = vertices[k].y * scale.y;
-                triVertices[2] = vertices[k].z * scale.z;
-
-                k = submesh[j + 1];
-                triVertices[3] = vertices[k].x * scale.x;
-                triVertices[4] = vertices[k].y * scale.y;
-                triVertices[5] = vertices[k].z * scale.z;
-
-                k = submesh[j + 2];
-                triVertices[6] = vertices[k].x * scale.x;
-                triVertices[7] = vertices[k].y * scale.y;
-                triVertices[8] = vertices[k].z * scale.z;
-
-                Marshal.Copy(triVertices, 0, floatsPtr, triVertices.Length);
-                collision.AddFace(3, floatsPtr, 3 * sizeof(float), i);
+                attributes[face++] = i;
             }
         }
+    }
 
-        collision.EndFace(m_optimize);
-        Marshal.FreeHGlobal(floatsPtr);
+    // returns null when no file is set or the file is missing or not valid, the collider then builds a tree mesh
+    dNewtonCollision CreateSharedShape(NewtonWorld world)
+    {
+        if (string.IsNullOrEmpty(m_sharedGeometryFile))
+        {
+            return null;
+        }
 
-        m_isTrigger = false;
-        SetMaterial(collision);
-        SetLayer(collision);
+        dNewtonCollision collision = new dNewtonCollisionSharedMesh(world.GetWorld(), m_sharedGeometryFile);
+        if (collision.IsValid() == false)
+        {
+            Debug.LogWarning("shared geometry " + m_sharedGeometryFile + " is missing or damaged, building a tree mesh instead");
+            collision.Dispose();
+            collision = null;
+        }
         return collision;
     }
 
@@ -112,5 +200,7 @@ public class NewtonTreeCollider : NewtonCollider
     public bool m_optimize = true;
     public bool m_rebuildMesh = false;
     public bool m_freezeScale = true;
+    public string m_sharedGeometryFile = "";
+    public int m_trianglesPerChunk = 16384;
 }
 
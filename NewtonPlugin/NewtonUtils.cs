@@ -36,6 +36,21 @@ public class Utils
     }
 
 
+    // stable between runs of the same scene, used to match bodies saved in a serialized scene
+    static public int HierarchyHash(Transform transform)
+    {
+        uint hash = 2166136261;
+        for (Transform node = transform; node != null; node = node.parent)
+        {
+            string name = node.name + "/" + node.GetSiblingIndex();
+            foreach (char c in name)
+            {
+                hash = (hash ^ c) * 16777619;
+            }
+        }
+        return (int)(hash & 0x7fffffff);
+    }
+
     static public int dRand(int seed, int oldSeed)
     {
         return oldSeed + seed * 31415821;
@@ -38,6 +38,18 @@ internal struct _InternalRayHitInfo
     internal uint collisionID;
 }
 
+// mirrors dNewtonBodyDesc, Matrix4x4 memory layout matches the newton matrix
+[StructLayout(LayoutKind.Sequential)]
+public struct NewtonBodyDesc
+{
+    public Matrix4x4 matrix;
+    public Vector3 velocity;
+    public Vector3 omega;
+    public float mass;
+    public int kinematic;
+    public IntPtr collision;
+}
+
 public struct NewtonRayHitInfo
 {
     public NewtonBody body;
@@ -48,6 +60,43 @@ public struct NewtonRayHitInfo
 
 }
 
+// mirrors dNewtonMemoryStats, the allocator counters are process wide, the per category bytes and the counts belong to the world
+[StructLayout(LayoutKind.Sequential)]
+public struct NewtonMemoryStats
+{
+    public long currentBytes;
+    public long peakBytes;
+    public long reservedBytes;
+    public long liveAllocations;
+    public long totalAllocations;
+    public long bodyBytes;
+    public long shapeBytes;
+    public long jointBytes;
+    public long solverBytes;
+    public int bodyCount;
+    public int shapeCount;
+    public int jointCount;
+    public int constraintCount;
+    public int contactCount;
+}
+
+// mirrors dNewtonStepProfile, times are in milliseconds
+[StructLayout(LayoutKind.Sequential)]
+public struct NewtonStepProfile
+{
+    public float frameTime;
+    public float forceCallbackTime;
+    public float waitTime;
+    public float updateTime;
+    public float transformCallbackTime;
+    public int stepCount;
+    public int bodyCount;
+    public int constraintCount;
+    public int contactJointCount;
+    public int islandCount;
+    public int islandBodyCount;
+}
+
 
 [DisallowMultipleComponent]
 [AddComponentMenu("Newton Physics/Newton World")]
@@ -64,12 +113,14 @@ public class NewtonWorld : MonoBehaviour
         m_onWorldBodyTransfromUpdateCallback = new OnWorldBodyTransfromUpdateCallback(OnBodyTransformUpdate);
 
         m_world.SetAsyncUpdate(m_asyncUpdate);
+        m_world.SetProfiling(m_profiling);
         m_world.SetFrameRate(m_updateRate);
         m_world.SetThreadsCount(m_numberOfThreads);
         m_world.SetSolverMode(m_solverIterationsCount);
         m_world.SetBroadPhase(m_broadPhaseType);
         m_world.SetGravity(m_gravity.x, m_gravity.y, m_gravity.z);
         m_world.SetSubSteps(m_subSteps);
+        m_world.SetDeterministic(m_deterministic);
         m_world.SetDefaultMaterial(m_defaultRestitution, m_defaultStaticFriction, m_defaultKineticFriction, true);
         m_world.SetCallbacks(m_onWorldCallback, m_onWorldBodyTransfromUpdateCallback);
         InitScene();
@@ -93,17 +144,44 @@ public class NewtonWorld : MonoBehaviour
         m_bodies.Remove(nb);
     }
 
-    private void InitPhysicsScene(GameObject root)
+    private void InitPhysicsScene(GameObject root, List<NewtonBody> batch, List<NewtonBodyDesc> descs)
     {
         NewtonBody bodyPhysics = root.GetComponent<NewtonBody>();
         if (bodyPhysics != null)
         {
-            bodyPhysics.InitRigidBody();
+            NewtonBodyDesc desc = new NewtonBodyDesc();
+            if (bodyPhysics.AddToBatch(ref desc))
+            {
+                batch.Add(bodyPhysics);
+                descs.Add(desc);
+            }
         }
 
         foreach (Transform child in root.transform)
         {
-            InitPhysicsScene(child.gameObject);
+            InitPhysicsScene(child.gameObject, batch, descs);
+        }
+    }
+
+    // one native call builds every body collected by InitPhysicsScene
+    private void CreateBatchBodies(List<NewtonBody> batch, List<NewtonBodyDesc> descs)
+    {
+        if (batch.Count == 0)
+        {
+            return;
+        }
+
+        NewtonBodyDesc[] descArray = descs.ToArray();
+        IntPtr[] bodies = new IntPtr[descArray.Length];
+        GCHandle descHandle = GCHandle.Alloc(descArray, GCHandleType.Pinned);
+        GCHandle bodiesHandle = GCHandle.Alloc(bodies, GCHandleType.Pinned);
+        m_world.CreateBodies(descHandle.AddrOfPinnedObject(), descArray.Length, bodiesHandle.AddrOfPinnedObject());
+        bodiesHandle.Free();
+        descHandle.Free();
+
+        for (int i = 0; i < batch.Count; i++)
+        {
+            batch[i].InitBatchedBody(bodies[i]);
         }
     }
 
@@ -135,11 +213,21 @@ public class NewtonWorld : MonoBehaviour
             }
         }
 
+        // bodies saved in the scene file are claimed by InitRigidBody instead of building their shapes again
+        if (m_loadSerializedScene && !m_world.LoadSerializedScene(m_loadSceneName))
+        {
+            Debug.LogWarning("could not load serialized scene " + m_loadSceneName);
+        }
+
         GameObject[] objectList = gameObject.scene.GetRootGameObjects();
+        List<NewtonBody> batch = new List<NewtonBody>();
+        List<NewtonBodyDesc> descs = new List<NewtonBodyDesc>();
         foreach (GameObject rootObj in objectList)
         {
-            InitPhysicsScene(rootObj);
+            InitPhysicsScene(rootObj, batch, descs);
         }
+        CreateBatchBodies(batch, descs);
+        m_world.ReleaseSerializedBodies();
 
         foreach (GameObject rootObj in objectList)
         {
@@ -185,8 +273,15 @@ public class NewtonWorld : MonoBehaviour
                 {
                     for (IntPtr contact = m_world.GetFirstContactJoint(bodyPhysics.m_body); contact != IntPtr.Zero; contact = m_world.GetNextContactJoint(bodyPhysics.m_body, contact))
                     {
-                        var body0 = (NewtonBody)GCHandle.FromIntPtr(m_world.GetBody0UserData(contact)).Target;
-                        var body1 = (NewtonBody)GCHandle.FromIntPtr(m_world.GetBody1UserData(contact)).Target;
+                        // bodies destroyed during the step no longer carry a managed handle
+                        IntPtr userData0 = m_world.GetBody0UserData(contact);
+                        IntPtr userData1 = m_world.GetBody1UserData(contact);
+                        if ((userData0 == IntPtr.Zero) || (userData1 == IntPtr.Zero))
+                        {
+                            continue;
+                        }
+                        var body0 = (NewtonBody)GCHandle.FromIntPtr(userData0).Target;
+                        var body1 = (NewtonBody)GCHandle.FromIntPtr(userData1).Target;
                         var otherBody = bodyPhysics == body0 ? body1 : body0;
                         script.OnCollision(otherBody);
 
@@ -254,10 +349,134 @@ public class NewtonWorld : MonoBehaviour
         return false;
     }
 
+    public NewtonMemoryStats GetMemoryStats()
+    {
+        return (NewtonMemoryStats)Marshal.PtrToStructure(m_world.GetMemoryStats(), typeof(NewtonMemoryStats));
+    }
+
+    public NewtonStepProfile GetStepProfile()
+    {
+        return (NewtonStepProfile)Marshal.PtrToStructure(m_world.GetStepProfile(), typeof(NewtonStepProfile));
+    }
+
+    // rollback snapshots, size the buffer with GetStateSize and keep one per frame to rewind to
+    public int GetStateSize()
+    {
+        return m_world.GetStateSize();
+    }
+
+    public int CaptureState(byte[] buffer)
+    {
+        GCHandle handle = GCHandle.Alloc(buffer, GCHandleType.Pinned);
+        try
+        {
+            return m_world.CaptureState(handle.AddrOfPinnedObject(), buffer.Length);
+        }
+        finally
+        {
+            handle.Free();
+        }
+    }
+
+    public bool RestoreState(byte[] buffer, int size)
+    {
+        GCHandle handle = GCHandle.Alloc(buffer, GCHandleType.Pinned);
+        try
+        {
+            return m_world.RestoreState(handle.AddrOfPinnedObject(), size);
+        }
+        finally
+        {
+            handle.Free();
+        }
+    }
+
+    // network replication, the server captures a snapshot per tick and sends each client the delta
+    // against the last snapshot that client acknowledged, a null baseline sends the full state
+    public void SetReplicationPrecision(float positionPrecision, float velocityPrecision)
+    {
+        m_world.SetReplicationPrecision(positionPrecision, velocityPrecision);
+    }
+
+    public int GetReplicationStateSize()
+    {
+        return m_world.GetReplicationStateSize();
+    }
+
+    public int CaptureReplicationState(byte[] snapshot)
+    {
+        GCHandle handle = GCHandle.Alloc(snapshot, GCHandleType.Pinned);
+        try
+        {
+            return m_world.CaptureReplicationState(handle.AddrOfPinnedObject(), snapshot.Length);
+        }
+        finally
+        {
+            handle.Free();
+        }
+    }
+
+    public int EncodeDelta(byte[] baseline, int baselineSize, byte[] snapshot, int snapshotSize, byte[] delta)
+    {
+        GCHandle baselineHandle = new GCHandle();
+        GCHandle snapshotHandle = GCHandle.Alloc(snapshot, GCHandleType.Pinned);
+        GCHandle deltaHandle = GCHandle.Alloc(delta, GCHandleType.Pinned);
+        try
+        {
+            IntPtr baselinePtr = IntPtr.Zero;
+            if (baseline != null)
+            {
+                baselineHandle = GCHandle.Alloc(baseline, GCHandleType.Pinned);
+                baselinePtr = baselineHandle.AddrOfPinnedObject();
+            }
+            return m_world.EncodeDelta(baselinePtr, baselineSize, snapshotHandle.AddrOfPinnedObject(), snapshotSize, deltaHandle.AddrOfPinnedObject(), delta.Length);
+        }
+        finally
+        {
+            if (baselineHandle.IsAllocated)
+            {
+                baselineHandle.Free();
+            }
+            snapshotHandle.Free();
+            deltaHandle.Free();
+        }
+    }
+
+    // client side, rebuilds the server snapshot into the snapshot buffer and moves the bodies to it
+    public int ApplyDelta(byte[] baseline, int baselineSize, byte[] delta, int deltaSize, byte[] snapshot)
+    {
+        GCHandle baselineHandle = new GCHandle();
+        GCHandle deltaHandle = GCHandle.Alloc(delta, GCHandleType.Pinned);
+        GCHandle snapshotHandle = GCHandle.Alloc(snapshot, GCHandleType.Pinned);
+        try
+        {
+            IntPtr baselinePtr = IntPtr.Zero;
+            if (baseline != null)
+            {
+                baselineHandle = GCHandle.Alloc(baseline, GCHandleType.Pinned);
+                baselinePtr = baselineHandle.AddrOfPinnedObject();
+            }
+            return m_world.ApplyDelta(baselinePtr, baselineSize, deltaHandle.AddrOfPinnedObject(), deltaSize, snapshotHandle.AddrOfPinnedObject(), snapshot.Length);
+        }
+        finally
+        {
+            if (baselineHandle.IsAllocated)
+            {
+                baselineHandle.Free();
+            }
+            deltaHandle.Free();
+            snapshotHandle.Free();
+        }
+    }
+
     private dNewtonWorld m_world = new dNewtonWorld();
     public bool m_asyncUpdate = true;
+    public bool m_profiling = false;
+    public bool m_deterministic = false;
     public bool m_serializeSceneOnce = false;
     public string m_saveSceneName = "scene_01.bin";
+    public bool m_loadSerializedScene = false;
+    public string m_loadSceneName = "scene_01.bin";
     public int m_broadPhaseType = 0;
     public int m_numberOfThreads = 0;
     public int m_solverIterationsCount = 1;
@@ -0,0 +1,109 @@
+﻿/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+using System;
+using UnityEngine;
+using System.Collections.Generic;
+
+[Serializable]
+public class NewtonPartitionChunk
+{
+    // a file cooked with NewtonTreeCollider.CookSharedGeometry or dNewtonCollisionSharedMesh
+    public string m_file = "";
+    public Bounds m_bounds;
+    public NewtonMaterial m_material = null;
+    public int m_layer = 0;
+}
+
+// streams static chunks in and out of a scene body around the focus transforms, the files
+// are read on a background thread and at most m_chunksPerUpdate chunks join the scene per frame
+[RequireComponent(typeof(NewtonBody))]
+[AddComponentMenu("Newton Physics/World Partition")]
+public class NewtonWorldPartition : MonoBehaviour
+{
+    void LateUpdate()
+    {
+        if (m_partition == null)
+        {
+            CreatePartition();
+            if (m_partition == null)
+            {
+                return;
+            }
+        }
+
+        m_partition.ClearFocusPoints();
+        foreach (Transform focus in m_focusPoints)
+        {
+            if (focus != null)
+            {
+                m_partition.AddFocusPoint(focus.position.x, focus.position.y, focus.position.z);
+            }
+        }
+        m_partition.Update();
+    }
+
+    void CreatePartition()
+    {
+        NewtonBody body = GetComponent<NewtonBody>();
+        if ((body.m_world == null) || (body.m_collision == null) || (body.m_isScene == false))
+        {
+            return;
+        }
+
+        dNewtonCollisionScene scene = (dNewtonCollisionScene)body.m_collision.GetShape();
+        m_partition = new dNewtonWorldPartition(body.m_world.GetWorld(), scene, m_loadRadius, m_unloadRadius, m_chunksPerUpdate);
+        foreach (NewtonPartitionChunk chunk in m_chunks)
+        {
+            Vector3 min = chunk.m_bounds.min;
+            Vector3 max = chunk.m_bounds.max;
+            int materialID = chunk.m_material ? chunk.m_material.GetInstanceID() : 0;
+            m_partition.AddChunk(chunk.m_file, new dVector(min.x, min.y, min.z, 0.0f), new dVector(max.x, max.y, max.z, 0.0f), materialID, chunk.m_layer);
+        }
+    }
+
+    // the body calls this before it destroys its scene shape
+    public void DestroyPartition()
+    {
+        if (m_partition != null)
+        {
+            m_partition.Dispose();
+            m_partition = null;
+        }
+    }
+
+    void OnDestroy()
+    {
+        DestroyPartition();
+    }
+
+    public bool IsChunkResident(int chunkIndex)
+    {
+        return (m_partition != null) && m_partition.IsChunkResident(chunkIndex);
+    }
+
+    public float m_loadRadius = 200.0f;
+    public float m_unloadRadius = 250.0f;
+    public int m_chunksPerUpdate = 2;
+    public List<Transform> m_focusPoints = new List<Transform>();
+    public List<NewtonPartitionChunk> m_chunks = new List<NewtonPartitionChunk>();
+
+    private dNewtonWorldPartition m_partition = null;
+}
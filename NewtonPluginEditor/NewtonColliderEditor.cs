@@ -68,6 +68,40 @@ public abstract class NewtonColliderEditor : Editor
         serializedObject.ApplyModifiedProperties();
     }
 
+    // cooked shapes are built with the world of the body owning the collider
+    protected void CookedShapeGUI()
+    {
+        NewtonCollider collider = (NewtonCollider)target;
+        bool cooked = (collider.m_cookedShape != null) && (collider.m_cookedShape.Length > 0);
+        EditorGUILayout.LabelField("Cooked Shape", cooked ? collider.m_cookedShape.Length + " bytes" : "none");
+
+        EditorGUILayout.BeginHorizontal();
+        if (GUILayout.Button("Cook Shape"))
+        {
+            NewtonBody body = collider.GetComponentInParent<NewtonBody>();
+            if ((body != null) && (body.m_world != null))
+            {
+                Undo.RecordObject(collider, "Cook Shape");
+                if (!collider.CookShape(body.m_world))
+                {
+                    Debug.LogWarning("could not cook the shape of " + collider.name);
+                }
+                EditorUtility.SetDirty(collider);
+            }
+            else
+            {
+                Debug.LogWarning("cooking needs a rigid body with a world");
+            }
+        }
+        if (cooked && GUILayout.Button("Clear"))
+        {
+            Undo.RecordObject(collider, "Clear Cooked Shape");
+            collider.m_cookedShape = null;
+            EditorUtility.SetDirty(collider);
+        }
+        EditorGUILayout.EndHorizontal();
+    }
+
     SerializedProperty m_showGizmoProp;
     SerializedProperty m_posProp;
     SerializedProperty m_rotProp;
@@ -308,6 +342,7 @@ public class NewtonConvexHullEditor : NewtonColliderEditor
 
         EditorGUILayout.PropertyField(m_meshProp, new GUIContent("Mesh"));
         Validate();
+        CookedShapeGUI();
     }
 
     protected override void Validate()
@@ -317,6 +352,7 @@ public class NewtonConvexHullEditor : NewtonColliderEditor
         if (collision.m_mesh != (Mesh)m_meshProp.objectReferenceValue)
         {
             serializedObject.ApplyModifiedProperties();
+            collision.m_cookedShape = null;
             collision.RecreateEditorShape();
             //Debug.Log("Convex mesh changed");
         }
@@ -335,6 +371,8 @@ public class NewtonTreeColliderEditor : NewtonColliderEditor
         m_optimizeProp = serializedObject.FindProperty("m_optimize");
         m_freezeTransformProp = serializedObject.FindProperty("m_freezeScale");
         m_rebuildMeshProp = serializedObject.FindProperty("m_rebuildMesh");
+        m_sharedGeometryFileProp = serializedObject.FindProperty("m_sharedGeometryFile");
+        m_trianglesPerChunkProp = serializedObject.FindProperty("m_trianglesPerChunk");
     }
 
     public override void OnInspectorGUI()
@@ -345,16 +383,34 @@ public class NewtonTreeColliderEditor : NewtonColliderEditor
         EditorGUILayout.PropertyField(m_optimizeProp, new GUIContent("Optimize"));
         EditorGUILayout.PropertyField(m_freezeTransformProp, new GUIContent("Freeze Transform"));
         EditorGUILayout.PropertyField(m_rebuildMeshProp, new GUIContent("Rebuild mesh"));
+        EditorGUILayout.PropertyField(m_sharedGeometryFileProp, new GUIContent("Shared Geometry File"));
+        EditorGUILayout.PropertyField(m_trianglesPerChunkProp, new GUIContent("Triangles Per Chunk"));
         Validate();
+        CookedShapeGUI();
+        SharedGeometryGUI();
+    }
+
+    void SharedGeometryGUI()
+    {
+        NewtonTreeCollider collision = (NewtonTreeCollider)target;
+        if (!string.IsNullOrEmpty(collision.m_sharedGeometryFile) && GUILayout.Button("Cook Shared Geometry"))
+        {
+            if (!collision.CookSharedGeometry())
+            {
+                Debug.LogWarning("could not write the shared geometry of " + collision.name);
+            }
+            collision.RecreateEditorShape();
+        }
     }
 
     protected override void Validate()
     {
         NewtonTreeCollider collision = (NewtonTreeCollider)target;
 
-        if (collision.m_mesh != (Mesh)m_meshProp.objectReferenceValue || collision.m_optimize != m_optimizeProp.boolValue || collision.m_freezeScale != m_freezeTransformProp.boolValue || collision.m_rebuildMesh != m_rebuildMeshProp.boolValue)
+        if (collision.m_mesh != (Mesh)m_meshProp.objectReferenceValue || collision.m_optimize != m_optimizeProp.boolValue || collision.m_freezeScale != m_freezeTransformProp.boolValue || collision.m_rebuildMesh != m_rebuildMeshProp.boolValue || collision.m_sharedGeometryFile != m_sharedGeometryFileProp.stringValue || collision.m_trianglesPerChunk != m_trianglesPerChunkProp.intValue)
         {
             serializedObject.ApplyModifiedProperties();
+            collision.m_cookedShape = null;
             collision.RecreateEditorShape();
             //Debug.Log("Tree collider changed");
         }
@@ -364,4 +420,6 @@ public class NewtonTreeColliderEditor : NewtonColliderEditor
     SerializedProperty m_optimizeProp;
     SerializedProperty m_rebuildMeshProp;
     SerializedProperty m_freezeTransformProp;
+    SerializedProperty m_sharedGeometryFileProp;
+    SerializedProperty m_trianglesPerChunkProp;
 }
@@ -33,7 +33,11 @@ public class NewtonWorldEditor : Editor
         m_subStepsProp = serializedObject.FindProperty("m_subSteps");
         m_updateRateProp = serializedObject.FindProperty("m_updateRate");
         m_asyncUpdateProp = serializedObject.FindProperty("m_asyncUpdate");
+        m_profilingProp = serializedObject.FindProperty("m_profiling");
+        m_deterministicProp = serializedObject.FindProperty("m_deterministic");
         m_saveSceneNameProp = serializedObject.FindProperty("m_saveSceneName");
+        m_loadSerializedSceneProp = serializedObject.FindProperty("m_loadSerializedScene");
+        m_loadSceneNameProp = serializedObject.FindProperty("m_loadSceneName");
         m_serializeSceneOnceProp = serializedObject.FindProperty("m_serializeSceneOnce");
         m_numThreadsProp = serializedObject.FindProperty("m_numberOfThreads");
         m_broadPhaseTypeProp = serializedObject.FindProperty("m_broadPhaseType");
@@ -51,8 +55,12 @@ public class NewtonWorldEditor : Editor
 
         // Show the custom GUI controls
         EditorGUILayout.PropertyField(m_asyncUpdateProp, new GUIContent("Asynchronous update"));
+        EditorGUILayout.PropertyField(m_profilingProp, new GUIContent("Step profiling"));
+        EditorGUILayout.PropertyField(m_deterministicProp, new GUIContent("Deterministic"));
         EditorGUILayout.PropertyField(m_serializeSceneOnceProp, new GUIContent("Serialize scene once"));
         EditorGUILayout.PropertyField(m_saveSceneNameProp, new GUIContent("Serialize scene name"));
+        EditorGUILayout.PropertyField(m_loadSerializedSceneProp, new GUIContent("Load serialized scene"));
+        EditorGUILayout.PropertyField(m_loadSceneNameProp, new GUIContent("Load scene name"));
         EditorGUILayout.IntPopup(m_numThreadsProp, m_numberOfThreadsOptions, m_numberOfThreadsValues, new GUIContent("Worker threads"));
         EditorGUILayout.IntSlider(m_solverIterationsCountProp, 1, 10, new GUIContent("Solver iterations count"));
         EditorGUILayout.IntSlider(m_updateRateProp, 60, 1000, new GUIContent("Update rate"));
@@ -74,8 +82,12 @@ public class NewtonWorldEditor : Editor
     SerializedProperty m_updateRateProp;
     SerializedProperty m_numThreadsProp;
     SerializedProperty m_asyncUpdateProp;
+    SerializedProperty m_profilingProp;
+    SerializedProperty m_deterministicProp;
     SerializedProperty m_saveSceneNameProp;
     SerializedProperty m_serializeSceneOnceProp;
+    SerializedProperty m_loadSerializedSceneProp;
+    SerializedProperty m_loadSceneNameProp;
     SerializedProperty m_broadPhaseTypeProp;
     SerializedProperty m_solverIterationsCountProp;
     
@@ -42,6 +42,7 @@
 	#include "dNewtonJoint.h"
 	#include "dNewtonVehicle.h"
 	#include "dNewtonCollision.h"
+	#include "dNewtonWorldPartition.h"
 	#include "dNewtonJointHinge.h"
 	//#include "dNewtonJointPlane.h"
 	#include "dNewtonJointSlider.h"
@@ -89,6 +90,24 @@
    } 
 %} 
 
+// Wrap int* to IntPtr, index and attribute arrays are pinned on the managed side
+%typemap(ctype)  int* "int *"
+%typemap(in)     int* %{ $1 = $input; %}
+%typemap(imtype) int* "global::System.IntPtr"
+%typemap(cstype) int* "global::System.IntPtr"
+%typemap(out)    int* %{ $result = $1; %}
+%typemap(csin)   int* "$csinput"
+%typemap(csout, excode=SWIGEXCODE)  int* { 
+    System.IntPtr cPtr = $imcall;$excode
+    return cPtr;
+}
+%typemap(csvarout, excode=SWIGEXCODE2) int* %{ 
+    get {
+        System.IntPtr cPtr = $imcall;$excode 
+        return cPtr; 
+   } 
+%} 
+
 // Macro for wrapping C++ callbacks as C# delegates 
 %define %cs_callback(TYPE, CSTYPE) 
     %typemap(ctype) TYPE, TYPE& "void*" 
@@ -143,6 +162,26 @@
 %rename(__dCustomJoint_AngularIntegration_Add__) dCustomJoint::AngularIntegration::operator+;
 %rename(__dCustomJoint_AngularIntegration_Sub__) dCustomJoint::AngularIntegration::operator-;
 
+// bodies handed to dNewtonWorld::DestroyBody are deleted by the world
+%apply SWIGTYPE *DISOWN { dNewtonBody* const ownedBody };
+
+// bodies claimed from a loaded scene belong to the caller
+%newobject dNewtonWorld::TakeSerializedBody;
+
+// fracture fragments belong to the caller the same way
+%newobject dNewtonWorld::TakeFracturedBody;
+
+// compound children cross as one pinned block, NewtonCompoundCollider.NewtonCompoundChild mirrors the layout
+%ignore dNewtonCompoundChild;
+
+// shape cache keys and the builds and edits deferred to a safe point never leave the native side
+%ignore dNewtonShapeKey;
+%ignore dNewtonShapeBuild;
+%ignore dNewtonRegionEdit;
+
+// native helper for the shapes and the world, it takes a raw NewtonBody
+%ignore dNewtonBody::RefreshBroadphaseBounds;
+
 // dmath sdk Glue
 %include "dMathDefines.h"
 %include "dVector.h"
@@ -156,6 +195,7 @@
 %include "dNewtonJoint.h"
 %include "dNewtonVehicle.h"
 %include "dNewtonCollision.h"
+%include "dNewtonWorldPartition.h"
 //%include "dNewtonJointPlane.h"
 %include "dNewtonJointHinge.h"
 %include "dNewtonJointSlider.h"
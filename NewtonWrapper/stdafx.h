@@ -5,14 +5,21 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
-// Windows Header Files:
+#endif
+
 #include <new>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+// Windows Header Files:
 #include <windows.h>
+#endif
 #include <Newton.h>
 #include <dMathDefines.h>
 #include <dVector.h>
@@ -20,24 +20,197 @@
 
 #include "stdafx.h"
 #include "dAlloc.h"
+#include <new>
+#include <atomic>
+#include <climits>
 
 
+// small blocks are served from power of two size class pools. each thread keeps a private cache
+// of free blocks so worker threads building contacts and islands do not contend on the crt heap.
+// every block carries a header with its size class, so global operator delete works without a size.
 class MemoryDriverSingleton
 {
 	public:
+	enum
+	{
+		m_headerSize = 16,
+		m_minBlockShift = 5,
+		m_sizeClassCount = 12,
+		m_chunkSize = 256 * 1024,
+		m_threadCacheBytes = 64 * 1024,
+		m_statsFlushBytes = 64 * 1024,
+		m_statsFlushCount = 256,
+		m_largeBlock = -1,
+	};
+
+	// a tag packs the slot generation, the slot plus one and the category, zero is an untagged block
+	enum
+	{
+		m_maxSlots = 32,
+		m_slotShift = 8,
+		m_generationShift = 16,
+		m_generationMask = 0x7fff,
+	};
+
+	class dBlockHeader
+	{
+		public:
+		int m_sizeClass;
+		int m_tag;
+		long long m_sizeInBytes;
+	};
+
+	class dFreeBlock
+	{
+		public:
+		dFreeBlock* m_next;
+	};
+
+	// plain data, so it is still usable after the thread destructors ran
+	class dThreadCache
+	{
+		public:
+		dFreeBlock* m_freeList[m_sizeClassCount];
+		int m_count[m_sizeClassCount];
+		long long m_bytes;
+		int m_liveAllocations;
+		int m_totalAllocations;
+		int m_tag;
+		bool m_guarded;
+		bool m_retired;
+	};
+
+	// returns the cache of an exiting thread to the shared pools
+	class dThreadCacheGuard
+	{
+		public:
+		~dThreadCacheGuard()
+		{
+			dThreadCache& cache = GetThreadCache();
+			for (int i = 0; i < m_sizeClassCount; i++) {
+				Release(cache, i, cache.m_count[i]);
+			}
+			FlushStats(cache);
+			cache.m_retired = true;
+		}
+	};
+
+	class dPoolLock
+	{
+		public:
+		dPoolLock(int* const lock)
+			:m_lock(lock)
+		{
+			while (NewtonAtomicSwap(m_lock, 1)) {
+				NewtonYield();
+			}
+		}
+
+		~dPoolLock()
+		{
+			NewtonAtomicSwap(m_lock, 0);
+		}
+
+		int* m_lock;
+	};
+
 	MemoryDriverSingleton()
 	{
 		NewtonSetMemorySystem(Malloc, Free);
 	}
 
+	// newton allocates through this one, a negative size is a request newton could not even express
 	static void* Malloc(int sizeInBytes)
 	{
-		return malloc(sizeInBytes);
+		return (sizeInBytes >= 0) ? Allocate(size_t(sizeInBytes)) : NULL;
+	}
+
+	// returns NULL when the request does not fit or the crt heap is exhausted
+	static void* Allocate(size_t sizeInBytes)
+	{
+		if (sizeInBytes > size_t(LLONG_MAX) - m_headerSize) {
+			return NULL;
+		}
+		const size_t blockSize = sizeInBytes + m_headerSize;
+		const int sizeClass = GetSizeClass(blockSize);
+		dBlockHeader* const header = (dBlockHeader*) ((sizeClass == m_largeBlock) ? malloc(blockSize) : PopBlock(sizeClass));
+		if (!header) {
+			return NULL;
+		}
+		header->m_sizeClass = sizeClass;
+		header->m_sizeInBytes = (long long)sizeInBytes;
+		header->m_tag = GetThreadCache().m_tag;
+		AddStats((long long)sizeInBytes, 1);
+		AddSlotStats(header->m_tag, (long long)sizeInBytes);
+		return ((char*)header) + m_headerSize;
 	}
 
 	static void Free(void* const ptr)
 	{
-		free(ptr);
+		if (ptr) {
+			dBlockHeader* const header = (dBlockHeader*)(((char*)ptr) - m_headerSize);
+			AddStats(-header->m_sizeInBytes, -1);
+			AddSlotStats(header->m_tag, -header->m_sizeInBytes);
+			if (header->m_sizeClass == m_largeBlock) {
+				free(header);
+			} else {
+				PushBlock(header->m_sizeClass, (dFreeBlock*)header);
+			}
+		}
+	}
+
+	static void GetStats(dAllocStats& stats)
+	{
+		FlushStats(GetThreadCache());
+		stats.m_currentBytes = m_currentBytes;
+		stats.m_peakBytes = m_peakBytes;
+		stats.m_reservedBytes = m_reservedBytes;
+		stats.m_liveAllocations = m_liveAllocations;
+		stats.m_totalAllocations = m_totalAllocations;
+	}
+
+	// returns the tag the thread had before
+	static int SetThreadTag(int slot, int category)
+	{
+		dThreadCache& cache = GetThreadCache();
+		const int savedTag = cache.m_tag;
+		if ((slot >= 0) && (slot < m_maxSlots)) {
+			cache.m_tag = ((m_slotGeneration[slot] & m_generationMask) << m_generationShift) | ((slot + 1) << m_slotShift) | category;
+		}
+		return savedTag;
+	}
+
+	static void RestoreThreadTag(int tag)
+	{
+		GetThreadCache().m_tag = tag;
+	}
+
+	static int AcquireSlot()
+	{
+		for (int i = 0; i < m_maxSlots; i++) {
+			int expected = 0;
+			if (m_slotInUse[i].compare_exchange_strong(expected, 1)) {
+				for (int j = 0; j < dAllocScope::m_categoryCount; j++) {
+					m_slotBytes[i][j] = 0;
+				}
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	static void ReleaseSlot(int slot)
+	{
+		if ((slot >= 0) && (slot < m_maxSlots)) {
+			// blocks of the old owner freed from now on no longer match the generation
+			m_slotGeneration[slot]++;
+			m_slotInUse[slot] = 0;
+		}
+	}
+
+	static long long GetSlotBytes(int slot, int category)
+	{
+		return ((slot >= 0) && (slot < m_maxSlots)) ? m_slotBytes[slot][category].load() : 0;
 	}
 
 	static MemoryDriverSingleton& GetMemoryDriverSingleton ()
@@ -51,13 +224,216 @@ class MemoryDriverSingleton
 	{
 		Free(ptr);
 	}
+
+	static int GetSizeClass(size_t blockSize)
+	{
+		for (int i = 0; i < m_sizeClassCount; i++) {
+			if ((size_t(1) << (i + m_minBlockShift)) >= blockSize) {
+				return i;
+			}
+		}
+		return m_largeBlock;
+	}
+
+	static int GetCacheLimit(int sizeClass)
+	{
+		return dMax(int(m_threadCacheBytes) >> (sizeClass + m_minBlockShift), 2);
+	}
+
+	static dThreadCache& GetThreadCache()
+	{
+		static thread_local dThreadCache cache;
+		return cache;
+	}
+
+	static void* PopBlock(int sizeClass)
+	{
+		dThreadCache& cache = GetThreadCache();
+		if (!cache.m_freeList[sizeClass]) {
+			if (!cache.m_guarded && !cache.m_retired) {
+				cache.m_guarded = true;
+				static thread_local dThreadCacheGuard guard;
+			}
+			Refill(cache, sizeClass, cache.m_retired ? 1 : GetCacheLimit(sizeClass) / 2);
+		}
+
+		dFreeBlock* const block = cache.m_freeList[sizeClass];
+		if (!block) {
+			// the pool could not grow
+			return NULL;
+		}
+		cache.m_freeList[sizeClass] = block->m_next;
+		cache.m_count[sizeClass]--;
+		return block;
+	}
+
+	static void PushBlock(int sizeClass, dFreeBlock* const block)
+	{
+		dThreadCache& cache = GetThreadCache();
+		block->m_next = cache.m_freeList[sizeClass];
+		cache.m_freeList[sizeClass] = block;
+		cache.m_count[sizeClass]++;
+		if (cache.m_retired) {
+			Release(cache, sizeClass, cache.m_count[sizeClass]);
+		} else if (cache.m_count[sizeClass] > GetCacheLimit(sizeClass)) {
+			Release(cache, sizeClass, cache.m_count[sizeClass] / 2);
+		}
+	}
+
+	static void Refill(dThreadCache& cache, int sizeClass, int count)
+	{
+		dPoolLock lock(&m_sharedLock[sizeClass]);
+		if (!m_sharedList[sizeClass]) {
+			AddChunk(sizeClass);
+		}
+		for (int i = 0; (i < count) && m_sharedList[sizeClass]; i++) {
+			dFreeBlock* const block = m_sharedList[sizeClass];
+			m_sharedList[sizeClass] = block->m_next;
+			block->m_next = cache.m_freeList[sizeClass];
+			cache.m_freeList[sizeClass] = block;
+			cache.m_count[sizeClass]++;
+		}
+	}
+
+	static void Release(dThreadCache& cache, int sizeClass, int count)
+	{
+		dPoolLock lock(&m_sharedLock[sizeClass]);
+		for (int i = 0; (i < count) && cache.m_freeList[sizeClass]; i++) {
+			dFreeBlock* const block = cache.m_freeList[sizeClass];
+			cache.m_freeList[sizeClass] = block->m_next;
+			cache.m_count[sizeClass]--;
+			block->m_next = m_sharedList[sizeClass];
+			m_sharedList[sizeClass] = block;
+		}
+	}
+
+	// counters are accumulated per thread and published in batches, so the shared
+	// totals and the peak may lag behind by a few kbytes per thread
+	static void AddStats(long long sizeInBytes, int count)
+	{
+		dThreadCache& cache = GetThreadCache();
+		cache.m_bytes += sizeInBytes;
+		cache.m_liveAllocations += count;
+		if (count > 0) {
+			cache.m_totalAllocations++;
+		}
+		if (cache.m_retired || (dAbs(cache.m_bytes) > m_statsFlushBytes) || (dAbs(cache.m_liveAllocations) > m_statsFlushCount) || (cache.m_totalAllocations > m_statsFlushCount)) {
+			FlushStats(cache);
+		}
+	}
+
+	// slot counters are updated right away, tagged allocations are the few the wrapper makes on behalf of a world
+	static void AddSlotStats(int tag, long long sizeInBytes)
+	{
+		if (tag) {
+			const int slot = ((tag >> m_slotShift) & 0xff) - 1;
+			if ((((tag >> m_generationShift) & m_generationMask) == (m_slotGeneration[slot] & m_generationMask))) {
+				m_slotBytes[slot][tag & 0xff] += sizeInBytes;
+			}
+		}
+	}
+
+	static void FlushStats(dThreadCache& cache)
+	{
+		const long long currentBytes = m_currentBytes.fetch_add(cache.m_bytes) + cache.m_bytes;
+		long long peakBytes = m_peakBytes;
+		while ((currentBytes > peakBytes) && !m_peakBytes.compare_exchange_weak(peakBytes, currentBytes));
+		m_liveAllocations += cache.m_liveAllocations;
+		m_totalAllocations += cache.m_totalAllocations;
+		cache.m_bytes = 0;
+		cache.m_liveAllocations = 0;
+		cache.m_totalAllocations = 0;
+	}
+
+	// chunks are never given back, the blocks just move between the pools
+	static void AddChunk(int sizeClass)
+	{
+		const int blockSize = 1 << (sizeClass + m_minBlockShift);
+		char* const chunk = (char*)malloc(m_chunkSize);
+		if (!chunk) {
+			return;
+		}
+		m_reservedBytes += m_chunkSize;
+		for (int offset = m_chunkSize - blockSize; offset >= 0; offset -= blockSize) {
+			dFreeBlock* const block = (dFreeBlock*)(chunk + offset);
+			block->m_next = m_sharedList[sizeClass];
+			m_sharedList[sizeClass] = block;
+		}
+	}
+
+	// zero initialized, the pools work before any static constructor ran
+	static dFreeBlock* m_sharedList[m_sizeClassCount];
+	static int m_sharedLock[m_sizeClassCount];
+	static std::atomic<long long> m_currentBytes;
+	static std::atomic<long long> m_peakBytes;
+	static std::atomic<long long> m_reservedBytes;
+	static std::atomic<long long> m_liveAllocations;
+	static std::atomic<long long> m_totalAllocations;
+	static std::atomic<long long> m_slotBytes[m_maxSlots][dAllocScope::m_categoryCount];
+	static std::atomic<int> m_slotGeneration[m_maxSlots];
+	static std::atomic<int> m_slotInUse[m_maxSlots];
 };
 
+MemoryDriverSingleton::dFreeBlock* MemoryDriverSingleton::m_sharedList[MemoryDriverSingleton::m_sizeClassCount];
+int MemoryDriverSingleton::m_sharedLock[MemoryDriverSingleton::m_sizeClassCount];
+std::atomic<long long> MemoryDriverSingleton::m_currentBytes(0);
+std::atomic<long long> MemoryDriverSingleton::m_peakBytes(0);
+std::atomic<long long> MemoryDriverSingleton::m_reservedBytes(0);
+std::atomic<long long> MemoryDriverSingleton::m_liveAllocations(0);
+std::atomic<long long> MemoryDriverSingleton::m_totalAllocations(0);
+std::atomic<long long> MemoryDriverSingleton::m_slotBytes[MemoryDriverSingleton::m_maxSlots][dAllocScope::m_categoryCount];
+std::atomic<int> MemoryDriverSingleton::m_slotGeneration[MemoryDriverSingleton::m_maxSlots];
+std::atomic<int> MemoryDriverSingleton::m_slotInUse[MemoryDriverSingleton::m_maxSlots];
+
+
+void dAlloc::GetStats(dAllocStats& stats)
+{
+	MemoryDriverSingleton::GetStats(stats);
+}
+
+dAllocScope::dAllocScope(int slot, dCategory category)
+	:m_savedTag(MemoryDriverSingleton::SetThreadTag(slot, category))
+{
+}
+
+dAllocScope::~dAllocScope()
+{
+	MemoryDriverSingleton::RestoreThreadTag(m_savedTag);
+}
+
+int dAllocScope::AcquireSlot()
+{
+	return MemoryDriverSingleton::AcquireSlot();
+}
+
+void dAllocScope::ReleaseSlot(int slot)
+{
+	MemoryDriverSingleton::ReleaseSlot(slot);
+}
+
+long long dAllocScope::GetBytes(int slot, dCategory category)
+{
+	return MemoryDriverSingleton::GetSlotBytes(slot, category);
+}
+
+int dAllocScope::SetThreadTag(int slot, dCategory category)
+{
+	return MemoryDriverSingleton::SetThreadTag(slot, category);
+}
+
+void dAllocScope::RestoreThreadTag(int savedTag)
+{
+	MemoryDriverSingleton::RestoreThreadTag(savedTag);
+}
 
 void* dAlloc::operator new (size_t size)
 {
 	MemoryDriverSingleton::GetMemoryDriverSingleton();
-	return NewtonAlloc(int (size));
+	void* const ptr = (size <= size_t(INT_MAX)) ? NewtonAlloc(int (size)) : NULL;
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
 }
 
 void dAlloc::operator delete (void* ptr)
@@ -69,7 +445,11 @@ void dAlloc::operator delete (void* ptr)
 void* operator new (size_t size)
 {
 	MemoryDriverSingleton::GetMemoryDriverSingleton();
-	return MemoryDriverSingleton::Malloc(int(size));
+	void* const ptr = MemoryDriverSingleton::Allocate(size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
 }
 
 void operator delete (void* ptr)
@@ -23,12 +23,55 @@
 
 #include "stdafx.h"
 
+// process wide counters of the pooled allocator, every world in the process shares the same pools
+class dAllocStats
+{
+	public:
+	long long m_currentBytes;
+	long long m_peakBytes;
+	long long m_reservedBytes;
+	long long m_liveAllocations;
+	long long m_totalAllocations;
+};
+
+// allocations made on a thread while a scope is alive are charged to the scope's slot and category.
+// a slot belongs to one world, blocks remember it so they are credited back whatever thread frees them
+class dAllocScope
+{
+	public:
+	enum dCategory
+	{
+		m_bodies,
+		m_shapes,
+		m_joints,
+		m_solver,
+		m_categoryCount,
+	};
+
+	dAllocScope(int slot, dCategory category);
+	~dAllocScope();
+
+	// returns -1 when every slot is taken, scopes on that slot charge nothing
+	static int AcquireSlot();
+	static void ReleaseSlot(int slot);
+	static long long GetBytes(int slot, dCategory category);
+
+	// for charges that begin and end in different callbacks, SetThreadTag returns what RestoreThreadTag takes
+	static int SetThreadTag(int slot, dCategory category);
+	static void RestoreThreadTag(int savedTag);
+
+	private:
+	int m_savedTag;
+};
+
 class dAlloc  
 {
 	public:
 	void *operator new (size_t size);
 	void operator delete (void* ptr);
 
+	static void GetStats(dAllocStats& stats);
+
 	dAlloc()
 	{
 	}
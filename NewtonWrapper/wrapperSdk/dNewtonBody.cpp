@@ -39,16 +39,34 @@ dNewtonBody::ScopeLock::~ScopeLock()
 }
 
 
-dNewtonBody::dNewtonBody(const dMatrix& matrix)
+dNewtonBody::dNewtonBody(dNewtonWorld* const world, const dMatrix& matrix)
 	:dAlloc()
 	,m_body(NULL)
+	,m_myWorld(world)
+	,m_userData(NULL)
 	,m_posit0(matrix.m_posit)
 	,m_posit1(matrix.m_posit)
 	,m_interpolatedPosit(matrix.m_posit)
 	,m_rotation0(matrix)
 	,m_rotation1(m_rotation0)
 	,m_interpolatedRotation(m_rotation0)
+	,m_velocity(0.0f)
+	,m_omega(0.0f)
+	,m_com(0.0f)
+	,m_angulardamping(0.0f)
 	,m_lock(0)
+	,m_pendingCollision(NULL)
+	,m_pendingShape(NULL)
+	,m_pendingBuild(NULL)
+	,m_ownedCollision(NULL)
+	,m_commandNode(NULL)
+	,m_networkNode(NULL)
+	,m_pendingMass(0.0f)
+	,m_linearDamping(0.0f)
+	,m_pendingState(0)
+	,m_networkID(-1)
+	,m_sceneID(-1)
+	,m_sleepState(false)
 {
 }
 
@@ -63,30 +81,40 @@ void* dNewtonBody::GetBody() const
 	return m_body;
 }
 
+bool dNewtonBody::IsPending() const
+{
+	return (!m_body && m_commandNode) ? true : false;
+}
 
 bool dNewtonBody::GetSleepState() const
 {
+	if (!m_body) {
+		return m_sleepState;
+	}
 	return NewtonBodyGetSleepState(m_body) ? true : false;
 }
 
-void dNewtonBody::SetSleepState(bool state) const
+void dNewtonBody::SetSleepState(bool state)
 {
+	if (!m_body) {
+		m_sleepState = state;
+		m_pendingState |= m_pendingSleepState;
+		return;
+	}
 	NewtonBodySetSleepState(m_body, state ? 1 : 0);
 }
 
 void* dNewtonBody::GetInterpolatedPosition()
 {
-	const dNewtonWorld* const world = (dNewtonWorld*)NewtonWorldGetUserData(NewtonBodyGetWorld(m_body));
 	ScopeLock scopelock(&m_lock);
-	m_interpolatedPosit = m_posit0 + (m_posit1 - m_posit0).Scale(world->m_interpotationParam);
+	m_interpolatedPosit = m_posit0 + (m_posit1 - m_posit0).Scale(m_myWorld->m_interpotationParam);
 	return &m_interpolatedPosit.m_x;
 }
 
 void* dNewtonBody::GetInterpolatedRotation()
 {
-	const dNewtonWorld* const world = (dNewtonWorld*) NewtonWorldGetUserData(NewtonBodyGetWorld(m_body));
 	ScopeLock scopelock(&m_lock);
-	m_interpolatedRotation = m_rotation0.Slerp(m_rotation1, world->m_interpotationParam);
+	m_interpolatedRotation = m_rotation0.Slerp(m_rotation1, m_myWorld->m_interpotationParam);
 	return &m_interpolatedRotation.m_q0;
 }
 
@@ -102,6 +130,13 @@ void* dNewtonBody::GetRotation()
 
 void dNewtonBody::SetPosition(dFloat x, dFloat y, dFloat z)
 {
+	if (!m_body) {
+		ScopeLock scopelock(&m_lock);
+		m_posit1 = dVector(x, y, z);
+		m_posit0 = m_posit1;
+		return;
+	}
+
 	dQuaternion rot;
 	NewtonBodyGetRotation(m_body, &rot.m_q0);
 	dMatrix mat(rot, dVector(x, y, z));
@@ -110,6 +145,13 @@ void dNewtonBody::SetPosition(dFloat x, dFloat y, dFloat z)
 
 void dNewtonBody::SetRotation(dFloat x, dFloat y, dFloat z, dFloat w)
 {
+	if (!m_body) {
+		ScopeLock scopelock(&m_lock);
+		m_rotation1 = dQuaternion(x, y, z, w);
+		m_rotation0 = m_rotation1;
+		return;
+	}
+
 	dVector pos(0, 0, 0);
 	NewtonBodyGetPosition(m_body, &pos.m_x);
 	dMatrix mat(dQuaternion(x, y, z, w), pos);
@@ -128,58 +170,96 @@ void* dNewtonBody::GetUserData()
 
 void* dNewtonBody::GetVelocity()
 {
-	NewtonBodyGetVelocity(m_body, &m_velocity.m_x);
+	if (m_body) {
+		NewtonBodyGetVelocity(m_body, &m_velocity.m_x);
+	}
 	return &m_velocity;
 }
 
 void* dNewtonBody::GetOmega()
 {
-	NewtonBodyGetOmega(m_body, &m_omega.m_x);
+	if (m_body) {
+		NewtonBodyGetOmega(m_body, &m_omega.m_x);
+	}
 	return &m_omega;
 }
 
 void dNewtonBody::SetVelocity(dFloat x, dFloat y, dFloat z)
 {
 	dVector vel(x,y,z);
+	if (!m_body) {
+		m_velocity = vel;
+		m_pendingState |= m_pendingVelocity;
+		return;
+	}
 	NewtonBodySetVelocity(m_body, &vel.m_x);
 }
 
 void dNewtonBody::SetOmega(dFloat x, dFloat y, dFloat z)
 {
 	dVector omg(x, y, z);
+	if (!m_body) {
+		m_omega = omg;
+		m_pendingState |= m_pendingOmega;
+		return;
+	}
 	NewtonBodySetOmega(m_body, &omg.m_x);
 }
 
 float dNewtonBody::GetLinearDamping()
 {
-	return NewtonBodyGetLinearDamping(m_body);
+	if (m_body) {
+		m_linearDamping = NewtonBodyGetLinearDamping(m_body);
+	}
+	return m_linearDamping;
 }
 
 void dNewtonBody::SetLinearDamping(dFloat x)
 {
+	if (!m_body) {
+		m_linearDamping = x;
+		m_pendingState |= m_pendingLinearDamping;
+		return;
+	}
 	NewtonBodySetLinearDamping(m_body, x);
 }
 
 void* dNewtonBody::GetAngularDamping()
 {
-	NewtonBodyGetAngularDamping(m_body, &m_angulardamping.m_x);
+	if (m_body) {
+		NewtonBodyGetAngularDamping(m_body, &m_angulardamping.m_x);
+	}
 	return &m_angulardamping;
 }
 
 void dNewtonBody::SetAngularDamping(dFloat x, dFloat y, dFloat z)
 {
 	dVector damp(x, y, z);
+	if (!m_body) {
+		m_angulardamping = damp;
+		m_pendingState |= m_pendingAngularDamping;
+		return;
+	}
 	NewtonBodySetAngularDamping(m_body, &damp.m_x);
 }
 
 void* dNewtonBody::GetCenterOfMass()
 {
-	NewtonBodyGetCentreOfMass(m_body, &m_com.m_x);
+	if (m_body) {
+		NewtonBodyGetCentreOfMass(m_body, &m_com.m_x);
+	}
 	return &m_com;
 }
 
 void dNewtonBody::SetCenterOfMass(float com_x, float com_y, float com_z)
 {
+	if (!m_body) {
+		// while pending the center of mass holds the offset to apply once the body exists
+		m_com = dVector(com_x, com_y, com_z, 0.0f);
+		m_pendingState |= m_pendingCenterOfMass;
+		return;
+	}
+
 	dVector com;
 	dFloat Ixx;
 	dFloat Iyy;
@@ -203,6 +283,10 @@ void dNewtonBody::CalculateBuoyancyForces(const void* plane, void* force, void*
 	dFloat Izz;
 	dFloat mass;
 
+	if (!m_body) {
+		return;
+	}
+
 	NewtonBodyGetMass(m_body, &mass, &Ixx, &Iyy, &Izz);
 
 	if (mass > 0.0f) {
@@ -263,6 +347,7 @@ void dNewtonBody::OnForceAndTorqueCallback (const NewtonBody* body, dFloat times
 {
 	dNewtonBody* const me = (dNewtonBody*)NewtonBodyGetUserData(body);
 	dAssert(me);
+	dNewtonTraceScope scope(me->m_myWorld->m_trace, "OnForceAndTorque", threadIndex);
 	me->OnForceAndTorque(timestep, threadIndex);
 }
 
@@ -270,20 +355,97 @@ void dNewtonBody::OnBodyTransformCallback (const NewtonBody* const body, const d
 {
 	dNewtonBody* const me = (dNewtonBody*)NewtonBodyGetUserData(body);
 	dAssert(me);
+	dNewtonTraceScope scope(me->m_myWorld->m_trace, "OnBodyTransform", threadIndex);
 	me->OnBodyTransform(matrix, threadIndex);
 }
 
 
 void dNewtonBody::Destroy()
 {
+	SetNetworkID(-1);
+
+	if (m_commandNode) {
+		// still waiting in a command queue, a pending add never reached newton
+		if (m_body) {
+			m_myWorld->m_bodyRemoveQueue.Remove(m_commandNode);
+		} else {
+			m_myWorld->m_bodyAddQueue.Remove(m_commandNode);
+		}
+		m_commandNode = NULL;
+		m_pendingCollision = NULL;
+	}
+
+	if (m_pendingShape) {
+		m_myWorld->ReleaseShape(m_pendingShape);
+		m_pendingShape = NULL;
+	}
+	if (m_pendingBuild) {
+		delete m_pendingBuild;
+		m_pendingBuild = NULL;
+	}
+
 	if (m_body) {
-		NewtonWaitForUpdateToFinish(NewtonBodyGetWorld(m_body));
+		// owners go through dNewtonWorld::DestroyBody, which only deletes a live body at a safe point
+		dAssert(!m_myWorld->m_updateInFlight);
+
+		// the collision wrapper points at the body's shape, it takes its own copy before newton frees the body
+		dNewtonCollision* const collision = (dNewtonCollision*)NewtonCollisionGetUserData(NewtonBodyGetCollision(m_body));
+		if (collision && (collision != m_ownedCollision) && (collision->m_ownerBody == m_body)) {
+			collision->TransferShapeFromBody();
+		}
+		if (m_ownedCollision) {
+			delete m_ownedCollision;
+			m_ownedCollision = NULL;
+		}
 		NewtonBodySetDestructorCallback(m_body, NULL);
 		NewtonDestroyBody(m_body);
 		m_body = NULL;
 	}
 }
 
+bool dNewtonBody::SetNetworkID(int networkID)
+{
+	if (m_networkNode) {
+		m_myWorld->m_networkBodies.Remove(m_networkNode);
+		m_networkNode = NULL;
+	}
+
+	m_networkID = -1;
+	if (networkID >= 0) {
+		m_networkNode = m_myWorld->m_networkBodies.Insert(this, networkID);
+		if (!m_networkNode) {
+			// the id is taken by another body
+			return false;
+		}
+		m_networkID = networkID;
+	}
+	return true;
+}
+
+int dNewtonBody::GetNetworkID() const
+{
+	return m_networkID;
+}
+
+void dNewtonBody::SetSceneID(int sceneID)
+{
+	m_sceneID = sceneID;
+}
+
+int dNewtonBody::GetSceneID() const
+{
+	return m_sceneID;
+}
+
+void dNewtonBody::ResetInterpolation(const dMatrix& matrix)
+{
+	ScopeLock scopelock(&m_lock);
+	m_posit0 = matrix.m_posit;
+	m_posit1 = matrix.m_posit;
+	m_rotation1 = dQuaternion(matrix);
+	m_rotation0 = m_rotation1;
+}
+
 void dNewtonBody::OnBodyDestroy(const NewtonBody* const body)
 {
 	dAssert(0);
@@ -296,6 +458,14 @@ void dNewtonBody::OnBodyDestroy(const NewtonBody* const body)
 */
 }
 
+void dNewtonBody::RefreshBroadphaseBounds(NewtonBody* const body)
+{
+	// newton only recalculates the bounds when the body moves, setting the same matrix is enough
+	dMatrix matrix;
+	NewtonBodyGetMatrix(body, &matrix[0][0]);
+	NewtonBodySetMatrix(body, &matrix[0][0]);
+}
+
 void dNewtonBody::InitForceAccumulators()
 {
 }
@@ -308,40 +478,208 @@ void dNewtonBody::AddTorque(dFloat x, dFloat y, dFloat z)
 {
 }
 
-dNewtonKinematicBody::dNewtonKinematicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix, dFloat mass)
-	:dNewtonBody(matrix)
+void dNewtonBody::CreateBody(dNewtonCollision* const collision, const dMatrix& matrix, dFloat mass)
 {
-	NewtonWorld* const newton = world->m_world;
-	NewtonWaitForUpdateToFinish(newton);
+	if (m_myWorld->m_updateInFlight) {
+		// the world is stepping, record the add and let the next safe point create the body
+		m_pendingCollision = collision;
+		m_pendingMass = mass;
+		m_commandNode = m_myWorld->m_bodyAddQueue.Append(this);
+	} else {
+		CommitBody(collision, matrix, mass);
+	}
+}
 
-	m_body = NewtonCreateDynamicBody(newton, collision->m_shape, &matrix[0][0]);
-	collision->DeleteShape();
-	collision->SetShape(NewtonBodyGetCollision(m_body));
+NewtonBody* dNewtonBody::CreateNewtonBody(const NewtonCollision* const shape, const dMatrix& matrix, dFloat mass) const
+{
+	NewtonBody* const body = NewtonCreateDynamicBody(m_myWorld->m_world, shape, &matrix[0][0]);
+	NewtonBodySetMassProperties(body, mass, NewtonBodyGetCollision(body));
+	return body;
+}
 
-	NewtonBodySetMassProperties(m_body, mass, NewtonBodyGetCollision(m_body));
+void dNewtonBody::CommitBody(dNewtonCollision* const collision, const dMatrix& matrix, dFloat mass)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_bodies);
+	m_body = CreateNewtonBody(collision->m_shape, matrix, mass);
+	collision->TransferShapeToBody(m_body);
 
 	NewtonBodySetUserData(m_body, this);
 	NewtonBodySetTransformCallback(m_body, OnBodyTransformCallback);
 	NewtonBodySetForceAndTorqueCallback(m_body, OnForceAndTorqueCallback);
 }
 
-dNewtonDynamicBody::dNewtonDynamicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix, dFloat mass)
-	:dNewtonBody(matrix)
+void dNewtonBody::AttachBody(NewtonBody* const body, dNewtonCollision* const ownedCollision)
 {
-	NewtonWorld* const newton = world->m_world;
+	dMatrix matrix;
+	NewtonBodyGetMatrix(body, &matrix[0][0]);
 
-	NewtonWaitForUpdateToFinish(newton);
-	m_body = NewtonCreateDynamicBody(newton, collision->m_shape, &matrix[0][0]);
-	collision->DeleteShape();
-	collision->SetShape(NewtonBodyGetCollision(m_body));
-
-	NewtonBodySetMassProperties(m_body, mass, NewtonBodyGetCollision(m_body));
+	m_body = body;
+	m_ownedCollision = ownedCollision;
+	ResetInterpolation(matrix);
 
 	NewtonBodySetUserData(m_body, this);
 	NewtonBodySetTransformCallback(m_body, OnBodyTransformCallback);
 	NewtonBodySetForceAndTorqueCallback(m_body, OnForceAndTorqueCallback);
 }
 
+void dNewtonBody::CommitPendingBody()
+{
+	const dMatrix matrix(m_rotation1, m_posit1);
+	if (m_pendingCollision) {
+		dNewtonCollision* const collision = m_pendingCollision;
+		m_pendingCollision = NULL;
+		CommitBody(collision, matrix, m_pendingMass);
+	} else {
+		// the collision wrapper was destroyed while the body waited, build the body from the shape it left behind
+		dAssert(m_pendingShape);
+		if (m_pendingBuild) {
+			m_pendingShape = m_myWorld->CommitShapeBuild(*m_pendingBuild, m_pendingShape);
+			delete m_pendingBuild;
+			m_pendingBuild = NULL;
+		}
+		const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_bodies);
+		m_body = CreateNewtonBody(m_pendingShape, matrix, m_pendingMass);
+		NewtonCollisionSetUserData(NewtonBodyGetCollision(m_body), NULL);
+		NewtonDestroyCollision(m_pendingShape);
+		m_pendingShape = NULL;
+
+		NewtonBodySetUserData(m_body, this);
+		NewtonBodySetTransformCallback(m_body, OnBodyTransformCallback);
+		NewtonBodySetForceAndTorqueCallback(m_body, OnForceAndTorqueCallback);
+	}
+
+	// replay everything the game set while the body was waiting
+	if (m_pendingState & m_pendingVelocity) {
+		NewtonBodySetVelocity(m_body, &m_velocity.m_x);
+	}
+	if (m_pendingState & m_pendingOmega) {
+		NewtonBodySetOmega(m_body, &m_omega.m_x);
+	}
+	if (m_pendingState & m_pendingLinearDamping) {
+		NewtonBodySetLinearDamping(m_body, m_linearDamping);
+	}
+	if (m_pendingState & m_pendingAngularDamping) {
+		NewtonBodySetAngularDamping(m_body, &m_angulardamping.m_x);
+	}
+	if (m_pendingState & m_pendingCenterOfMass) {
+		SetCenterOfMass(m_com.m_x, m_com.m_y, m_com.m_z);
+	}
+	if (m_pendingState & m_pendingSleepState) {
+		NewtonBodySetSleepState(m_body, m_sleepState ? 1 : 0);
+	}
+	m_pendingState = 0;
+}
+
+dNewtonKinematicBody::dNewtonKinematicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix)
+	:dNewtonBody(world, matrix)
+	,m_targetPosit(matrix.m_posit)
+	,m_targetRotation(matrix)
+	,m_targetTime(0.0f)
+	,m_moverNode(NULL)
+{
+	CreateBody(collision, matrix, 0.0f);
+}
+
+dNewtonKinematicBody::dNewtonKinematicBody(dNewtonWorld* const world, NewtonBody* const body, dNewtonCollision* const collision)
+	:dNewtonBody(world, dGetIdentityMatrix())
+	,m_targetPosit(0.0f)
+	,m_targetRotation()
+	,m_targetTime(0.0f)
+	,m_moverNode(NULL)
+{
+	AttachBody(body, collision);
+	m_targetPosit = m_posit1;
+	m_targetRotation = m_rotation1;
+	NewtonBodySetCollidable(m_body, 1);
+	NewtonBodySetAutoSleep(m_body, 0);
+}
+
+dNewtonKinematicBody::~dNewtonKinematicBody()
+{
+	Destroy();
+}
+
+void dNewtonKinematicBody::Destroy()
+{
+	if (m_moverNode) {
+		m_myWorld->m_kinematicMovers.Remove(m_moverNode);
+		m_moverNode = NULL;
+	}
+	dNewtonBody::Destroy();
+}
+
+NewtonBody* dNewtonKinematicBody::CreateNewtonBody(const NewtonCollision* const shape, const dMatrix& matrix, dFloat) const
+{
+	// the mass argument only exists for the dynamic override and is always zero here.
+	// kinematic bodies are only moved by their velocity, so they must never fall asleep while driven
+	NewtonBody* const body = NewtonCreateKinematicBody(m_myWorld->m_world, shape, &matrix[0][0]);
+	NewtonBodySetCollidable(body, 1);
+	NewtonBodySetAutoSleep(body, 0);
+	return body;
+}
+
+void dNewtonKinematicBody::MoveTo(dFloat px, dFloat py, dFloat pz, dFloat q0, dFloat q1, dFloat q2, dFloat q3, dFloat timestep)
+{
+	m_targetPosit = dVector(px, py, pz, 1.0f);
+	m_targetRotation = dQuaternion(q0, q1, q2, q3);
+	m_targetTime = timestep;
+	if (!m_moverNode) {
+		m_moverNode = m_myWorld->m_kinematicMovers.Append(this);
+	}
+}
+
+void dNewtonKinematicBody::UpdateTarget(dFloat timestep)
+{
+	if (!m_body) {
+		return;
+	}
+
+	if (m_targetTime <= 0.0f) {
+		// target reached, park the body
+		const dVector zero(0.0f);
+		NewtonBodySetVelocity(m_body, &zero[0]);
+		NewtonBodySetOmega(m_body, &zero[0]);
+		m_myWorld->m_kinematicMovers.Remove(m_moverNode);
+		m_moverNode = NULL;
+		return;
+	}
+
+	// velocities always come from the pose the body actually reached, so errors do not accumulate
+	dMatrix matrix;
+	NewtonBodyGetMatrix(m_body, &matrix[0][0]);
+	dQuaternion rotation(matrix);
+	if (rotation.DotProduct(m_targetRotation) < 0.0f) {
+		rotation = rotation.Scale(-1.0f);
+	}
+
+	const dFloat invTime = 1.0f / dMax(m_targetTime, timestep);
+	dVector veloc((m_targetPosit - matrix.m_posit).Scale(invTime));
+	dVector omega(rotation.CalcAverageOmega(m_targetRotation, invTime));
+	veloc.m_w = 0.0f;
+	omega.m_w = 0.0f;
+
+	NewtonBodySetVelocity(m_body, &veloc[0]);
+	NewtonBodySetOmega(m_body, &omega[0]);
+	m_targetTime -= timestep;
+}
+
+dNewtonDynamicBody::dNewtonDynamicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix, dFloat mass)
+	:dNewtonBody(world, matrix)
+	,m_externalForce(world->GetGravity().Scale(mass))
+	,m_externalTorque(0.0f)
+{
+	CreateBody(collision, matrix, mass);
+}
+
+dNewtonDynamicBody::dNewtonDynamicBody(dNewtonWorld* const world, NewtonBody* const body, dNewtonCollision* const collision)
+	:dNewtonBody(world, dGetIdentityMatrix())
+	,m_externalForce(0.0f)
+	,m_externalTorque(0.0f)
+{
+	AttachBody(body, collision);
+	InitForceAccumulators();
+}
+
 void dNewtonDynamicBody::InitForceAccumulators()
 {
 	dFloat mass;
@@ -350,9 +688,7 @@ void dNewtonDynamicBody::InitForceAccumulators()
 	dFloat Izz;
 
 	NewtonBodyGetMass(m_body, &mass, &Ixx, &Iyy, &Izz);
-	const dNewtonWorld* const world = (dNewtonWorld*)NewtonWorldGetUserData(NewtonBodyGetWorld(m_body));
-
-	m_externalForce = world->GetGravity().Scale(mass);
+	m_externalForce = m_myWorld->GetGravity().Scale(mass);
 	m_externalTorque = dVector(0.0f);
 }
 
@@ -29,6 +29,7 @@ class NewtonBody;
 class dNewtonBody;
 class dNewtonWorld;
 class dNewtonCollision;
+class dNewtonShapeBuild;
 
 class dNewtonBody: public dAlloc
 {
@@ -42,9 +43,16 @@ class dNewtonBody: public dAlloc
 		unsigned* m_atomicLock;
 	};
 
-	dNewtonBody(const dMatrix& matrix);
+	dNewtonBody(dNewtonWorld* const world, const dMatrix& matrix);
 	virtual void Destroy();
 
+	// makes the broadphase pick up the bounds of a shape that changed under the body
+	static void RefreshBroadphaseBounds(NewtonBody* const body);
+
+	// bodies created while the world is stepping are pending until the next safe point,
+	// GetBody returns NULL for them, callers that need the NewtonBody must wait for the update first.
+	bool IsPending() const;
+
 	void* GetBody() const;
 	void* GetPosition();
 	void* GetRotation();
@@ -74,7 +82,16 @@ class dNewtonBody: public dAlloc
 	virtual void AddTorque(dFloat x, dFloat y, dFloat z);
 
 	bool GetSleepState() const;
-	void SetSleepState(bool state) const;
+	void SetSleepState(bool state);
+
+	// bodies with a network id take part in the world replication snapshots,
+	// ids must be unique in the world, a negative id takes the body out
+	bool SetNetworkID(int networkID);
+	int GetNetworkID() const;
+
+	// stable id saved with the body in serialized scenes, the game claims loaded bodies by it
+	void SetSceneID(int sceneID);
+	int GetSceneID() const;
 
 	protected:
 	virtual ~dNewtonBody();
@@ -87,12 +104,34 @@ class dNewtonBody: public dAlloc
 
 	virtual void InitForceAccumulators();
 
+	virtual NewtonBody* CreateNewtonBody(const NewtonCollision* const shape, const dMatrix& matrix, dFloat mass) const;
+	void CreateBody(dNewtonCollision* const collision, const dMatrix& matrix, dFloat mass);
+	void CommitBody(dNewtonCollision* const collision, const dMatrix& matrix, dFloat mass);
+	void CommitPendingBody();
+
+	// takes over a body newton already created, as the ones loaded from a serialized scene
+	void AttachBody(NewtonBody* const body, dNewtonCollision* const ownedCollision);
+
+	// place the body at a new pose without interpolating from the old one
+	void ResetInterpolation(const dMatrix& matrix);
+
+	enum dPendingState
+	{
+		m_pendingVelocity = 1 << 0,
+		m_pendingOmega = 1 << 1,
+		m_pendingLinearDamping = 1 << 2,
+		m_pendingAngularDamping = 1 << 3,
+		m_pendingCenterOfMass = 1 << 4,
+		m_pendingSleepState = 1 << 5,
+	};
+
 	protected:
 	static void OnBodyDestroy (const NewtonBody* const body);
 	static void OnForceAndTorqueCallback (const NewtonBody* body, dFloat timestep, int threadIndex);
 	static void OnBodyTransformCallback(const NewtonBody* const body, const dFloat* const matrix, int threadIndex);
 
 	NewtonBody* m_body;
+	dNewtonWorld* m_myWorld;
 	void* m_userData;
 	dVector m_posit0;
 	dVector m_posit1;
@@ -106,6 +145,20 @@ class dNewtonBody: public dAlloc
 	dVector m_angulardamping;
 	unsigned m_lock;
 
+	// state recorded while the body is waiting in one of the world command queues
+	dNewtonCollision* m_pendingCollision;
+	NewtonCollision* m_pendingShape;
+	dNewtonShapeBuild* m_pendingBuild;
+	dNewtonCollision* m_ownedCollision;
+	dList<dNewtonBody*>::dListNode* m_commandNode;
+	dTree<dNewtonBody*, int>::dTreeNode* m_networkNode;
+	dFloat m_pendingMass;
+	dFloat m_linearDamping;
+	int m_pendingState;
+	int m_networkID;
+	int m_sceneID;
+	bool m_sleepState;
+
 	friend class dNewtonWorld;
 	friend class dNewtonBallAndSocket;
 };
@@ -114,7 +167,26 @@ class dNewtonBody: public dAlloc
 class dNewtonKinematicBody : public dNewtonBody
 {
 	public:
-	dNewtonKinematicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix, dFloat mass);
+	// kinematic bodies have infinite mass in the solver, so they take no mass
+	dNewtonKinematicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix);
+	virtual ~dNewtonKinematicBody();
+	virtual void Destroy();
+
+	// drive the body so it reaches the target pose after timestep seconds of simulation,
+	// q0 is the scalar part of the rotation, same layout as GetRotation
+	void MoveTo(dFloat px, dFloat py, dFloat pz, dFloat q0, dFloat q1, dFloat q2, dFloat q3, dFloat timestep);
+
+	private:
+	dNewtonKinematicBody(dNewtonWorld* const world, NewtonBody* const body, dNewtonCollision* const collision);
+	virtual NewtonBody* CreateNewtonBody(const NewtonCollision* const shape, const dMatrix& matrix, dFloat mass) const;
+	void UpdateTarget(dFloat timestep);
+
+	dVector m_targetPosit;
+	dQuaternion m_targetRotation;
+	dFloat m_targetTime;
+	dList<dNewtonKinematicBody*>::dListNode* m_moverNode;
+
+	friend class dNewtonWorld;
 };
 
 class dNewtonDynamicBody: public dNewtonBody
@@ -123,6 +195,7 @@ class dNewtonDynamicBody: public dNewtonBody
 	dNewtonDynamicBody(dNewtonWorld* const world, dNewtonCollision* const collision, dMatrix matrix, dFloat mass);
 
 	private:
+	dNewtonDynamicBody(dNewtonWorld* const world, NewtonBody* const body, dNewtonCollision* const collision);
 	virtual void OnForceAndTorque(dFloat timestep, int threadIndex);
 	virtual void InitForceAccumulators();
 
@@ -131,6 +204,8 @@ class dNewtonDynamicBody: public dNewtonBody
 
 	dVector m_externalForce;
 	dVector m_externalTorque;
+
+	friend class dNewtonWorld;
 };
 
 #endif
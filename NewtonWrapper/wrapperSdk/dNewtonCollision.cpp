@@ -23,6 +23,9 @@
 #include "dNewtonBody.h"
 #include "dNewtonWorld.h"
 #include "dNewtonCollision.h"
+#include "dNewtonSharedGeometry.h"
+
+#define D_COOKED_SHAPE_MAGIC	0x4e574b31
 
 class DebugCallBack
 {
@@ -31,6 +34,257 @@ class DebugCallBack
 	OnDrawFaceCallback m_callback;
 };
 
+// a cooked shape is this header followed by the newton serialization of the shape
+class dNewtonCookedShapeHeader
+{
+	public:
+	int m_magic;
+	int m_newtonVersion;
+	int m_floatSize;
+	int m_dataSize;
+};
+
+// maps every vertex to the first vertex with the same position, so seams split by uvs or normals
+// do not leave cracks and faces that collapse after welding are dropped
+class dVertexWelder
+{
+	public:
+	dVertexWelder(const dFloat* const vertices, int vertexCount)
+		:m_remap(new int[dMax(vertexCount, 1)])
+	{
+		int capacity = 16;
+		while (capacity < vertexCount * 2) {
+			capacity *= 2;
+		}
+		int* const table = new int[capacity];
+		memset(table, -1, capacity * sizeof(int));
+
+		for (int i = 0; i < vertexCount; i++) {
+			const dFloat* const p = &vertices[i * 3];
+			unsigned hash = 2166136261u;
+			for (int j = 0; j < 3; j++) {
+				// adding zero folds -0 into 0, they are the same position
+				const float value = float(p[j]) + 0.0f;
+				unsigned bits;
+				memcpy(&bits, &value, sizeof(bits));
+				hash = (hash ^ bits) * 16777619u;
+			}
+
+			int slot = int(hash & (capacity - 1));
+			m_remap[i] = i;
+			while (table[slot] >= 0) {
+				const dFloat* const q = &vertices[table[slot] * 3];
+				if ((p[0] == q[0]) && (p[1] == q[1]) && (p[2] == q[2])) {
+					m_remap[i] = table[slot];
+					break;
+				}
+				slot = (slot + 1) & (capacity - 1);
+			}
+			if (m_remap[i] == i) {
+				table[slot] = i;
+			}
+		}
+		delete[] table;
+	}
+
+	~dVertexWelder()
+	{
+		delete[] m_remap;
+	}
+
+	int* m_remap;
+};
+
+// triangles are split at the median of their centroids along the longest axis until every chunk is small enough,
+// the chunk trees are then built by jobs on the world threads, each job takes the next chunk not yet built
+class dChunkedMeshBuilder
+{
+	public:
+	class dFace
+	{
+		public:
+		float m_centroid[3];
+		int m_triangle;
+	};
+
+	class dChunk
+	{
+		public:
+		NewtonCollision* m_shape;
+		int m_first;
+		int m_count;
+	};
+
+	dChunkedMeshBuilder(const dFloat* const vertices, const int* const remap, const int* const indices, const int* const faceAttributes, int faceCount, int trianglesPerChunk, bool optimize)
+		:m_vertices(vertices)
+		,m_remap(remap)
+		,m_indices(indices)
+		,m_faceAttributes(faceAttributes)
+		,m_faces(new dFace[dMax(faceCount, 1)])
+		,m_chunks(new dChunk[dMax(faceCount, 1)])
+		,m_faceCount(0)
+		,m_chunkCount(0)
+		,m_nextChunk(0)
+		,m_trianglesPerChunk(dMax(trianglesPerChunk, 1))
+		,m_optimize(optimize)
+	{
+	}
+
+	~dChunkedMeshBuilder()
+	{
+		delete[] m_chunks;
+		delete[] m_faces;
+	}
+
+	void AddFace(int triangle)
+	{
+		dFace& face = m_faces[m_faceCount];
+		const int* const index = &m_indices[triangle * 3];
+		for (int j = 0; j < 3; j++) {
+			const dFloat sum = m_vertices[m_remap[index[0]] * 3 + j] + m_vertices[m_remap[index[1]] * 3 + j] + m_vertices[m_remap[index[2]] * 3 + j];
+			face.m_centroid[j] = float(sum * (1.0f / 3.0f));
+		}
+		face.m_triangle = triangle;
+		m_faceCount++;
+	}
+
+	template<int axis>
+	static int CompareFaces(const void* const elem0, const void* const elem1)
+	{
+		const float c0 = ((const dFace*)elem0)->m_centroid[axis];
+		const float c1 = ((const dFace*)elem1)->m_centroid[axis];
+		return (c0 < c1) ? -1 : ((c0 > c1) ? 1 : 0);
+	}
+
+	void Partition(int first, int count)
+	{
+		if (count <= m_trianglesPerChunk) {
+			dChunk& chunk = m_chunks[m_chunkCount];
+			chunk.m_shape = NULL;
+			chunk.m_first = first;
+			chunk.m_count = count;
+			m_chunkCount++;
+			return;
+		}
+
+		float minBox[3];
+		float maxBox[3];
+		for (int j = 0; j < 3; j++) {
+			minBox[j] = m_faces[first].m_centroid[j];
+			maxBox[j] = m_faces[first].m_centroid[j];
+		}
+		for (int i = first + 1; i < first + count; i++) {
+			for (int j = 0; j < 3; j++) {
+				minBox[j] = dMin(minBox[j], m_faces[i].m_centroid[j]);
+				maxBox[j] = dMax(maxBox[j], m_faces[i].m_centroid[j]);
+			}
+		}
+
+		int axis = 0;
+		for (int j = 1; j < 3; j++) {
+			if ((maxBox[j] - minBox[j]) > (maxBox[axis] - minBox[axis])) {
+				axis = j;
+			}
+		}
+		static int (* const compare[])(const void* const elem0, const void* const elem1) = {CompareFaces<0>, CompareFaces<1>, CompareFaces<2>};
+		qsort(&m_faces[first], count, sizeof(dFace), compare[axis]);
+
+		const int half = count / 2;
+		Partition(first, half);
+		Partition(first + half, count - half);
+	}
+
+	void BuildChunk(const dChunk& chunk) const
+	{
+		NewtonCollision* const shape = chunk.m_shape;
+		NewtonTreeCollisionBeginBuild(shape);
+		for (int i = chunk.m_first; i < chunk.m_first + chunk.m_count; i++) {
+			const int triangle = m_faces[i].m_triangle;
+			const int* const index = &m_indices[triangle * 3];
+			const int j0 = m_remap[index[0]];
+			const int j1 = m_remap[index[1]];
+			const int j2 = m_remap[index[2]];
+			const dFloat face[] = {
+				m_vertices[j0 * 3 + 0], m_vertices[j0 * 3 + 1], m_vertices[j0 * 3 + 2],
+				m_vertices[j1 * 3 + 0], m_vertices[j1 * 3 + 1], m_vertices[j1 * 3 + 2],
+				m_vertices[j2 * 3 + 0], m_vertices[j2 * 3 + 1], m_vertices[j2 * 3 + 2]};
+			NewtonTreeCollisionAddFace(shape, 3, face, 3 * sizeof(dFloat), m_faceAttributes ? m_faceAttributes[triangle] : 0);
+		}
+		NewtonTreeCollisionEndBuild(shape, m_optimize ? 1 : 0);
+	}
+
+	static void BuildChunks(NewtonWorld* const world, void* const userData, int threadIndex)
+	{
+		// the atomic add returns the value before the add, every chunk is taken exactly once
+		dChunkedMeshBuilder* const builder = (dChunkedMeshBuilder*)userData;
+		for (int i = NewtonAtomicAdd(&builder->m_nextChunk, 1); i < builder->m_chunkCount; i = NewtonAtomicAdd(&builder->m_nextChunk, 1)) {
+			builder->BuildChunk(builder->m_chunks[i]);
+		}
+	}
+
+	const dFloat* m_vertices;
+	const int* m_remap;
+	const int* m_indices;
+	const int* m_faceAttributes;
+	dFace* m_faces;
+	dChunk* m_chunks;
+	int m_faceCount;
+	int m_chunkCount;
+	int m_nextChunk;
+	int m_trianglesPerChunk;
+	bool m_optimize;
+};
+
+class dCookedShapeWriter
+{
+	public:
+	dCookedShapeWriter(void* const buffer, int capacity)
+		:m_buffer((char*)buffer)
+		,m_capacity(capacity)
+		,m_size(0)
+	{
+	}
+
+	static void Write(void* const serializeHandle, const void* const data, int size)
+	{
+		// the size is always counted, so a NULL buffer measures the shape
+		dCookedShapeWriter* const writer = (dCookedShapeWriter*)serializeHandle;
+		if (writer->m_buffer && (writer->m_size + size <= writer->m_capacity)) {
+			memcpy(writer->m_buffer + writer->m_size, data, size);
+		}
+		writer->m_size += size;
+	}
+
+	char* m_buffer;
+	int m_capacity;
+	int m_size;
+};
+
+class dCookedShapeReader
+{
+	public:
+	dCookedShapeReader(const void* const data, int size)
+		:m_data((const char*)data)
+		,m_size(size)
+		,m_position(0)
+	{
+	}
+
+	static void Read(void* const serializeHandle, void* const data, int size)
+	{
+		// newton can not report a short stream, the missing bytes read as zeros
+		dCookedShapeReader* const reader = (dCookedShapeReader*)serializeHandle;
+		const int available = dMin(size, reader->m_size - reader->m_position);
+		memcpy(data, reader->m_data + reader->m_position, available);
+		memset((char*)data + available, 0, size - available);
+		reader->m_position += available;
+	}
+
+	const char* m_data;
+	int m_size;
+	int m_position;
+};
+
 dMatrix dNewtonCollision::m_primitiveAligment(dVector(0.0f, 1.0f, 0.0f, 0.0f), dVector(-1.0f, 0.0f, 0.0f, 0.0f), dVector(0.0f, 0.0f, 1.0f, 0.0f), dVector(0.0f, 0.0f, 0.0f, 1.0f));
 
 
@@ -38,12 +292,21 @@ dNewtonCollision::dNewtonCollision(dNewtonWorld* const world, dLong collisionMas
 	:dAlloc()
 	,m_shape(NULL)
 	,m_myWorld(world)
+	,m_collisionCacheNode(NULL)
+	,m_commitNode(NULL)
+	,m_pendingBuild(NULL)
+	,m_ownerBody(NULL)
 	,m_materialID(0)
+	,m_layer(0)
 {
 }
 
 dNewtonCollision::~dNewtonCollision()
 {
+	if (m_shape && !m_ownerBody) {
+		m_myWorld->DetachPendingCollision(this);
+	}
+	m_myWorld->CancelPendingShape(this);
 	DeleteShape();
 }
 
@@ -69,19 +332,85 @@ void dNewtonCollision::SetLayer(int layer)
 	m_layer = layer;
 }
 
+int dNewtonCollision::GetMaterialID(int faceAttribute) const
+{
+	return m_materialID;
+}
+
+int dNewtonCollision::Cook(void* const buffer, int bufferSize) const
+{
+	if (!m_shape) {
+		return 0;
+	}
+
+	// children of a loaded compound or scene would have no wrapper to read their material from
+	const int type = NewtonCollisionGetType(m_shape);
+	if ((type == SERIALIZE_ID_COMPOUND) || (type == SERIALIZE_ID_SCENE)) {
+		return 0;
+	}
+
+	dNewtonCookedShapeHeader header;
+	header.m_magic = D_COOKED_SHAPE_MAGIC;
+	header.m_newtonVersion = NewtonWorldGetVersion();
+	header.m_floatSize = NewtonWorldFloatSize();
+	header.m_dataSize = 0;
+
+	char* const data = buffer ? (char*)buffer + sizeof(header) : NULL;
+	dCookedShapeWriter writer(data, bufferSize - int(sizeof(header)));
+	NewtonCollisionSerialize(m_myWorld->m_world, m_shape, dCookedShapeWriter::Write, &writer);
+
+	header.m_dataSize = writer.m_size;
+	const int size = int(sizeof(header)) + writer.m_size;
+	if (!buffer) {
+		return size;
+	}
+	if (size > bufferSize) {
+		return 0;
+	}
+	memcpy(buffer, &header, sizeof(header));
+	return size;
+}
+
 void dNewtonCollision::DeleteShape()
 {
 	if (m_shape) {
-		NewtonWaitForUpdateToFinish(m_myWorld->m_world);
 		NewtonCollisionSetUserData(m_shape, NULL);
-		NewtonDestroyCollision(m_shape);
+		if (!m_ownerBody) {
+			// an instance owned by a body goes away with the body
+			m_myWorld->ReleaseShape(m_shape);
+		}
 
 		m_myWorld->m_collisionCache.Remove(m_collisionCacheNode);
 		m_shape = NULL;
+		m_ownerBody = NULL;
 		m_collisionCacheNode = NULL;
 	}
 }
 
+void dNewtonCollision::TransferShapeToBody(NewtonBody* const body)
+{
+	dAssert(m_shape && !m_ownerBody);
+	NewtonCollision* const bodyShape = NewtonBodyGetCollision(body);
+
+	NewtonCollisionSetUserData(m_shape, NULL);
+	m_myWorld->ReleaseShape(m_shape);
+
+	m_shape = bodyShape;
+	m_ownerBody = body;
+	NewtonCollisionSetUserData(m_shape, this);
+}
+
+void dNewtonCollision::TransferShapeFromBody()
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	dAssert(m_shape && m_ownerBody);
+	NewtonCollisionSetUserData(m_shape, NULL);
+
+	m_shape = NewtonCollisionCreateInstance(m_shape);
+	m_ownerBody = NULL;
+	NewtonCollisionSetUserData(m_shape, this);
+}
+
 void dNewtonCollision::SetShape(NewtonCollision* const shape)
 {
 	m_shape = shape;
@@ -89,6 +418,47 @@ void dNewtonCollision::SetShape(NewtonCollision* const shape)
 	m_collisionCacheNode = m_myWorld->m_collisionCache.Append(this);
 }
 
+void dNewtonCollision::CreateCachedShape(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes)
+{
+	if (m_myWorld->m_updateInFlight && !m_myWorld->FindCachedShape(key)) {
+		// an instance only copies the stand in and counts a reference, that is safe while the step runs
+		SetShape(NewtonCollisionCreateInstance(m_myWorld->m_shapeStandIn));
+		m_pendingBuild = new dNewtonShapeBuild(key, create, data, sizeInBytes);
+		QueuePendingShape();
+	} else {
+		NewtonCollision* const shape = m_myWorld->CreateCachedShape(key, create, data, sizeInBytes);
+		if (shape) {
+			SetShape(shape);
+		}
+	}
+}
+
+void dNewtonCollision::CommitPendingShape()
+{
+	if (m_pendingBuild) {
+		dAssert(!m_ownerBody);
+		m_shape = m_myWorld->CommitShapeBuild(*m_pendingBuild, m_shape);
+		delete m_pendingBuild;
+		m_pendingBuild = NULL;
+	}
+}
+
+void dNewtonCollision::QueuePendingShape()
+{
+	if (!m_commitNode) {
+		m_commitNode = m_myWorld->m_shapeCommitQueue.Append(this);
+	}
+}
+
+void dNewtonCollision::FlushPendingShape()
+{
+	if (m_commitNode) {
+		m_myWorld->m_shapeCommitQueue.Remove(m_commitNode);
+		m_commitNode = NULL;
+		CommitPendingShape();
+	}
+}
+
 void dNewtonCollision::DebugRenderCallback(void* userData, int vertexCount, const dFloat* faceVertec, int id)
 {
 	DebugCallBack* const callbackInfo = (DebugCallBack*)userData;
@@ -137,23 +507,46 @@ void dNewtonCollision::SetMatrix(const dMatrix matrix)
 dNewtonCollisionNull::dNewtonCollisionNull(dNewtonWorld* const world)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateNull(m_myWorld->m_world));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dNewtonShapeKey key(SERIALIZE_ID_NULL);
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionNull::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	return NewtonCreateNull(world);
 }
 
 dNewtonCollisionSphere::dNewtonCollisionSphere(dNewtonWorld* const world, dFloat r)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateSphere(m_myWorld->m_world, r, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	dNewtonShapeKey key(SERIALIZE_ID_SPHERE);
+	key.AddData(&r, sizeof(r));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionSphere::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateSphere(world, params[0], 0, NULL);
 }
 
 
 dNewtonCollisionBox::dNewtonCollisionBox(dNewtonWorld* const world, dFloat x, dFloat y, dFloat z)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateBox(m_myWorld->m_world, x, y, z, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dFloat params[] = {x, y, z};
+	dNewtonShapeKey key(SERIALIZE_ID_BOX);
+	key.AddData(params, sizeof(params));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionBox::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateBox(world, params[0], params[1], params[2], 0, NULL);
 }
 
 
@@ -176,45 +569,154 @@ void dNewtonAlignedShapes::SetMatrix(const dMatrix matrix)
 dNewtonCollisionCapsule::dNewtonCollisionCapsule(dNewtonWorld* const world, dFloat radio0, dFloat radio1, dFloat height)
 	:dNewtonAlignedShapes(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateCapsule(m_myWorld->m_world, radio0, radio1, height, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dFloat params[] = {radio0, radio1, height};
+	dNewtonShapeKey key(SERIALIZE_ID_CAPSULE);
+	key.AddData(params, sizeof(params));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionCapsule::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateCapsule(world, params[0], params[1], params[2], 0, NULL);
 }
 
 
 dNewtonCollisionCylinder::dNewtonCollisionCylinder(dNewtonWorld* const world, dFloat radio0, dFloat radio1, dFloat height)
 	:dNewtonAlignedShapes(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateCylinder(m_myWorld->m_world, radio0, radio1, height, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dFloat params[] = {radio0, radio1, height};
+	dNewtonShapeKey key(SERIALIZE_ID_CYLINDER);
+	key.AddData(params, sizeof(params));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionCylinder::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateCylinder(world, params[0], params[1], params[2], 0, NULL);
 }
 
 dNewtonCollisionCone::dNewtonCollisionCone(dNewtonWorld* const world, dFloat radio, dFloat height)
 	:dNewtonAlignedShapes(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateCone(m_myWorld->m_world, radio, height, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dFloat params[] = {radio, height};
+	dNewtonShapeKey key(SERIALIZE_ID_CONE);
+	key.AddData(params, sizeof(params));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionCone::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateCone(world, params[0], params[1], 0, NULL);
 }
 
 
 dNewtonCollisionChamferedCylinder::dNewtonCollisionChamferedCylinder(dNewtonWorld* const world, dFloat radio, dFloat height)
 	:dNewtonAlignedShapes(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateChamferCylinder(m_myWorld->m_world, radio, height, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	const dFloat params[] = {radio, height};
+	dNewtonShapeKey key(SERIALIZE_ID_CHAMFERCYLINDER);
+	key.AddData(params, sizeof(params));
+	CreateCachedShape(key, CreatePrototype, NULL, 0);
+}
+
+NewtonCollision* dNewtonCollisionChamferedCylinder::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateChamferCylinder(world, params[0], params[1], 0, NULL);
 }
 
 dNewtonCollisionConvexHull::dNewtonCollisionConvexHull(dNewtonWorld* const world, int vertexCount, const dFloat* const vertexCloud, dFloat tolerance)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
-	SetShape(NewtonCreateConvexHull(m_myWorld->m_world, vertexCount, vertexCloud, 3 * sizeof (dFloat), tolerance, 0, NULL));
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	// hull keys take the tolerance together with the whole vertex cloud
+	dNewtonShapeKey key(SERIALIZE_ID_CONVEXHULL);
+	key.AddData(&tolerance, sizeof(tolerance));
+	key.AddData(vertexCloud, vertexCount * 3 * sizeof (dFloat));
+	CreateCachedShape(key, CreatePrototype, vertexCloud, vertexCount * 3 * sizeof (dFloat));
+}
+
+NewtonCollision* dNewtonCollisionConvexHull::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	// the tolerance leads the key, the cloud comes as data
+	const dFloat* const params = (const dFloat*)key.m_params;
+	return NewtonCreateConvexHull(world, sizeInBytes / (3 * sizeof (dFloat)), (const dFloat*)data, 3 * sizeof (dFloat), params[0], 0, NULL);
+}
+
+dNewtonCollisionCooked::dNewtonCollisionCooked(dNewtonWorld* const world, const void* const data, int sizeInBytes)
+	:dNewtonCollision(world, 0)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	dNewtonCookedShapeHeader header;
+	if (!data || (sizeInBytes < int(sizeof(header)))) {
+		return;
+	}
+	memcpy(&header, data, sizeof(header));
+	if ((header.m_magic != D_COOKED_SHAPE_MAGIC) || (header.m_newtonVersion != NewtonWorldGetVersion()) ||
+		(header.m_floatSize != NewtonWorldFloatSize()) || (header.m_dataSize <= 0) || (header.m_dataSize > sizeInBytes - int(sizeof(header)))) {
+		return;
+	}
+
+	const char* const shapeData = (const char*)data + sizeof(header);
+	dNewtonShapeKey key(D_COOKED_SHAPE_MAGIC);
+	key.AddData(shapeData, header.m_dataSize);
+	CreateCachedShape(key, CreatePrototype, shapeData, header.m_dataSize);
+}
+
+NewtonCollision* dNewtonCollisionCooked::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	dCookedShapeReader reader((const char*)data, sizeInBytes);
+	return NewtonCreateCollisionFromSerialization(world, dCookedShapeReader::Read, &reader);
+}
+
+
+dNewtonCollisionSharedMesh::dNewtonCollisionSharedMesh(dNewtonWorld* const world, const char* const fileName)
+	:dNewtonCollision(world, 0)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	dNewtonShapeKey key(SERIALIZE_ID_USERMESH);
+	key.AddData(fileName, int(strlen(fileName)));
+
+	// user meshes never enter newton's shape list, a miss is built right away even while a step runs
+	NewtonCollision* const shape = m_myWorld->CreateCachedShape(key, CreatePrototype, fileName, int(strlen(fileName)) + 1);
+	if (shape) {
+		SetShape(shape);
+	}
+}
+
+NewtonCollision* dNewtonCollisionSharedMesh::CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes)
+{
+	NewtonCollision* shape = NULL;
+	dNewtonSharedGeometry* const geometry = dNewtonSharedGeometry::Acquire((const char*)data);
+	if (geometry) {
+		shape = geometry->CreateShape(world);
+		geometry->Release();
+	}
+	return shape;
+}
+
+bool dNewtonCollisionSharedMesh::CookMesh(const char* const fileName, const dFloat* const vertices, int vertexCount, const int* const indices, const int* const attributes, int triangleCount)
+{
+	return dNewtonSharedGeometry::CookMesh(fileName, vertices, vertexCount, indices, attributes, triangleCount);
+}
+
+bool dNewtonCollisionSharedMesh::CookHeightField(const char* const fileName, const dFloat* const elevations, int width, int height, dFloat cellSizeX, dFloat cellSizeZ, const int* const attributes)
+{
+	return dNewtonSharedGeometry::CookHeightField(fileName, elevations, width, height, cellSizeX, cellSizeZ, attributes);
 }
 
 
 dNewtonCollisionMesh::dNewtonCollisionMesh(dNewtonWorld* const world)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
 	SetShape(NewtonCreateTreeCollision(m_myWorld->m_world, 0));
 }
 
@@ -229,6 +731,32 @@ void dNewtonCollisionMesh::AddFace(int vertexCount, const dFloat* const vertexPt
 	NewtonTreeCollisionAddFace(m_shape, vertexCount, vertexPtr, strideInBytes, faceAttribute);
 }
 
+void dNewtonCollisionMesh::AddMesh(const dFloat* const vertices, int vertexCount, const int* const indices, int indexCount, const int* const faceAttributes)
+{
+	dVertexWelder welder(vertices, vertexCount);
+	for (int i = 0; i + 2 < indexCount; i += 3) {
+		const int i0 = indices[i + 0];
+		const int i1 = indices[i + 1];
+		const int i2 = indices[i + 2];
+		if ((i0 < 0) || (i1 < 0) || (i2 < 0) || (i0 >= vertexCount) || (i1 >= vertexCount) || (i2 >= vertexCount)) {
+			continue;
+		}
+
+		const int j0 = welder.m_remap[i0];
+		const int j1 = welder.m_remap[i1];
+		const int j2 = welder.m_remap[i2];
+		if ((j0 == j1) || (j1 == j2) || (j2 == j0)) {
+			continue;
+		}
+
+		const dFloat face[] = {
+			vertices[j0 * 3 + 0], vertices[j0 * 3 + 1], vertices[j0 * 3 + 2],
+			vertices[j1 * 3 + 0], vertices[j1 * 3 + 1], vertices[j1 * 3 + 2],
+			vertices[j2 * 3 + 0], vertices[j2 * 3 + 1], vertices[j2 * 3 + 2]};
+		NewtonTreeCollisionAddFace(m_shape, 3, face, 3 * sizeof(dFloat), faceAttributes ? faceAttributes[i / 3] : 0);
+	}
+}
+
 void dNewtonCollisionMesh::EndFace(bool optimize)
 {
 	NewtonTreeCollisionEndBuild(m_shape, optimize ? 1 : 0);
@@ -236,11 +764,22 @@ void dNewtonCollisionMesh::EndFace(bool optimize)
 
 dNewtonCollisionCompound::dNewtonCollisionCompound(dNewtonWorld* const world)
 	:dNewtonCollision(world, 0)
+	,m_children()
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
 	SetShape(NewtonCreateCompoundCollision(m_myWorld->m_world, 0));
 }
 
+dNewtonCollisionCompound::~dNewtonCollisionCompound()
+{
+	// the compound goes first, its children point at the child wrappers
+	DeleteShape();
+	for (dList<dNewtonCollision*>::dListNode* node = m_children.GetFirst(); node; node = node->GetNext()) {
+		delete node->GetInfo();
+	}
+	m_children.RemoveAll();
+}
+
 void dNewtonCollisionCompound::BeginAddRemoveCollision()
 {
 	NewtonCompoundCollisionBeginAddRemove(m_shape);
@@ -248,12 +787,28 @@ void dNewtonCollisionCompound::BeginAddRemoveCollision()
 
 void* dNewtonCollisionCompound::AddCollision(dNewtonCollision* const collision)
 {
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (collision->m_pendingBuild) {
+		// the compound copies its children, the stand in would stay a null child
+		m_myWorld->AddPendingChild(m_shape, collision);
+		return NULL;
+	}
 	return NewtonCompoundCollisionAddSubCollision(m_shape, collision->m_shape);
 }
 
 void dNewtonCollisionCompound::RemoveCollision(void* const handle)
 {
+	dNewtonCollision* const child = GetChildFromNode(handle);
 	NewtonCompoundCollisionRemoveSubCollision(m_shape, handle);
+
+	// children made by AddCollisions die with their node
+	for (dList<dNewtonCollision*>::dListNode* node = m_children.GetFirst(); node; node = node->GetNext()) {
+		if (node->GetInfo() == child) {
+			delete child;
+			m_children.Remove(node);
+			break;
+		}
+	}
 }
 
 void dNewtonCollisionCompound::EndAddRemoveCollision()
@@ -261,25 +816,686 @@ void dNewtonCollisionCompound::EndAddRemoveCollision()
 	NewtonCompoundCollisionEndAddRemove(m_shape);
 }
 
-dNewtonCollisionHeightField::dNewtonCollisionHeightField(dNewtonWorld* const world, const dFloat* const elevations, int resolution, dVector scale)
+dNewtonCollision* dNewtonCollisionCompound::CreateChild(const dNewtonCompoundChild& desc, const dFloat* const points, int pointCount)
+{
+	const dFloat* const params = desc.m_params;
+	dNewtonCollision* child = NULL;
+	switch (desc.m_shapeType)
+	{
+		case m_null:
+			child = new dNewtonCollisionNull(m_myWorld);
+			break;
+		case m_sphere:
+			child = new dNewtonCollisionSphere(m_myWorld, params[0]);
+			break;
+		case m_box:
+			child = new dNewtonCollisionBox(m_myWorld, params[0], params[1], params[2]);
+			break;
+		case m_capsule:
+			child = new dNewtonCollisionCapsule(m_myWorld, params[0], params[1], params[2]);
+			break;
+		case m_cylinder:
+			child = new dNewtonCollisionCylinder(m_myWorld, params[0], params[1], params[2]);
+			break;
+		case m_cone:
+			child = new dNewtonCollisionCone(m_myWorld, params[0], params[1]);
+			break;
+		case m_chamferedCylinder:
+			child = new dNewtonCollisionChamferedCylinder(m_myWorld, params[0], params[1]);
+			break;
+		case m_convexHull:
+		{
+			const int first = int(params[0]);
+			const int count = int(params[1]);
+			if (points && (first >= 0) && (count >= 4) && (first + count <= pointCount)) {
+				child = new dNewtonCollisionConvexHull(m_myWorld, count, &points[first * 3], params[2]);
+			}
+			break;
+		}
+	}
+
+	if (child && !child->m_shape) {
+		delete child;
+		child = NULL;
+	}
+	if (child) {
+		if ((desc.m_scale[0] != 0.0f) || (desc.m_scale[1] != 0.0f) || (desc.m_scale[2] != 0.0f)) {
+			child->SetScale(desc.m_scale[0], desc.m_scale[1], desc.m_scale[2]);
+		}
+		child->SetMatrix(dMatrix(desc.m_matrix));
+		child->SetMaterialID(desc.m_materialID);
+		child->SetLayer(desc.m_layer);
+	}
+	return child;
+}
+
+int dNewtonCollisionCompound::AddCollisions(const void* const children, int count, const dFloat* const points, int pointCount)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (!m_shape || !children) {
+		return 0;
+	}
+
+	int added = 0;
+	const dNewtonCompoundChild* const descs = (const dNewtonCompoundChild*)children;
+	NewtonCompoundCollisionBeginAddRemove(m_shape);
+	for (int i = 0; i < count; i++) {
+		dNewtonCollision* const child = CreateChild(descs[i], points, pointCount);
+		if (child) {
+			if (child->m_pendingBuild) {
+				m_myWorld->AddPendingChild(m_shape, child);
+			} else {
+				NewtonCompoundCollisionAddSubCollision(m_shape, child->m_shape);
+			}
+			m_children.Append(child);
+			added++;
+		}
+	}
+	NewtonCompoundCollisionEndAddRemove(m_shape);
+	return added;
+}
+
+int dNewtonCollisionCompound::GetChildren(void* const children, int maxCount) const
+{
+	dNewtonCompoundChild* const descs = (dNewtonCompoundChild*)children;
+	int count = 0;
+	for (void* node = NewtonCompoundCollisionGetFirstNode(m_shape); node; node = NewtonCompoundCollisionGetNextNode(m_shape, node)) {
+		if (descs && (count < maxCount)) {
+			NewtonCollision* const shape = NewtonCompoundCollisionGetCollisionFromNode(m_shape, node);
+			const dNewtonCollision* const wrapper = (dNewtonCollision*)NewtonCollisionGetUserData(shape);
+			dNewtonCompoundChild& desc = descs[count];
+			memset(&desc, 0, sizeof(desc));
+
+			NewtonCollisionInfoRecord info;
+			NewtonCollisionGetInfo(shape, &info);
+			bool aligned = false;
+			switch (NewtonCollisionGetType(shape))
+			{
+				case SERIALIZE_ID_SPHERE:
+					desc.m_shapeType = m_sphere;
+					break;
+				case SERIALIZE_ID_BOX:
+					desc.m_shapeType = m_box;
+					break;
+				case SERIALIZE_ID_CAPSULE:
+					desc.m_shapeType = m_capsule;
+					aligned = true;
+					break;
+				case SERIALIZE_ID_CYLINDER:
+					desc.m_shapeType = m_cylinder;
+					aligned = true;
+					break;
+				case SERIALIZE_ID_CONE:
+					desc.m_shapeType = m_cone;
+					aligned = true;
+					break;
+				case SERIALIZE_ID_CHAMFERCYLINDER:
+					desc.m_shapeType = m_chamferedCylinder;
+					aligned = true;
+					break;
+				case SERIALIZE_ID_CONVEXHULL:
+					desc.m_shapeType = m_convexHull;
+					break;
+				default:
+					desc.m_shapeType = m_null;
+			}
+
+			if (desc.m_shapeType == m_convexHull) {
+				desc.m_params[1] = dFloat(info.m_convexHull.m_vertexCount);
+			} else if (desc.m_shapeType != m_null) {
+				// the primitive params all start the info union
+				for (int i = 0; i < 4; i++) {
+					desc.m_params[i] = info.m_paramArray[i];
+				}
+			}
+
+			dMatrix matrix;
+			dVector scale(0.0f);
+			NewtonCollisionGetMatrix(shape, &matrix[0][0]);
+			NewtonCollisionGetScale(shape, &scale.m_x, &scale.m_y, &scale.m_z);
+			if (aligned) {
+				// undo the axis alignment dNewtonAlignedShapes applies, so the child reads back as it was built
+				matrix = m_primitiveAligment.Inverse() * matrix;
+				scale = m_primitiveAligment.UnrotateVector(scale);
+			}
+			for (int i = 0; i < 4; i++) {
+				for (int j = 0; j < 4; j++) {
+					desc.m_matrix[i * 4 + j] = matrix[i][j];
+				}
+			}
+			desc.m_scale[0] = dAbs(scale.m_x);
+			desc.m_scale[1] = dAbs(scale.m_y);
+			desc.m_scale[2] = dAbs(scale.m_z);
+			desc.m_materialID = wrapper ? wrapper->m_materialID : 0;
+			desc.m_layer = wrapper ? wrapper->m_layer : 0;
+		}
+		count++;
+	}
+	return count;
+}
+
+int dNewtonCollisionCompound::GetChildCount() const
+{
+	return GetChildren(NULL, 0);
+}
+
+void* dNewtonCollisionCompound::GetFirstNode() const
+{
+	return NewtonCompoundCollisionGetFirstNode(m_shape);
+}
+
+void* dNewtonCollisionCompound::GetNextNode(void* const collisionNode) const
+{
+	return NewtonCompoundCollisionGetNextNode(m_shape, collisionNode);
+}
+
+dNewtonCollision* dNewtonCollisionCompound::GetChildFromNode(void* const collisionNode) const
+{
+	return (dNewtonCollision*)NewtonCollisionGetUserData(NewtonCompoundCollisionGetCollisionFromNode(m_shape, collisionNode));
+}
+
+dNewtonCollisionChunkedMesh::dNewtonCollisionChunkedMesh(dNewtonWorld* const world, const dFloat* const vertices, int vertexCount, const int* const indices, int indexCount, const int* const faceAttributes, int trianglesPerChunk, bool optimize)
 	:dNewtonCollision(world, 0)
+	,m_chunks()
 {
-	char* const attibute = new char[resolution * resolution];
-	memset(attibute, 0, sizeof(char) * resolution * resolution);
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	dVertexWelder welder(vertices, vertexCount);
+	dChunkedMeshBuilder builder(vertices, welder.m_remap, indices, faceAttributes, indexCount / 3, trianglesPerChunk, optimize);
+	for (int i = 0; i + 2 < indexCount; i += 3) {
+		const int i0 = indices[i + 0];
+		const int i1 = indices[i + 1];
+		const int i2 = indices[i + 2];
+		if ((i0 < 0) || (i1 < 0) || (i2 < 0) || (i0 >= vertexCount) || (i1 >= vertexCount) || (i2 >= vertexCount)) {
+			continue;
+		}
+		const int j0 = welder.m_remap[i0];
+		const int j1 = welder.m_remap[i1];
+		const int j2 = welder.m_remap[i2];
+		if ((j0 != j1) && (j1 != j2) && (j2 != j0)) {
+			builder.AddFace(i / 3);
+		}
+	}
+	if (!builder.m_faceCount) {
+		return;
+	}
+	builder.Partition(0, builder.m_faceCount);
+
+	// shapes are created and added to the scene on the calling thread, only the tree builds run in parallel
+	for (int i = 0; i < builder.m_chunkCount; i++) {
+		dNewtonCollisionMesh* const chunk = new dNewtonCollisionMesh(m_myWorld);
+		builder.m_chunks[i].m_shape = chunk->m_shape;
+		m_chunks.Append(chunk);
+	}
+
+	// the world threads are busy while a step is in flight, the caller then builds every chunk itself
+	if (!m_myWorld->m_updateInFlight) {
+		const int jobCount = dMin(NewtonGetThreadsCount(m_myWorld->m_world), builder.m_chunkCount);
+		for (int i = 0; i < jobCount; i++) {
+			NewtonDispachThreadJob(m_myWorld->m_world, dChunkedMeshBuilder::BuildChunks, &builder, "BuildMeshChunks");
+		}
+		NewtonSyncThreadJobs(m_myWorld->m_world);
+	}
+
+	// a world without worker threads may leave chunks to the caller
+	dChunkedMeshBuilder::BuildChunks(m_myWorld->m_world, &builder, 0);
+
+	SetShape(NewtonCreateSceneCollision(m_myWorld->m_world, 0));
+	NewtonSceneCollisionBeginAddRemove(m_shape);
+	for (dList<dNewtonCollisionMesh*>::dListNode* node = m_chunks.GetFirst(); node; node = node->GetNext()) {
+		NewtonSceneCollisionAddSubCollision(m_shape, node->GetInfo()->m_shape);
+	}
+	NewtonSceneCollisionEndAddRemove(m_shape);
+}
 
+dNewtonCollisionChunkedMesh::~dNewtonCollisionChunkedMesh()
+{
+	// the scene goes first, its children point at the chunk wrappers
+	DeleteShape();
+	for (dList<dNewtonCollisionMesh*>::dListNode* node = m_chunks.GetFirst(); node; node = node->GetNext()) {
+		delete node->GetInfo();
+	}
+	m_chunks.RemoveAll();
+}
+
+void dNewtonCollisionChunkedMesh::SetMaterialID(int materialId)
+{
+	dNewtonCollision::SetMaterialID(materialId);
+	for (dList<dNewtonCollisionMesh*>::dListNode* node = m_chunks.GetFirst(); node; node = node->GetNext()) {
+		node->GetInfo()->SetMaterialID(materialId);
+	}
+}
+
+void dNewtonCollisionChunkedMesh::SetLayer(int layer)
+{
+	dNewtonCollision::SetLayer(layer);
+	for (dList<dNewtonCollisionMesh*>::dListNode* node = m_chunks.GetFirst(); node; node = node->GetNext()) {
+		node->GetInfo()->SetLayer(layer);
+	}
+}
+
+
+// samples are kept raw, an unsigned 16 bit sample is the height over the vertical scale rounded to the nearest step
+static dFloat dHeightFieldSample(dFloat height, dFloat invVerticalScale, int format)
+{
+	dFloat sample = height * invVerticalScale;
+	if (format == dNewtonCollisionHeightField::m_unsigned16) {
+		sample = dFloat(int(dClamp(sample, dFloat(0.0f), dFloat(65535.0f)) + 0.5f));
+	}
+	return sample;
+}
+
+static void dHeightFieldSetSample(void* const samples, int index, dFloat sample, int format)
+{
+	if (format == dNewtonCollisionHeightField::m_unsigned16) {
+		((unsigned short*)samples)[index] = (unsigned short)sample;
+	} else {
+		((float*)samples)[index] = float(sample);
+	}
+}
+
+static void dHeightFieldRange(const void* const samples, int count, int format, dFloat& minSample, dFloat& maxSample)
+{
+	minSample = dFloat(1.0e10f);
+	maxSample = dFloat(-1.0e10f);
+	for (int i = 0; i < count; i++) {
+		const dFloat sample = (format == dNewtonCollisionHeightField::m_unsigned16) ? dFloat(((const unsigned short*)samples)[i]) : dFloat(((const float*)samples)[i]);
+		minSample = dMin(minSample, sample);
+		maxSample = dMax(maxSample, sample);
+	}
+}
+
+static void dQueueRegionEdit(dList<dNewtonRegionEdit>& edits, int x0, int z0, int width, int height, const dFloat* const elevations)
+{
+	dNewtonRegionEdit& edit = edits.Append()->GetInfo();
+	edit.m_elevations = new dFloat[width * height];
+	memcpy(edit.m_elevations, elevations, width * height * sizeof(dFloat));
+	edit.m_x0 = x0;
+	edit.m_z0 = z0;
+	edit.m_width = width;
+	edit.m_height = height;
+}
+
+static void dClearRegionEdits(dList<dNewtonRegionEdit>& edits)
+{
+	for (dList<dNewtonRegionEdit>::dListNode* node = edits.GetFirst(); node; node = node->GetNext()) {
+		delete[] node->GetInfo().m_elevations;
+	}
+	edits.RemoveAll();
+}
+
+dNewtonCollisionHeightField::dNewtonCollisionHeightField(dNewtonWorld* const world, const dFloat* const elevations, int resolution, dVector scale)
+	:dNewtonCollision(world, 0)
+	,m_materialTable(NULL)
+	,m_materialCount(0)
+	,m_pendingRegions()
+	,m_minSample(0.0f)
+	,m_maxSample(0.0f)
+	,m_deformable(false)
+{
 	dFloat scaleFactor = 1.0f / (resolution - 1);
-	NewtonCollision* const shape = NewtonCreateHeightFieldCollision(
-		m_myWorld->m_world, resolution, resolution, 1, 0, elevations, attibute, 1.0f, scale.m_x * scaleFactor, scale.m_z * scaleFactor, 0);
+	CreateShape(elevations, m_float32, resolution, resolution, NULL, 1.0f, scale.m_x * scaleFactor, scale.m_z * scaleFactor, false);
+}
 
-	delete[] attibute;
-	SetShape(shape);
+dNewtonCollisionHeightField::dNewtonCollisionHeightField(dNewtonWorld* const world, const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, bool deformable)
+	:dNewtonCollision(world, 0)
+	,m_materialTable(NULL)
+	,m_materialCount(0)
+	,m_pendingRegions()
+	,m_minSample(0.0f)
+	,m_maxSample(0.0f)
+	,m_deformable(false)
+{
+	CreateShape(elevations, format, width, height, attributes, verticalScale, cellSizeX, cellSizeZ, deformable);
+}
+
+dNewtonCollisionHeightField::~dNewtonCollisionHeightField()
+{
+	dClearRegionEdits(m_pendingRegions);
+	delete[] m_materialTable;
+}
+
+void dNewtonCollisionHeightField::CreateShape(const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, bool deformable)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (!elevations || (width < 2) || (height < 2) || ((format != m_float32) && (format != m_unsigned16))) {
+		return;
+	}
+
+	// newton copies the attribute map, shapes without one read the zeroed map of their world
+	const int sampleCount = width * height;
+	const char* const attributeMap = attributes ? (const char*)attributes : m_myWorld->GetZeroAttributes(sampleCount);
+
+	// terrain samples are rarely shared and hashing them costs a pass over the whole map, so height fields skip the shape cache
+	SetShape(NewtonCreateHeightFieldCollision(m_myWorld->m_world, width, height, 1, format, elevations, attributeMap, verticalScale, cellSizeX, cellSizeZ, 0));
+	if (deformable) {
+		dHeightFieldRange(elevations, sampleCount, format, m_minSample, m_maxSample);
+		m_deformable = true;
+	}
+}
+
+void dNewtonCollisionHeightField::SetMaterialTable(const int* const materialIDs, int count)
+{
+	delete[] m_materialTable;
+	m_materialTable = NULL;
+	m_materialCount = 0;
+	if (materialIDs && (count > 0)) {
+		m_materialTable = new int[count];
+		memcpy(m_materialTable, materialIDs, count * sizeof(int));
+		m_materialCount = count;
+	}
+}
+
+int dNewtonCollisionHeightField::GetMaterialID(int faceAttribute) const
+{
+	return ((faceAttribute >= 0) && (faceAttribute < m_materialCount)) ? m_materialTable[faceAttribute] : m_materialID;
+}
+
+bool dNewtonCollisionHeightField::UpdateRegion(int x0, int z0, int width, int height, const dFloat* const elevations)
+{
+	if (!m_shape || !elevations) {
+		return true;
+	}
+
+	NewtonCollisionInfoRecord info;
+	NewtonCollisionGetInfo(m_shape, &info);
+	const int x1 = dMin(x0 + width, info.m_heightField.m_width);
+	const int z1 = dMin(z0 + height, info.m_heightField.m_height);
+	const int clipX0 = dMax(x0, 0);
+	const int clipZ0 = dMax(z0, 0);
+	if ((clipX0 >= x1) || (clipZ0 >= z1)) {
+		return true;
+	}
+
+	if (m_myWorld->m_updateInFlight) {
+		dQueueRegionEdit(m_pendingRegions, x0, z0, width, height, elevations);
+		QueuePendingShape();
+		return true;
+	}
+
+	const dFloat* const source = elevations + (clipZ0 - z0) * width + (clipX0 - x0);
+	const bool inPlace = PatchRegion(clipX0, clipZ0, x1 - clipX0, z1 - clipZ0, source, width);
+
+	if (m_ownerBody) {
+		const dFloat cellX = info.m_heightField.m_horizonalScale_x;
+		const dFloat cellZ = info.m_heightField.m_horizonalScale_z;
+		dMatrix matrix;
+		dMatrix offset;
+		NewtonBodyGetMatrix(m_ownerBody, &matrix[0][0]);
+		NewtonCollisionGetMatrix(m_shape, &offset[0][0]);
+		WakeBodies(m_ownerBody, offset * matrix, dVector(clipX0 * cellX, 0.0f, clipZ0 * cellZ, 1.0f), dVector((x1 - 1) * cellX, 0.0f, (z1 - 1) * cellZ, 1.0f));
+	}
+	return inPlace;
+}
+
+void dNewtonCollisionHeightField::CommitPendingShape()
+{
+	// edits replay in the order they were made, a later one overwrites the samples of an earlier one
+	for (dList<dNewtonRegionEdit>::dListNode* node = m_pendingRegions.GetFirst(); node; node = node->GetNext()) {
+		const dNewtonRegionEdit& edit = node->GetInfo();
+		UpdateRegion(edit.m_x0, edit.m_z0, edit.m_width, edit.m_height, edit.m_elevations);
+	}
+	dClearRegionEdits(m_pendingRegions);
+}
+
+bool dNewtonCollisionHeightField::PatchRegion(int x0, int z0, int width, int height, const dFloat* const elevations, int stride)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	NewtonCollisionInfoRecord info;
+	NewtonCollisionGetInfo(m_shape, &info);
+	const NewtonHeightFieldCollisionParam& param = info.m_heightField;
+	const int format = param.m_elevationDataType;
+	const dFloat invVerticalScale = 1.0f / param.m_verticalScale;
+
+	// newton builds its bounds once, a sample inside them can be written straight into the shape
+	bool inRange = m_deformable;
+	for (int z = 0; inRange && (z < height); z++) {
+		for (int x = 0; x < width; x++) {
+			const dFloat sample = dHeightFieldSample(elevations[z * stride + x], invVerticalScale, format);
+			if ((sample < m_minSample) || (sample > m_maxSample)) {
+				inRange = false;
+				break;
+			}
+		}
+	}
+
+	void* samples = param.m_vertialElevation;
+	void* rebuildSamples = NULL;
+	if (!inRange) {
+		const int sampleSize = (format == m_float32) ? int(sizeof(float)) : int(sizeof(unsigned short));
+		rebuildSamples = new char[param.m_width * param.m_height * sampleSize];
+		memcpy(rebuildSamples, param.m_vertialElevation, param.m_width * param.m_height * sampleSize);
+		samples = rebuildSamples;
+	}
+
+	for (int z = 0; z < height; z++) {
+		for (int x = 0; x < width; x++) {
+			const dFloat sample = dHeightFieldSample(elevations[z * stride + x], invVerticalScale, format);
+			dHeightFieldSetSample(samples, (z0 + z) * param.m_width + x0 + x, sample, format);
+		}
+	}
+
+	if (inRange) {
+		return true;
+	}
+
+	// the new range needs new bounds, so the shape is built again once and stays private from now on
+	NewtonCollision* const shape = NewtonCreateHeightFieldCollision(m_myWorld->m_world, param.m_width, param.m_height, param.m_gridsDiagonals, format, rebuildSamples, param.m_atributes, param.m_verticalScale, param.m_horizonalScale_x, param.m_horizonalScale_z, 0);
+	dHeightFieldRange(rebuildSamples, param.m_width * param.m_height, format, m_minSample, m_maxSample);
+	delete[] (char*)rebuildSamples;
+	m_deformable = true;
+	ReplaceShape(shape);
+	return false;
+}
+
+void dNewtonCollisionHeightField::ReplaceShape(NewtonCollision* const shape)
+{
+	dMatrix matrix;
+	dFloat scaleX;
+	dFloat scaleY;
+	dFloat scaleZ;
+	NewtonCollisionGetMatrix(m_shape, &matrix[0][0]);
+	NewtonCollisionGetScale(m_shape, &scaleX, &scaleY, &scaleZ);
+	NewtonCollisionSetMatrix(shape, &matrix[0][0]);
+	NewtonCollisionSetScale(shape, scaleX, scaleY, scaleZ);
+
+	NewtonBody* const body = m_ownerBody;
+	DeleteShape();
+	if (body) {
+		// the body makes its own instance, the new shape only lives as long as that instance
+		NewtonBodySetCollision(body, shape);
+		m_myWorld->ReleaseShape(shape);
+		SetShape(NewtonBodyGetCollision(body));
+		m_ownerBody = body;
+	} else {
+		SetShape(shape);
+	}
 }
 
+void dNewtonCollisionHeightField::WakeBodies(NewtonBody* const body, const dMatrix& matrix, const dVector& p0, const dVector& p1)
+{
+	// bodies resting anywhere above or below the region may have lost their support
+	const dFloat verticalReach = 1.0e4f;
+	dVector minBox(dFloat(1.0e10f), dFloat(1.0e10f), dFloat(1.0e10f), 0.0f);
+	dVector maxBox(dFloat(-1.0e10f), dFloat(-1.0e10f), dFloat(-1.0e10f), 0.0f);
+	for (int i = 0; i < 8; i++) {
+		const dVector corner((i & 1) ? p1.m_x : p0.m_x, (i & 2) ? verticalReach : -verticalReach, (i & 4) ? p1.m_z : p0.m_z, 1.0f);
+		const dVector point(matrix.TransformVector(corner));
+		minBox = dVector(dMin(minBox.m_x, point.m_x), dMin(minBox.m_y, point.m_y), dMin(minBox.m_z, point.m_z), 0.0f);
+		maxBox = dVector(dMax(maxBox.m_x, point.m_x), dMax(maxBox.m_y, point.m_y), dMax(maxBox.m_z, point.m_z), 0.0f);
+	}
+	NewtonWorldForEachBodyInAABBDo(NewtonBodyGetWorld(body), &minBox.m_x, &maxBox.m_x, WakeBody, NULL);
+}
+
+int dNewtonCollisionHeightField::WakeBody(const NewtonBody* const body, void* const userData)
+{
+	NewtonBodySetSleepState(body, 0);
+	return 1;
+}
+
+
+dNewtonCollisionTiledHeightField::dNewtonCollisionTiledHeightField(dNewtonWorld* const world, const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, int tileSize, bool deformable)
+	:dNewtonCollision(world, 0)
+	,m_tiles()
+	,m_pendingRegions()
+	,m_cellSizeX(cellSizeX)
+	,m_cellSizeZ(cellSizeZ)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (!elevations || (width < 2) || (height < 2) || (tileSize < 1)) {
+		return;
+	}
+
+	const int sampleSize = (format == dNewtonCollisionHeightField::m_float32) ? int(sizeof(float)) : int(sizeof(unsigned short));
+	const int tileSamples = tileSize + 1;
+	char* const tileElevations = new char[tileSamples * tileSamples * sampleSize];
+	char* const tileAttributes = attributes ? new char[tileSamples * tileSamples] : NULL;
+
+	SetShape(NewtonCreateSceneCollision(m_myWorld->m_world, 0));
+	NewtonSceneCollisionBeginAddRemove(m_shape);
+	for (int z0 = 0; z0 < height - 1; z0 += tileSize) {
+		for (int x0 = 0; x0 < width - 1; x0 += tileSize) {
+			// the last row and column of a tile are the first of the next one
+			const int tileWidth = dMin(tileSamples, width - x0);
+			const int tileHeight = dMin(tileSamples, height - z0);
+			for (int z = 0; z < tileHeight; z++) {
+				const int src = (z0 + z) * width + x0;
+				memcpy(&tileElevations[z * tileWidth * sampleSize], (const char*)elevations + src * sampleSize, tileWidth * sampleSize);
+				if (tileAttributes) {
+					memcpy(&tileAttributes[z * tileWidth], (const char*)attributes + src, tileWidth);
+				}
+			}
+
+			dTile& tile = m_tiles.Append()->GetInfo();
+			tile.m_heightField = new dNewtonCollisionHeightField(m_myWorld, tileElevations, format, tileWidth, tileHeight, tileAttributes, verticalScale, cellSizeX, cellSizeZ, deformable);
+			tile.m_sceneNode = NULL;
+			tile.m_x0 = x0;
+			tile.m_z0 = z0;
+			tile.m_width = tileWidth;
+			tile.m_height = tileHeight;
+			if (tile.m_heightField->m_shape) {
+				dMatrix matrix(dGetIdentityMatrix());
+				matrix.m_posit = dVector(x0 * cellSizeX, 0.0f, z0 * cellSizeZ, 1.0f);
+				NewtonCollisionSetMatrix(tile.m_heightField->m_shape, &matrix[0][0]);
+				tile.m_sceneNode = NewtonSceneCollisionAddSubCollision(m_shape, tile.m_heightField->m_shape);
+			}
+		}
+	}
+	NewtonSceneCollisionEndAddRemove(m_shape);
+
+	delete[] tileAttributes;
+	delete[] tileElevations;
+}
+
+dNewtonCollisionTiledHeightField::~dNewtonCollisionTiledHeightField()
+{
+	// the scene goes first, its children point at the tile wrappers
+	DeleteShape();
+	for (dList<dTile>::dListNode* node = m_tiles.GetFirst(); node; node = node->GetNext()) {
+		delete node->GetInfo().m_heightField;
+	}
+	m_tiles.RemoveAll();
+	dClearRegionEdits(m_pendingRegions);
+}
+
+void dNewtonCollisionTiledHeightField::SetMaterialTable(const int* const materialIDs, int count)
+{
+	for (dList<dTile>::dListNode* node = m_tiles.GetFirst(); node; node = node->GetNext()) {
+		node->GetInfo().m_heightField->SetMaterialTable(materialIDs, count);
+	}
+}
+
+void dNewtonCollisionTiledHeightField::SetMaterialID(int materialId)
+{
+	dNewtonCollision::SetMaterialID(materialId);
+	for (dList<dTile>::dListNode* node = m_tiles.GetFirst(); node; node = node->GetNext()) {
+		node->GetInfo().m_heightField->SetMaterialID(materialId);
+	}
+}
+
+void dNewtonCollisionTiledHeightField::SetLayer(int layer)
+{
+	dNewtonCollision::SetLayer(layer);
+	for (dList<dTile>::dListNode* node = m_tiles.GetFirst(); node; node = node->GetNext()) {
+		node->GetInfo().m_heightField->SetLayer(layer);
+	}
+}
+
+bool dNewtonCollisionTiledHeightField::UpdateRegion(int x0, int z0, int width, int height, const dFloat* const elevations)
+{
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (!m_shape || !elevations || (width < 1) || (height < 1)) {
+		return true;
+	}
+
+	if (m_myWorld->m_updateInFlight) {
+		dQueueRegionEdit(m_pendingRegions, x0, z0, width, height, elevations);
+		QueuePendingShape();
+		return true;
+	}
+
+	bool inPlace = true;
+	int minX = x0 + width;
+	int minZ = z0 + height;
+	int maxX = x0;
+	int maxZ = z0;
+	for (dList<dTile>::dListNode* node = m_tiles.GetFirst(); node; node = node->GetNext()) {
+		dTile& tile = node->GetInfo();
+		const int tileX0 = dMax(x0, tile.m_x0);
+		const int tileZ0 = dMax(z0, tile.m_z0);
+		const int tileX1 = dMin(x0 + width, tile.m_x0 + tile.m_width);
+		const int tileZ1 = dMin(z0 + height, tile.m_z0 + tile.m_height);
+		if (!tile.m_sceneNode || (tileX0 >= tileX1) || (tileZ0 >= tileZ1)) {
+			continue;
+		}
+
+		// shared border samples are written to both tiles
+		const dFloat* const source = elevations + (tileZ0 - z0) * width + (tileX0 - x0);
+		if (!tile.m_heightField->PatchRegion(tileX0 - tile.m_x0, tileZ0 - tile.m_z0, tileX1 - tileX0, tileZ1 - tileZ0, source, width)) {
+			if (inPlace) {
+				NewtonSceneCollisionBeginAddRemove(m_shape);
+				inPlace = false;
+			}
+			NewtonSceneCollisionRemoveSubCollision(m_shape, tile.m_sceneNode);
+			tile.m_sceneNode = NewtonSceneCollisionAddSubCollision(m_shape, tile.m_heightField->m_shape);
+		}
+		minX = dMin(minX, tileX0);
+		minZ = dMin(minZ, tileZ0);
+		maxX = dMax(maxX, tileX1 - 1);
+		maxZ = dMax(maxZ, tileZ1 - 1);
+	}
+
+	if (!inPlace) {
+		NewtonSceneCollisionEndAddRemove(m_shape);
+	}
+
+	if (m_ownerBody && (minX <= maxX) && (minZ <= maxZ)) {
+		if (!inPlace) {
+			dNewtonBody::RefreshBroadphaseBounds(m_ownerBody);
+		}
+		dMatrix matrix;
+		NewtonBodyGetMatrix(m_ownerBody, &matrix[0][0]);
+		dMatrix offset;
+		NewtonCollisionGetMatrix(m_shape, &offset[0][0]);
+		dNewtonCollisionHeightField::WakeBodies(m_ownerBody, offset * matrix, dVector(minX * m_cellSizeX, 0.0f, minZ * m_cellSizeZ, 1.0f), dVector(maxX * m_cellSizeX, 0.0f, maxZ * m_cellSizeZ, 1.0f));
+	}
+	return inPlace;
+}
+
+void dNewtonCollisionTiledHeightField::CommitPendingShape()
+{
+	for (dList<dNewtonRegionEdit>::dListNode* node = m_pendingRegions.GetFirst(); node; node = node->GetNext()) {
+		const dNewtonRegionEdit& edit = node->GetInfo();
+		UpdateRegion(edit.m_x0, edit.m_z0, edit.m_width, edit.m_height, edit.m_elevations);
+	}
+	dClearRegionEdits(m_pendingRegions);
+}
+
+
 
 dNewtonCollisionScene::dNewtonCollisionScene(dNewtonWorld* const world)
 	:dNewtonCollision(world, 0)
 {
-	NewtonWaitForUpdateToFinish(m_myWorld->m_world);
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
 	SetShape(NewtonCreateSceneCollision(m_myWorld->m_world, 0));
 }
 
@@ -290,6 +1506,11 @@ void dNewtonCollisionScene::BeginAddRemoveCollision()
 
 void* dNewtonCollisionScene::AddCollision(const dNewtonCollision* const collision)
 {
+	const dAllocScope scope(m_myWorld->m_allocSlot, dAllocScope::m_shapes);
+	if (collision->m_pendingBuild) {
+		m_myWorld->AddPendingChild(m_shape, collision);
+		return NULL;
+	}
 	return NewtonSceneCollisionAddSubCollision(m_shape, collision->m_shape);
 }
 
@@ -302,3 +1523,43 @@ void dNewtonCollisionScene::EndAddRemoveCollision()
 {
 	NewtonSceneCollisionEndAddRemove(m_shape);
 }
+
+
+dNewtonCollisionSerialized::dNewtonCollisionSerialized(dNewtonWorld* const world, NewtonCollision* const shape, NewtonBody* const body, const dNewtonSerializedShape& data)
+	:dNewtonCollision(world, 0)
+	,m_subShapes()
+{
+	// the instance belongs to the body newton loaded, the wrapper never releases it
+	SetShape(shape);
+	m_ownerBody = body;
+	m_materialID = data.m_materialID;
+	m_layer = data.m_layer;
+}
+
+dNewtonCollisionSerialized::~dNewtonCollisionSerialized()
+{
+	for (dList<dNewtonCollisionSerialized*>::dListNode* node = m_subShapes.GetFirst(); node; node = node->GetNext()) {
+		delete node->GetInfo();
+	}
+	m_subShapes.RemoveAll();
+}
+
+void dNewtonCollisionSerialized::AddSubShape(NewtonCollision* const shape, const dNewtonSerializedShape& data)
+{
+	m_subShapes.Append(new dNewtonCollisionSerialized(m_myWorld, shape, m_ownerBody, data));
+}
+
+void dNewtonCollisionSerialized::CollectShapes(NewtonCollision* const shape, dList<NewtonCollision*>& shapes)
+{
+	shapes.Append(shape);
+	const int type = NewtonCollisionGetType(shape);
+	if (type == SERIALIZE_ID_COMPOUND) {
+		for (void* node = NewtonCompoundCollisionGetFirstNode(shape); node; node = NewtonCompoundCollisionGetNextNode(shape, node)) {
+			CollectShapes(NewtonCompoundCollisionGetCollisionFromNode(shape, node), shapes);
+		}
+	} else if (type == SERIALIZE_ID_SCENE) {
+		for (void* node = NewtonSceneCollisionGetFirstNode(shape); node; node = NewtonSceneCollisionGetNextNode(shape, node)) {
+			CollectShapes(NewtonSceneCollisionGetCollisionFromNode(shape, node), shapes);
+		}
+	}
+}
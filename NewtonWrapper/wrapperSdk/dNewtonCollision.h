@@ -26,12 +26,17 @@
 
 class dNewtonBody;
 class dNewtonWorld;
+class dNewtonShapeKey;
+class dNewtonShapeBuild;
 
 typedef void(*OnDrawFaceCallback)(const dFloat* const points, int vertexCount);
 
 class dNewtonCollision: public dAlloc
 {
 	public:
+	// shapes can be created while an async step is in flight, nothing waits for the step. a primitive or hull
+	// found in the shape cache is an instance right away, a miss is a null shape until the next safe point
+	// builds it, keeping the scale, offset and trigger mode set meanwhile. destruction never waits
 	dNewtonCollision (dNewtonWorld* const world, dLong collisionMask);
 	virtual ~dNewtonCollision();
 
@@ -43,16 +48,40 @@ class dNewtonCollision: public dAlloc
 	virtual void SetMaterialID(int materialId);
 	virtual void SetLayer(int layer);
 
+	// material of a contact, shapes with per face materials look up the face attribute
+	virtual int GetMaterialID(int faceAttribute) const;
+
+	// writes the shape in the cooked format dNewtonCollisionCooked loads, returns the bytes written.
+	// a NULL buffer returns the size, a buffer too small returns zero
+	int Cook(void* const buffer, int bufferSize) const;
+
 	protected:
 	virtual void SetShape(NewtonCollision* const shape);
 	virtual void DeleteShape();
 
+	// the body keeps its own copy of the shape, the wrapper switches to that copy without leaving the world list
+	void TransferShapeToBody(NewtonBody* const body);
+
+	// the body is going away, the wrapper keeps a copy of its instance so it stays usable
+	void TransferShapeFromBody();
+
+	// primitives and convex hulls with the same parameters share one prototype per world
+	void CreateCachedShape(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes);
+
+	// work left for the next safe point, a shape build here and region edits in the heightfields
+	virtual void CommitPendingShape();
+	void QueuePendingShape();
+	void FlushPendingShape();
+
 	static void DebugRenderCallback (void* userData, int vertexCount, const dFloat* faceVertec, int id);
 
 	static dMatrix m_primitiveAligment;
 	NewtonCollision* m_shape;
 	dNewtonWorld* m_myWorld;
 	dList<dNewtonCollision*>::dListNode* m_collisionCacheNode;
+	dList<dNewtonCollision*>::dListNode* m_commitNode;
+	dNewtonShapeBuild* m_pendingBuild;
+	NewtonBody* m_ownerBody;
 	int m_materialID;
 	int m_layer;
 	friend class dNewtonBody;
@@ -61,6 +90,10 @@ class dNewtonCollision: public dAlloc
 	friend class dNewtonKinematicBody;
 	friend class dNewtonCollisionScene;
 	friend class dNewtonCollisionCompound;
+	friend class dNewtonCollisionSerialized;
+	friend class dNewtonCollisionChunkedMesh;
+	friend class dNewtonWorldPartition;
+	friend class dNewtonCollisionTiledHeightField;
 };
 
 
@@ -68,6 +101,9 @@ class dNewtonCollisionNull: public dNewtonCollision
 {
 	public:
 	dNewtonCollisionNull(dNewtonWorld* const world);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 
@@ -75,12 +111,18 @@ class dNewtonCollisionSphere: public dNewtonCollision
 {
 	public:
 	dNewtonCollisionSphere(dNewtonWorld* const world, dFloat r);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 class dNewtonCollisionBox: public dNewtonCollision
 {
 	public:
 	dNewtonCollisionBox(dNewtonWorld* const world, dFloat x, dFloat y, dFloat z);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 
@@ -96,24 +138,36 @@ class dNewtonCollisionCapsule: public dNewtonAlignedShapes
 {
 	public:
 	dNewtonCollisionCapsule(dNewtonWorld* const world, dFloat radio0, dFloat radio1, dFloat height);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 class dNewtonCollisionCylinder: public dNewtonAlignedShapes
 {
 	public:
 	dNewtonCollisionCylinder(dNewtonWorld* const world, dFloat radio0, dFloat radio1, dFloat height);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 class dNewtonCollisionCone: public dNewtonAlignedShapes
 {
 	public:
 	dNewtonCollisionCone(dNewtonWorld* const world, dFloat radio, dFloat height);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 class dNewtonCollisionChamferedCylinder: public dNewtonAlignedShapes
 {
 	public:
 	dNewtonCollisionChamferedCylinder(dNewtonWorld* const world, dFloat radio, dFloat height);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 
@@ -121,6 +175,9 @@ class dNewtonCollisionConvexHull: public dNewtonCollision
 {
 	public:
 	dNewtonCollisionConvexHull(dNewtonWorld* const world, int vertexCount, const dFloat* const vertexCloud, dFloat tolerance);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
 };
 
 class dNewtonCollisionMesh: public dNewtonCollision
@@ -129,28 +186,182 @@ class dNewtonCollisionMesh: public dNewtonCollision
 	dNewtonCollisionMesh(dNewtonWorld* const world);
 	void BeginFace();
 	void AddFace(int vertexCount, const dFloat* const vertexPtr, int strideInBytes, int faceAttribute);
+
+	// adds an indexed triangle list in one call, between BeginFace and EndFace. vertices at the same
+	// position are welded first and the triangles they collapse are dropped. a NULL attribute array writes zeros
+	void AddMesh(const dFloat* const vertices, int vertexCount, const int* const indices, int indexCount, const int* const faceAttributes);
 	void EndFace(bool optmized);
 };
 
+// a large static mesh split into chunks of nearby triangles. the chunk trees are built at the same time
+// on the world threads and placed in a scene shape, so it can not be the child of another scene. while
+// a step is in flight the world threads are busy and the chunks are built on the calling thread.
+// vertices are welded like dNewtonCollisionMesh::AddMesh, a NULL attribute array writes zeros
+class dNewtonCollisionChunkedMesh: public dNewtonCollision
+{
+	public:
+	dNewtonCollisionChunkedMesh(dNewtonWorld* const world, const dFloat* const vertices, int vertexCount, const int* const indices, int indexCount, const int* const faceAttributes, int trianglesPerChunk, bool optimize);
+	virtual ~dNewtonCollisionChunkedMesh();
+
+	virtual void SetMaterialID(int materialId);
+	virtual void SetLayer(int layer);
+
+	private:
+	// contacts read the material of a scene child from its wrapper, so the chunks stay alive with the scene
+	dList<dNewtonCollisionMesh*> m_chunks;
+};
+
+// a heightfield edit made while a step is in flight, the solver reads the samples during the step
+// so they are copied and written at the next safe point
+class dNewtonRegionEdit
+{
+	public:
+	dFloat* m_elevations;
+	int m_x0;
+	int m_z0;
+	int m_width;
+	int m_height;
+};
+
+// elevations are width by height samples, row major along x. uint16 samples are multiplied by the vertical scale,
+// attributes are one byte per sample indexing the material table, NULL for none. newton keeps its own copy
+// of the samples, so the caller buffers can go right away. heightfields do not go through the shape cache,
+// every one owns its samples
 class dNewtonCollisionHeightField : public dNewtonCollision
 {
 	public:
+	enum dElevationFormat
+	{
+		m_float32,
+		m_unsigned16,
+	};
+
 	dNewtonCollisionHeightField(dNewtonWorld* const world, const dFloat* const elevations, int resolution, dVector scale);
+	// a deformable heightfield records its sample range, so UpdateRegion can write samples inside it right away
+	dNewtonCollisionHeightField(dNewtonWorld* const world, const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, bool deformable = false);
+	virtual ~dNewtonCollisionHeightField();
+
+	// contacts on a sample with attribute i use materialIDs[i], attributes past the table use the shape material
+	void SetMaterialTable(const int* const materialIDs, int count);
+	virtual int GetMaterialID(int faceAttribute) const;
+
+	// writes width by height heights in world units, row major along x, starting at sample x0 z0, and wakes the
+	// bodies over the region. on a deformable shape heights inside its vertical range are written in place, one
+	// outside it, or any height on a shape not built deformable, rebuilds the shape once. returns true when written in place.
+	// an edit made while a step is in flight is queued for the next safe point and returns true
+	bool UpdateRegion(int x0, int z0, int width, int height, const dFloat* const elevations);
+
+	protected:
+	virtual void CommitPendingShape();
+
+	private:
+	void CreateShape(const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, bool deformable);
+	bool PatchRegion(int x0, int z0, int width, int height, const dFloat* const elevations, int stride);
+	void ReplaceShape(NewtonCollision* const shape);
+	static void WakeBodies(NewtonBody* const body, const dMatrix& matrix, const dVector& p0, const dVector& p1);
+	static int WakeBody(const NewtonBody* const body, void* const userData);
+
+	int* m_materialTable;
+	int m_materialCount;
+	dList<dNewtonRegionEdit> m_pendingRegions;
+	dFloat m_minSample;
+	dFloat m_maxSample;
+	bool m_deformable;
+	friend class dNewtonCollisionTiledHeightField;
+};
+
+// a large terrain built as a scene of heightfield tiles of tileSize cells, neighbour tiles share their border
+// samples. every tile is its own heightfield shape. the scene can not be the child of another scene
+class dNewtonCollisionTiledHeightField: public dNewtonCollision
+{
+	public:
+	dNewtonCollisionTiledHeightField(dNewtonWorld* const world, const void* const elevations, int format, int width, int height, const void* const attributes, dFloat verticalScale, dFloat cellSizeX, dFloat cellSizeZ, int tileSize, bool deformable = false);
+	virtual ~dNewtonCollisionTiledHeightField();
+
+	void SetMaterialTable(const int* const materialIDs, int count);
+	virtual void SetMaterialID(int materialId);
+	virtual void SetLayer(int layer);
+
+	// same as dNewtonCollisionHeightField::UpdateRegion in samples of the whole terrain, only the tiles
+	// under the region are touched and a rebuilt tile replaces its old one in the scene
+	bool UpdateRegion(int x0, int z0, int width, int height, const dFloat* const elevations);
+
+	protected:
+	virtual void CommitPendingShape();
+
+	private:
+	class dTile
+	{
+		public:
+		dNewtonCollisionHeightField* m_heightField;
+		void* m_sceneNode;
+		int m_x0;
+		int m_z0;
+		int m_width;
+		int m_height;
+	};
+
+	dList<dTile> m_tiles;
+	dList<dNewtonRegionEdit> m_pendingRegions;
+	dFloat m_cellSizeX;
+	dFloat m_cellSizeZ;
+};
+
+// one child of a compound built or read back in a single call, managed code passes a flat array of them.
+// the matrix is row major like dMatrix and the params depend on the shape: sphere radius, box size,
+// capsule and cylinder radius0 radius1 height, cone and chamfered cylinder radius height, convex hull
+// first vertex, vertex count and tolerance into the point array given with the children. a zero scale is unscaled
+class dNewtonCompoundChild
+{
+	public:
+	dFloat m_matrix[16];
+	dFloat m_params[4];
+	dFloat m_scale[3];
+	int m_shapeType;
+	int m_materialID;
+	int m_layer;
 };
 
 class dNewtonCollisionCompound: public dNewtonCollision
 {
 	public:
+	enum dChildShape
+	{
+		m_null,
+		m_sphere,
+		m_box,
+		m_capsule,
+		m_cylinder,
+		m_cone,
+		m_chamferedCylinder,
+		m_convexHull,
+	};
+
 	dNewtonCollisionCompound(dNewtonWorld* const world);
+	virtual ~dNewtonCollisionCompound();
 
+	// a child still waiting for its shape is added at the next safe point, its handle is NULL
 	void BeginAddRemoveCollision();
 	void* AddCollision(dNewtonCollision* const collision);
 	void RemoveCollision(void* const handle);
 	void EndAddRemoveCollision();
 
-	//void* GetFirstNode() const;;
-	//void* GetNextNode(void* const collisionNode) const;
-	//dNewtonCollision* GetChildFromNode(void* const collisionNode) const;
+	// builds count dNewtonCompoundChild children in one add remove block, the compound owns them.
+	// returns how many were added, children with a bad type or params are skipped
+	int AddCollisions(const void* const children, int count, const dFloat* const points, int pointCount);
+
+	// writes up to maxCount children in node order and returns the child count, hulls only report their vertex count
+	int GetChildren(void* const children, int maxCount) const;
+	int GetChildCount() const;
+
+	void* GetFirstNode() const;
+	void* GetNextNode(void* const collisionNode) const;
+	dNewtonCollision* GetChildFromNode(void* const collisionNode) const;
+
+	private:
+	dNewtonCollision* CreateChild(const dNewtonCompoundChild& desc, const dFloat* const points, int pointCount);
+
+	dList<dNewtonCollision*> m_children;
 };
 
 class dNewtonCollisionScene: public dNewtonCollision
@@ -158,6 +369,7 @@ class dNewtonCollisionScene: public dNewtonCollision
 	public:
 	dNewtonCollisionScene(dNewtonWorld* const world);
 
+	// same as the compound, a child still waiting for its shape is added at the next safe point
 	void BeginAddRemoveCollision();
 	void* AddCollision(const dNewtonCollision* const collision);
 	void RemoveCollision(void* const handle);
@@ -168,6 +380,58 @@ class dNewtonCollisionScene: public dNewtonCollision
 //	dNewtonCollision* GetChildFromNode(void* const collisionNode) const;
 };
 
+// loads a shape cooked offline with dNewtonCollision::Cook, so tree meshes and convex hulls are not
+// built again at load time. blobs cooked by another newton version or float size are not valid,
+// the caller then builds the shape from its source data. identical blobs share one prototype
+class dNewtonCollisionCooked: public dNewtonCollision
+{
+	public:
+	dNewtonCollisionCooked(dNewtonWorld* const world, const void* const data, int sizeInBytes);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
+};
+
+// static triangle geometry loaded from a file cooked with CookMesh or CookHeightField. the file is mapped
+// once per process and every world that loads it shares the mapping, indices and attributes are int arrays.
+// the shape is a user mesh, scenes saved with it store no geometry and can not load it back
+class dNewtonCollisionSharedMesh: public dNewtonCollision
+{
+	public:
+	dNewtonCollisionSharedMesh(dNewtonWorld* const world, const char* const fileName);
+
+	static bool CookMesh(const char* const fileName, const dFloat* const vertices, int vertexCount, const int* const indices, const int* const attributes, int triangleCount);
+	static bool CookHeightField(const char* const fileName, const dFloat* const elevations, int width, int height, dFloat cellSizeX, dFloat cellSizeZ, const int* const attributes);
+
+	private:
+	static NewtonCollision* CreatePrototype(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
+};
+
+// wrapper data newton does not keep, saved with every shape of a serialized scene
+class dNewtonSerializedShape
+{
+	public:
+	int m_materialID;
+	int m_layer;
+};
+
+// wraps a shape that came out of a serialized scene. the children of compounds and scenes get
+// wrappers too, so contacts and ray casts find their material and layer. owned by the loaded body
+class dNewtonCollisionSerialized: public dNewtonCollision
+{
+	public:
+	virtual ~dNewtonCollisionSerialized();
+
+	// the shape followed by the sub shapes of compounds and scenes, saving and loading walk them in this order
+	static void CollectShapes(NewtonCollision* const shape, dList<NewtonCollision*>& shapes);
+
+	private:
+	dNewtonCollisionSerialized(dNewtonWorld* const world, NewtonCollision* const shape, NewtonBody* const body, const dNewtonSerializedShape& data);
+	void AddSubShape(NewtonCollision* const shape, const dNewtonSerializedShape& data);
+
+	dList<dNewtonCollisionSerialized*> m_subShapes;
+	friend class dNewtonWorld;
+};
 
 
 #endif
@@ -21,10 +21,12 @@
 
 #include "stdafx.h"
 #include "dNewtonJoint.h"
+#include "dNewtonWorld.h"
 
 dNewtonJoint::dNewtonJoint()
 	:dAlloc()
 	,m_joint(NULL)
+	,m_myWorld(NULL)
 {
 }
 
@@ -32,9 +34,17 @@ dNewtonJoint::~dNewtonJoint()
 {
 }
 
+int dNewtonJoint::GetAllocSlot(const NewtonBody* const body)
+{
+	dNewtonWorld* const world = (dNewtonWorld*)NewtonWorldGetUserData(NewtonBodyGetWorld(body));
+	return world->m_allocSlot;
+}
+
 void dNewtonJoint::SetJoint(dCustomJoint* const joint)
 {
 	m_joint = joint;
+	m_myWorld = (dNewtonWorld*)NewtonWorldGetUserData(NewtonBodyGetWorld(joint->GetBody0()));
+	m_myWorld->m_jointCount++;
 }
 
 void dNewtonJoint::Destroy()
@@ -42,6 +52,7 @@ void dNewtonJoint::Destroy()
 	if (m_joint) {
 		delete m_joint;
 		m_joint = NULL;
+		m_myWorld->m_jointCount--;
 	}
 }
 
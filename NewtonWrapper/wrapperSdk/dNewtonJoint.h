@@ -24,6 +24,8 @@
 #include "stdafx.h"
 #include "dAlloc.h"
 
+class dNewtonWorld;
+
 class dNewtonJoint: public dAlloc
 {
 	public:
@@ -35,7 +37,11 @@ class dNewtonJoint: public dAlloc
 
 	protected:
 	void SetJoint(dCustomJoint* const joint);
+
+	// joints are created before they know their world, the slot comes from the first body
+	static int GetAllocSlot(const NewtonBody* const body);
 	dCustomJoint* m_joint;
+	dNewtonWorld* m_myWorld;
 };
 
 #endif
@@ -31,6 +31,7 @@ dNewtonJointBallAndSocket::dNewtonJointBallAndSocket(const dMatrix pintAndPivotM
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomBallAndSocket* const joint = new dCustomBallAndSocket(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -32,6 +32,7 @@ dNewtonJointDoubleHinge::dNewtonJointDoubleHinge(const dMatrix pintAndPivotMatri
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomDoubleHinge* const joint = new dCustomDoubleHinge(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -64,6 +65,7 @@ dNewtonJointDoubleHingeActuator::dNewtonJointDoubleHingeActuator(const dMatrix p
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomDoubleHingeActuator* const joint = new dCustomDoubleHingeActuator(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 	//joint->SetEnableFlag0(true);
@@ -31,6 +31,7 @@ dNewtonJointHinge::dNewtonJointHinge(const dMatrix pintAndPivotMatrix, void* con
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomHinge* const joint = new dCustomHinge(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -61,6 +62,7 @@ dNewtonJointHingeActuator::dNewtonJointHingeActuator(const dMatrix pintAndPivotM
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomHingeActuator* const joint = new dCustomHingeActuator(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 	//joint->SetEnableFlag(true);
@@ -29,6 +29,7 @@ dNewtonJointPlane3DOF::dNewtonJointPlane3DOF(const dVector pivot, const dVector
 	NewtonBody* const netwonBody0 = (NewtonBody*)body0;
 	NewtonBody* const netwonBody1 = (NewtonBody*)body1;
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomPlane3DOF* const joint = new dCustomPlane3DOF(bodyMatrix.TransformVector(pivot), bodyMatrix.RotateVector(normal), netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -41,6 +42,7 @@ dNewtonJointPlane5DOF::dNewtonJointPlane5DOF(const dVector pivot, const dVector
 	NewtonBody* const netwonBody1 = (NewtonBody*)body1;
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomPlane5DOF* const joint = new dCustomPlane5DOF(bodyMatrix.TransformVector(pivot), bodyMatrix.RotateVector(normal), netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -32,6 +32,7 @@ dNewtonJointSlider::dNewtonJointSlider(const dMatrix pintAndPivotMatrix, void* c
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomSlider* const joint = new dCustomSlider(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -62,6 +63,7 @@ dNewtonJointSliderActuator::dNewtonJointSliderActuator(const dMatrix pintAndPivo
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomSliderActuator* const joint = new dCustomSliderActuator(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 	joint->SetEnableFlag(true);
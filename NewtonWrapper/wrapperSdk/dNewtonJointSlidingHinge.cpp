@@ -31,6 +31,7 @@ dNewtonJointSlidingHinge::dNewtonJointSlidingHinge(const dMatrix pintAndPivotMat
 	NewtonBodyGetMatrix(netwonBody0, &bodyMatrix[0][0]);
 
 	dMatrix matrix(pintAndPivotMatrix * bodyMatrix);
+	const dAllocScope scope(GetAllocSlot(netwonBody0), dAllocScope::m_joints);
 	dCustomSlidingContact* const joint = new dCustomSlidingContact(matrix, netwonBody0, netwonBody1);
 	SetJoint(joint);
 }
@@ -0,0 +1,90 @@
+/* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "stdafx.h"
+#include "dNewtonProfiler.h"
+#include <chrono>
+#include <stdio.h>
+
+dLong dNewtonGetTimeInMicroseconds()
+{
+	const std::chrono::steady_clock::duration time(std::chrono::steady_clock::now().time_since_epoch());
+	return dLong(std::chrono::duration_cast<std::chrono::microseconds>(time).count());
+}
+
+dNewtonTrace::dNewtonTrace(int eventCount)
+	:dAlloc()
+	,m_events(NULL)
+	,m_mask(0)
+	,m_count(0)
+{
+	// power of two capacity, so the running counter wraps into the ring with a mask
+	unsigned capacity = 1;
+	while (capacity < unsigned(eventCount)) {
+		capacity <<= 1;
+	}
+	m_mask = capacity - 1;
+	m_events = new dEvent[capacity];
+}
+
+dNewtonTrace::~dNewtonTrace()
+{
+	delete[] m_events;
+}
+
+void dNewtonTrace::AddEvent(const char* const name, dLong startTime, dLong duration, int threadIndex)
+{
+	dEvent& event = m_events[m_count.fetch_add(1) & m_mask];
+	event.m_name = name;
+	event.m_startTime = startTime;
+	event.m_duration = duration;
+	event.m_threadIndex = threadIndex;
+}
+
+bool dNewtonTrace::Save(const char* const fileName) const
+{
+	FILE* const file = fopen(fileName, "wb");
+	if (!file) {
+		return false;
+	}
+
+	const unsigned count = m_count;
+	const unsigned capacity = m_mask + 1;
+	const unsigned first = (count > capacity) ? count - capacity : 0;
+
+	// chrome trace thread ids must be positive, the main thread is 0 and newton thread n is n + 1
+	int maxThreadIndex = m_mainThread;
+	for (unsigned i = first; i < count; i++) {
+		maxThreadIndex = dMax(maxThreadIndex, m_events[i & m_mask].m_threadIndex);
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"main\"}}");
+	for (int i = 0; i <= maxThreadIndex; i++) {
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"newton thread %d\"}}", i + 1, i);
+	}
+	for (unsigned i = first; i < count; i++) {
+		const dEvent& event = m_events[i & m_mask];
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}", event.m_name, event.m_threadIndex + 1, (long long)event.m_startTime, (long long)event.m_duration);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,106 @@
+/* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _D_NEWTON_PROFILER_H_
+#define _D_NEWTON_PROFILER_H_
+
+#include "stdafx.h"
+#include "dAlloc.h"
+#include <atomic>
+
+// monotonic clock in microseconds, only differences are meaningful
+dLong dNewtonGetTimeInMicroseconds();
+
+// cost of the last simulation step, all times in milliseconds, mirrored on the managed side
+class dNewtonStepProfile
+{
+	public:
+	dFloat m_frameTime;
+	dFloat m_forceCallbackTime;
+	dFloat m_waitTime;
+	dFloat m_updateTime;
+	dFloat m_transformCallbackTime;
+	int m_stepCount;
+	int m_bodyCount;
+	int m_constraintCount;
+	int m_contactJointCount;
+	int m_islandCount;
+	int m_islandBodyCount;
+};
+
+// fixed size ring of timed events, written lock free from any thread and saved as chrome trace json.
+// once the ring is full the oldest events are overwritten
+class dNewtonTrace: public dAlloc
+{
+	public:
+	class dEvent
+	{
+		public:
+		const char* m_name;
+		dLong m_startTime;
+		dLong m_duration;
+		int m_threadIndex;
+	};
+
+	// events recorded on the thread driving the world, newton threads use their own index
+	enum
+	{
+		m_mainThread = -1,
+	};
+
+	dNewtonTrace(int eventCount);
+	~dNewtonTrace();
+
+	void AddEvent(const char* const name, dLong startTime, dLong duration, int threadIndex);
+	bool Save(const char* const fileName) const;
+
+	private:
+	dEvent* m_events;
+	unsigned m_mask;
+	std::atomic<unsigned> m_count;
+};
+
+// times the enclosing scope, does nothing when the trace is NULL
+class dNewtonTraceScope
+{
+	public:
+	dNewtonTraceScope(dNewtonTrace* const trace, const char* const name, int threadIndex)
+		:m_trace(trace)
+		,m_name(name)
+		,m_startTime(trace ? dNewtonGetTimeInMicroseconds() : 0)
+		,m_threadIndex(threadIndex)
+	{
+	}
+
+	~dNewtonTraceScope()
+	{
+		if (m_trace) {
+			m_trace->AddEvent(m_name, m_startTime, dNewtonGetTimeInMicroseconds() - m_startTime, m_threadIndex);
+		}
+	}
+
+	private:
+	dNewtonTrace* m_trace;
+	const char* m_name;
+	dLong m_startTime;
+	int m_threadIndex;
+};
+
+#endif
@@ -0,0 +1,407 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "stdafx.h"
+#include "dNewtonReplication.h"
+#include <math.h>
+
+#define D_REPLICATION_SNAPSHOT_MAGIC	0x4e575232
+#define D_REPLICATION_DELTA_MAGIC		0x4e574432
+
+// the three smallest quaternion components are within +-1/sqrt(2)
+#define D_REPLICATION_ROTATION_PRECISION	(1.0f / 32767.0f)
+
+// delta entry mask, one bit per field group
+enum dReplicationFields
+{
+	m_flagsChanged = 1 << 0,
+	m_positChanged = 1 << 1,
+	m_rotationChanged = 1 << 2,
+	m_velocChanged = 1 << 3,
+	m_omegaChanged = 1 << 4,
+	m_bodyRemoved = 1 << 7,
+};
+
+static int QuantizeValue(dFloat value, dFloat precision)
+{
+	const double scaled = floor(double(value) / double(precision) + 0.5);
+	return int(dClamp(scaled, -2147483647.0, 2147483647.0));
+}
+
+void dNewtonReplicatedBody::Quantize(int networkID, const dMatrix& matrix, const dVector& veloc, const dVector& omega, bool sleeping, dFloat positionPrecision, dFloat velocityPrecision)
+{
+	dQuaternion rotation(matrix);
+	const dFloat quat[4] = { rotation.m_q0, rotation.m_q1, rotation.m_q2, rotation.m_q3 };
+
+	// smallest three, the largest component is rebuilt from the unit length
+	int largest = 0;
+	for (int i = 1; i < 4; i++) {
+		if (dAbs(quat[i]) > dAbs(quat[largest])) {
+			largest = i;
+		}
+	}
+	const dFloat sign = (quat[largest] < 0.0f) ? -1.0f : 1.0f;
+	for (int i = 0, j = 0; i < 4; i++) {
+		if (i != largest) {
+			m_rotation[j] = QuantizeValue(quat[i] * sign, D_REPLICATION_ROTATION_PRECISION);
+			j++;
+		}
+	}
+
+	m_networkID = networkID;
+	m_flags = (sleeping ? m_sleeping : 0) | (largest << m_rotationIndexShift);
+	for (int i = 0; i < 3; i++) {
+		m_posit[i] = QuantizeValue(matrix.m_posit[i], positionPrecision);
+		m_veloc[i] = QuantizeValue(veloc[i], velocityPrecision);
+		m_omega[i] = QuantizeValue(omega[i], velocityPrecision);
+	}
+}
+
+void dNewtonReplicatedBody::Dequantize(dMatrix& matrix, dVector& veloc, dVector& omega, dFloat positionPrecision, dFloat velocityPrecision) const
+{
+	dFloat quat[4];
+	dFloat lengthSquared = 0.0f;
+	const int largest = (m_flags & m_rotationIndexMask) >> m_rotationIndexShift;
+	for (int i = 0, j = 0; i < 4; i++) {
+		if (i != largest) {
+			quat[i] = m_rotation[j] * D_REPLICATION_ROTATION_PRECISION;
+			lengthSquared += quat[i] * quat[i];
+			j++;
+		}
+	}
+	quat[largest] = dSqrt(dMax(1.0f - lengthSquared, 0.0f));
+
+	matrix = dMatrix(dQuaternion(quat[0], quat[1], quat[2], quat[3]), dVector(m_posit[0] * positionPrecision, m_posit[1] * positionPrecision, m_posit[2] * positionPrecision, 1.0f));
+	veloc = dVector(m_veloc[0] * velocityPrecision, m_veloc[1] * velocityPrecision, m_veloc[2] * velocityPrecision, 0.0f);
+	omega = dVector(m_omega[0] * velocityPrecision, m_omega[1] * velocityPrecision, m_omega[2] * velocityPrecision, 0.0f);
+}
+
+
+// bounds checked byte streams, integers go out as 7 bit varints with zigzag for signed values
+class dReplicationWriter
+{
+	public:
+	dReplicationWriter(void* const data, int capacity)
+		:m_data((unsigned char*)data)
+		,m_capacity(capacity)
+		,m_size(0)
+		,m_overflow(false)
+	{
+	}
+
+	void WriteBytes(const void* const data, int size)
+	{
+		if (m_overflow || (m_size + size > m_capacity)) {
+			m_overflow = true;
+			return;
+		}
+		memcpy(m_data + m_size, data, size);
+		m_size += size;
+	}
+
+	void WriteVarint(unsigned value)
+	{
+		while (value >= 0x80) {
+			unsigned char byte = (unsigned char)(value | 0x80);
+			WriteBytes(&byte, 1);
+			value >>= 7;
+		}
+		unsigned char byte = (unsigned char)value;
+		WriteBytes(&byte, 1);
+	}
+
+	// differences wrap around, the reader adds them back with the same wrap
+	void WriteDelta(const int* const value, const int* const reference, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			const unsigned diff = unsigned(value[i]) - unsigned(reference[i]);
+			WriteVarint((diff << 1) ^ (unsigned)(int(diff) >> 31));
+		}
+	}
+
+	unsigned char* m_data;
+	int m_capacity;
+	int m_size;
+	bool m_overflow;
+};
+
+class dReplicationReader
+{
+	public:
+	dReplicationReader(const void* const data, int size)
+		:m_data((const unsigned char*)data)
+		,m_size(size)
+		,m_position(0)
+		,m_error(false)
+	{
+	}
+
+	void ReadBytes(void* const data, int size)
+	{
+		if (m_error || (m_position + size > m_size)) {
+			m_error = true;
+			memset(data, 0, size);
+			return;
+		}
+		memcpy(data, m_data + m_position, size);
+		m_position += size;
+	}
+
+	unsigned ReadVarint()
+	{
+		unsigned value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			unsigned char byte;
+			ReadBytes(&byte, 1);
+			value |= unsigned(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		m_error = true;
+		return 0;
+	}
+
+	void ReadDelta(int* const value, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			const unsigned zigzag = ReadVarint();
+			const unsigned diff = (zigzag >> 1) ^ (0u - (zigzag & 1));
+			value[i] = int(unsigned(value[i]) + diff);
+		}
+	}
+
+	const unsigned char* m_data;
+	int m_size;
+	int m_position;
+	bool m_error;
+};
+
+
+int dNewtonReplication::GetSnapshotSize(int bodyCount)
+{
+	return int (sizeof(dNewtonReplicationHeader) + bodyCount * sizeof(dNewtonReplicatedBody));
+}
+
+// the bodies are already in place, returns the snapshot size
+int dNewtonReplication::WriteSnapshotHeader(void* const snapshot, const dNewtonReplicationHeader& header)
+{
+	dNewtonReplicationHeader copy(header);
+	copy.m_magic = D_REPLICATION_SNAPSHOT_MAGIC;
+	memcpy(snapshot, &copy, sizeof(copy));
+	return GetSnapshotSize(copy.m_bodyCount);
+}
+
+bool dNewtonReplication::ReadSnapshot(const void* const snapshot, int snapshotSize, dNewtonReplicationHeader& header, const dNewtonReplicatedBody** const bodies)
+{
+	if (!snapshot || (snapshotSize < int(sizeof(dNewtonReplicationHeader)))) {
+		return false;
+	}
+	memcpy(&header, snapshot, sizeof(header));
+	if ((header.m_magic != D_REPLICATION_SNAPSHOT_MAGIC) || (header.m_bodyCount < 0) || (snapshotSize < GetSnapshotSize(header.m_bodyCount))) {
+		return false;
+	}
+	*bodies = (const dNewtonReplicatedBody*)((const char*)snapshot + sizeof(dNewtonReplicationHeader));
+	return true;
+}
+
+int dNewtonReplication::EncodeDelta(const void* const baseline, int baselineSize, const void* const snapshot, int snapshotSize, void* const delta, int deltaSize)
+{
+	dNewtonReplicationHeader header;
+	const dNewtonReplicatedBody* bodies = NULL;
+	if (!ReadSnapshot(snapshot, snapshotSize, header, &bodies)) {
+		return 0;
+	}
+
+	dNewtonReplicationHeader baseHeader;
+	const dNewtonReplicatedBody* baseBodies = NULL;
+	baseHeader.m_bodyCount = 0;
+	if (baseline) {
+		// integers quantized with different precisions can not be compared
+		if (!ReadSnapshot(baseline, baselineSize, baseHeader, &baseBodies) ||
+			(baseHeader.m_positionPrecision != header.m_positionPrecision) || (baseHeader.m_velocityPrecision != header.m_velocityPrecision)) {
+			return 0;
+		}
+	}
+
+	dNewtonReplicatedBody empty;
+	memset(&empty, 0, sizeof(empty));
+
+	dReplicationWriter writer(delta, deltaSize);
+	dNewtonReplicationHeader deltaHeader(header);
+	deltaHeader.m_magic = D_REPLICATION_DELTA_MAGIC;
+	writer.WriteBytes(&deltaHeader, sizeof(deltaHeader));
+
+	// the entry count is patched once the bodies are walked
+	int entryCount = 0;
+	const int entryCountPosition = writer.m_size;
+	writer.WriteBytes(&entryCount, sizeof(entryCount));
+
+	// both lists are sorted by network id, ids are sent as the gap to the previous entry
+	int lastID = -1;
+	int i = 0;
+	int j = 0;
+	while ((i < baseHeader.m_bodyCount) || (j < header.m_bodyCount)) {
+		if ((j >= header.m_bodyCount) || ((i < baseHeader.m_bodyCount) && (baseBodies[i].m_networkID < bodies[j].m_networkID))) {
+			writer.WriteVarint(unsigned(baseBodies[i].m_networkID - lastID - 1));
+			writer.WriteVarint(m_bodyRemoved);
+			lastID = baseBodies[i].m_networkID;
+			entryCount++;
+			i++;
+		} else {
+			const dNewtonReplicatedBody& body = bodies[j];
+			const bool inBaseline = (i < baseHeader.m_bodyCount) && (baseBodies[i].m_networkID == body.m_networkID);
+			const dNewtonReplicatedBody& reference = inBaseline ? baseBodies[i] : empty;
+
+			// bodies new to the client are always sent, unchanged and sleeping ones are skipped
+			int mask = inBaseline ? 0 : m_flagsChanged;
+			mask |= (body.m_flags != reference.m_flags) ? m_flagsChanged : 0;
+			mask |= memcmp(body.m_posit, reference.m_posit, sizeof(body.m_posit)) ? m_positChanged : 0;
+			mask |= memcmp(body.m_rotation, reference.m_rotation, sizeof(body.m_rotation)) ? m_rotationChanged : 0;
+			mask |= memcmp(body.m_veloc, reference.m_veloc, sizeof(body.m_veloc)) ? m_velocChanged : 0;
+			mask |= memcmp(body.m_omega, reference.m_omega, sizeof(body.m_omega)) ? m_omegaChanged : 0;
+
+			if (mask) {
+				writer.WriteVarint(unsigned(body.m_networkID - lastID - 1));
+				writer.WriteVarint(unsigned(mask));
+				if (mask & m_flagsChanged) {
+					writer.WriteDelta(&body.m_flags, &reference.m_flags, 1);
+				}
+				if (mask & m_positChanged) {
+					writer.WriteDelta(body.m_posit, reference.m_posit, 3);
+				}
+				if (mask & m_rotationChanged) {
+					writer.WriteDelta(body.m_rotation, reference.m_rotation, 3);
+				}
+				if (mask & m_velocChanged) {
+					writer.WriteDelta(body.m_veloc, reference.m_veloc, 3);
+				}
+				if (mask & m_omegaChanged) {
+					writer.WriteDelta(body.m_omega, reference.m_omega, 3);
+				}
+				lastID = body.m_networkID;
+				entryCount++;
+			}
+			i += inBaseline ? 1 : 0;
+			j++;
+		}
+	}
+
+	if (writer.m_overflow) {
+		return 0;
+	}
+	memcpy((char*)delta + entryCountPosition, &entryCount, sizeof(entryCount));
+	return writer.m_size;
+}
+
+int dNewtonReplication::DecodeDelta(const void* const baseline, int baselineSize, const void* const delta, int deltaSize, void* const snapshot, int snapshotSize)
+{
+	dNewtonReplicationHeader header;
+	dReplicationReader reader(delta, deltaSize);
+	reader.ReadBytes(&header, sizeof(header));
+	if (reader.m_error || (header.m_magic != D_REPLICATION_DELTA_MAGIC) || (header.m_bodyCount < 0) || !snapshot || (snapshotSize < GetSnapshotSize(header.m_bodyCount))) {
+		return 0;
+	}
+
+	dNewtonReplicationHeader baseHeader;
+	const dNewtonReplicatedBody* baseBodies = NULL;
+	baseHeader.m_bodyCount = 0;
+	if (baseline) {
+		if (!ReadSnapshot(baseline, baselineSize, baseHeader, &baseBodies) ||
+			(baseHeader.m_positionPrecision != header.m_positionPrecision) || (baseHeader.m_velocityPrecision != header.m_velocityPrecision)) {
+			return 0;
+		}
+	}
+
+	int entryCount;
+	reader.ReadBytes(&entryCount, sizeof(entryCount));
+
+	dNewtonReplicatedBody empty;
+	memset(&empty, 0, sizeof(empty));
+	dNewtonReplicatedBody* const bodies = (dNewtonReplicatedBody*)((char*)snapshot + sizeof(dNewtonReplicationHeader));
+
+	int count = 0;
+	int entryID = -1;
+	int entryMask = 0;
+	bool hasEntry = false;
+	if (entryCount > 0) {
+		entryID = int(reader.ReadVarint()) + entryID + 1;
+		entryMask = int(reader.ReadVarint());
+		hasEntry = true;
+	}
+
+	int i = 0;
+	while (!reader.m_error && ((i < baseHeader.m_bodyCount) || hasEntry)) {
+		if (hasEntry && ((i >= baseHeader.m_bodyCount) || (entryID <= baseBodies[i].m_networkID))) {
+			const bool inBaseline = (i < baseHeader.m_bodyCount) && (baseBodies[i].m_networkID == entryID);
+			if (entryMask & m_bodyRemoved) {
+				if (!inBaseline) {
+					return 0;
+				}
+			} else {
+				if (count >= header.m_bodyCount) {
+					return 0;
+				}
+				dNewtonReplicatedBody& body = bodies[count];
+				body = inBaseline ? baseBodies[i] : empty;
+				body.m_networkID = entryID;
+				if (entryMask & m_flagsChanged) {
+					reader.ReadDelta(&body.m_flags, 1);
+				}
+				if (entryMask & m_positChanged) {
+					reader.ReadDelta(body.m_posit, 3);
+				}
+				if (entryMask & m_rotationChanged) {
+					reader.ReadDelta(body.m_rotation, 3);
+				}
+				if (entryMask & m_velocChanged) {
+					reader.ReadDelta(body.m_veloc, 3);
+				}
+				if (entryMask & m_omegaChanged) {
+					reader.ReadDelta(body.m_omega, 3);
+				}
+				count++;
+			}
+			i += inBaseline ? 1 : 0;
+
+			entryCount--;
+			hasEntry = entryCount > 0;
+			if (hasEntry) {
+				entryID = int(reader.ReadVarint()) + entryID + 1;
+				entryMask = int(reader.ReadVarint());
+			}
+		} else {
+			if (count >= header.m_bodyCount) {
+				return 0;
+			}
+			bodies[count] = baseBodies[i];
+			count++;
+			i++;
+		}
+	}
+
+	// trailing bytes mean the entry count and the entries disagree
+	if (reader.m_error || (reader.m_position != deltaSize) || (count != header.m_bodyCount)) {
+		return 0;
+	}
+	header.m_magic = D_REPLICATION_SNAPSHOT_MAGIC;
+	memcpy(snapshot, &header, sizeof(header));
+	return GetSnapshotSize(count);
+}
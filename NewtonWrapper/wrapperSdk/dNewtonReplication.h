@@ -0,0 +1,74 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _D_NEWTON_REPLICATION_H_
+#define _D_NEWTON_REPLICATION_H_
+
+#include "stdafx.h"
+
+// quantized state of one replicated body. the server and every client keep the exact same
+// bytes for an acknowledged snapshot, so deltas are taken between integers and never drift
+class dNewtonReplicatedBody
+{
+	public:
+	enum
+	{
+		m_sleeping = 1 << 0,
+		// index of the quaternion component left out by the smallest three encoding
+		m_rotationIndexShift = 1,
+		m_rotationIndexMask = 3 << m_rotationIndexShift,
+	};
+
+	void Quantize(int networkID, const dMatrix& matrix, const dVector& veloc, const dVector& omega, bool sleeping, dFloat positionPrecision, dFloat velocityPrecision);
+	void Dequantize(dMatrix& matrix, dVector& veloc, dVector& omega, dFloat positionPrecision, dFloat velocityPrecision) const;
+
+	int m_networkID;
+	int m_flags;
+	int m_posit[3];
+	int m_rotation[3];
+	int m_veloc[3];
+	int m_omega[3];
+};
+
+// a replication snapshot is this header followed by the bodies sorted by network id
+class dNewtonReplicationHeader
+{
+	public:
+	int m_magic;
+	int m_bodyCount;
+	long long m_stepIndex;
+	dFloat m_positionPrecision;
+	dFloat m_velocityPrecision;
+};
+
+class dNewtonReplication
+{
+	public:
+	static int GetSnapshotSize(int bodyCount);
+	static int WriteSnapshotHeader(void* const snapshot, const dNewtonReplicationHeader& header);
+	static bool ReadSnapshot(const void* const snapshot, int snapshotSize, dNewtonReplicationHeader& header, const dNewtonReplicatedBody** const bodies);
+
+	// the delta lists only the bodies that were added, removed or changed against the baseline,
+	// a NULL baseline sends everything. both return the bytes written, zero on a short buffer or bad input
+	static int EncodeDelta(const void* const baseline, int baselineSize, const void* const snapshot, int snapshotSize, void* const delta, int deltaSize);
+	static int DecodeDelta(const void* const baseline, int baselineSize, const void* const delta, int deltaSize, void* const snapshot, int snapshotSize);
+};
+
+#endif
@@ -0,0 +1,755 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "stdafx.h"
+#include "dNewtonBody.h"
+#include "dNewtonSharedGeometry.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define D_SHARED_GEOMETRY_MAGIC		0x4e574731
+#define D_SHARED_GEOMETRY_VERSION	1
+#define D_SHARED_GEOMETRY_LEAF_SIZE	4
+#define D_SHARED_GEOMETRY_STACK		64
+
+// file layout: header, vertices as float triplets, triangles, nodes. nodes are stored depth first,
+// an inner node has its left child right after it and the index of the right child in m_first
+class dNewtonSharedGeometryHeader
+{
+	public:
+	int m_magic;
+	int m_version;
+	int m_vertexCount;
+	int m_triangleCount;
+	int m_nodeCount;
+	float m_min[3];
+	float m_max[3];
+};
+
+class dNewtonSharedTriangle
+{
+	public:
+	int m_index[3];
+	int m_attribute;
+	float m_normal[3];
+	int m_faceSize;
+};
+
+class dNewtonSharedNode
+{
+	public:
+	float m_min[3];
+	float m_max[3];
+	int m_first;
+	int m_count;
+};
+
+// user data of the newton user mesh, one per world prototype
+class dSharedMeshInstance: public dAlloc
+{
+	public:
+	class dThreadBuffer
+	{
+		public:
+		dThreadBuffer()
+			:m_vertex(NULL)
+			,m_faceIndexCount(NULL)
+			,m_faceVertexIndex(NULL)
+			,m_triangles(NULL)
+			,m_capacity(0)
+		{
+		}
+
+		~dThreadBuffer()
+		{
+			Resize(0);
+		}
+
+		void Resize(int capacity)
+		{
+			delete[] m_vertex;
+			delete[] m_faceIndexCount;
+			delete[] m_faceVertexIndex;
+			delete[] m_triangles;
+			m_vertex = capacity ? new dFloat[capacity * 4 * 3] : NULL;
+			m_faceIndexCount = capacity ? new int[capacity] : NULL;
+			m_faceVertexIndex = capacity ? new int[capacity * 9] : NULL;
+			m_triangles = capacity ? new int[capacity] : NULL;
+			m_capacity = capacity;
+		}
+
+		dFloat* m_vertex;
+		int* m_faceIndexCount;
+		int* m_faceVertexIndex;
+		int* m_triangles;
+		int m_capacity;
+	};
+
+	dSharedMeshInstance(dNewtonSharedGeometry* const geometry, int threadCount)
+		:dAlloc()
+		,m_geometry(geometry)
+		,m_buffers(new dThreadBuffer[threadCount])
+		,m_threadCount(threadCount)
+	{
+	}
+
+	~dSharedMeshInstance()
+	{
+		delete[] m_buffers;
+		m_geometry->Release();
+	}
+
+	static void OnDestroy(void* const userData)
+	{
+		dSharedMeshInstance* const me = (dSharedMeshInstance*)userData;
+		delete me;
+	}
+
+	static void OnCollide(NewtonUserMeshCollisionCollideDesc* const desc, const void* const continueCollisionHandle)
+	{
+		dSharedMeshInstance* const me = (dSharedMeshInstance*)desc->m_userData;
+		const dNewtonSharedGeometry* const geometry = me->m_geometry;
+		dAssert(desc->m_threadNumber < me->m_threadCount);
+		dThreadBuffer& buffer = me->m_buffers[desc->m_threadNumber];
+
+		// the query box grows by the distance the other shape travels this step
+		dVector p0(desc->m_boxP0[0], desc->m_boxP0[1], desc->m_boxP0[2], 0.0f);
+		dVector p1(desc->m_boxP1[0], desc->m_boxP1[1], desc->m_boxP1[2], 0.0f);
+		for (int j = 0; j < 3; j++) {
+			p0[j] += dMin(desc->m_boxDistanceTravel[j], dFloat(0.0f));
+			p1[j] += dMax(desc->m_boxDistanceTravel[j], dFloat(0.0f));
+		}
+
+		int count = geometry->CollectTriangles(p0, p1, buffer.m_triangles, buffer.m_capacity);
+		if (count > buffer.m_capacity) {
+			buffer.Resize(count + count / 2);
+			count = geometry->CollectTriangles(p0, p1, buffer.m_triangles, buffer.m_capacity);
+		}
+
+		// every face brings its three corners and its normal, the edges share the face normal
+		for (int i = 0; i < count; i++) {
+			const dNewtonSharedTriangle& triangle = geometry->m_triangles[buffer.m_triangles[i]];
+			dFloat* const vertex = &buffer.m_vertex[i * 4 * 3];
+			for (int j = 0; j < 3; j++) {
+				const float* const src = &geometry->m_vertices[triangle.m_index[j] * 3];
+				vertex[j * 3 + 0] = src[0];
+				vertex[j * 3 + 1] = src[1];
+				vertex[j * 3 + 2] = src[2];
+			}
+			vertex[9] = triangle.m_normal[0];
+			vertex[10] = triangle.m_normal[1];
+			vertex[11] = triangle.m_normal[2];
+
+			const int base = i * 4;
+			int* const index = &buffer.m_faceVertexIndex[i * 9];
+			index[0] = base + 0;
+			index[1] = base + 1;
+			index[2] = base + 2;
+			index[3] = triangle.m_attribute;
+			index[4] = base + 3;
+			index[5] = base + 3;
+			index[6] = base + 3;
+			index[7] = base + 3;
+			index[8] = triangle.m_faceSize;
+			buffer.m_faceIndexCount[i] = 3;
+		}
+
+		desc->m_faceCount = count;
+		desc->m_vertexStrideInBytes = 3 * sizeof(dFloat);
+		desc->m_vertex = buffer.m_vertex;
+		desc->m_faceIndexCount = buffer.m_faceIndexCount;
+		desc->m_faceVertexIndex = buffer.m_faceVertexIndex;
+	}
+
+	static dFloat OnRayHit(NewtonUserMeshCollisionRayHitDesc* const desc)
+	{
+		dSharedMeshInstance* const me = (dSharedMeshInstance*)desc->m_userData;
+		const dVector p0(desc->m_p0[0], desc->m_p0[1], desc->m_p0[2], 0.0f);
+		const dVector p1(desc->m_p1[0], desc->m_p1[1], desc->m_p1[2], 0.0f);
+
+		dVector normal(0.0f);
+		int attribute = 0;
+		const dFloat param = me->m_geometry->RayCast(p0, p1, normal, attribute);
+		if (param <= 1.0f) {
+			desc->m_normalOut[0] = normal.m_x;
+			desc->m_normalOut[1] = normal.m_y;
+			desc->m_normalOut[2] = normal.m_z;
+			desc->m_normalOut[3] = 0.0f;
+			desc->m_userIdOut = attribute;
+		}
+		return param;
+	}
+
+	static void OnGetInfo(void* const userData, NewtonCollisionInfoRecord* const infoRecord)
+	{
+		// the shape has no parameters beyond what newton already reports for a user mesh
+	}
+
+	static int OnAABBTest(void* const userData, const dFloat* const boxP0, const dFloat* const boxP1)
+	{
+		const dSharedMeshInstance* const me = (dSharedMeshInstance*)userData;
+		const dNewtonSharedGeometryHeader* const header = me->m_geometry->m_header;
+		for (int i = 0; i < 3; i++) {
+			if ((boxP1[i] < header->m_min[i]) || (boxP0[i] > header->m_max[i])) {
+				return 0;
+			}
+		}
+		return 1;
+	}
+
+	dNewtonSharedGeometry* m_geometry;
+	dThreadBuffer* m_buffers;
+	int m_threadCount;
+};
+
+// triangle while the tree is built, sorted in place along the split axis
+class dCookTriangle
+{
+	public:
+	dNewtonSharedTriangle m_triangle;
+	float m_centroid[3];
+	float m_min[3];
+	float m_max[3];
+};
+
+template<int axis>
+static int CompareCentroids(const void* const elem0, const void* const elem1)
+{
+	const float c0 = ((const dCookTriangle*)elem0)->m_centroid[axis];
+	const float c1 = ((const dCookTriangle*)elem1)->m_centroid[axis];
+	return (c0 < c1) ? -1 : ((c0 > c1) ? 1 : 0);
+}
+
+// median splits along the longest centroid axis keep the tree balanced, so traversal stacks stay shallow
+static int BuildNodes(dCookTriangle* const triangles, int first, int count, dNewtonSharedNode* const nodes, int& nodeCount)
+{
+	const int index = nodeCount;
+	nodeCount++;
+
+	dNewtonSharedNode& node = nodes[index];
+	float centroidMin[3];
+	float centroidMax[3];
+	for (int j = 0; j < 3; j++) {
+		node.m_min[j] = triangles[first].m_min[j];
+		node.m_max[j] = triangles[first].m_max[j];
+		centroidMin[j] = triangles[first].m_centroid[j];
+		centroidMax[j] = triangles[first].m_centroid[j];
+	}
+	for (int i = first + 1; i < first + count; i++) {
+		for (int j = 0; j < 3; j++) {
+			node.m_min[j] = dMin(node.m_min[j], triangles[i].m_min[j]);
+			node.m_max[j] = dMax(node.m_max[j], triangles[i].m_max[j]);
+			centroidMin[j] = dMin(centroidMin[j], triangles[i].m_centroid[j]);
+			centroidMax[j] = dMax(centroidMax[j], triangles[i].m_centroid[j]);
+		}
+	}
+
+	if (count <= D_SHARED_GEOMETRY_LEAF_SIZE) {
+		node.m_first = first;
+		node.m_count = count;
+		return index;
+	}
+
+	int axis = 0;
+	for (int j = 1; j < 3; j++) {
+		if ((centroidMax[j] - centroidMin[j]) > (centroidMax[axis] - centroidMin[axis])) {
+			axis = j;
+		}
+	}
+	static int (* const compare[])(const void* const elem0, const void* const elem1) = {CompareCentroids<0>, CompareCentroids<1>, CompareCentroids<2>};
+	qsort(&triangles[first], count, sizeof(dCookTriangle), compare[axis]);
+
+	const int half = count / 2;
+	BuildNodes(triangles, first, half, nodes, nodeCount);
+	const int right = BuildNodes(triangles, first + half, count - half, nodes, nodeCount);
+	nodes[index].m_first = right;
+	nodes[index].m_count = 0;
+	return index;
+}
+
+
+dList<dNewtonSharedGeometry*> dNewtonSharedGeometry::m_registry;
+unsigned dNewtonSharedGeometry::m_registryLock = 0;
+
+dNewtonSharedGeometry::dNewtonSharedGeometry(const char* const fileName)
+	:dAlloc()
+	,m_header(NULL)
+	,m_vertices(NULL)
+	,m_triangles(NULL)
+	,m_nodes(NULL)
+	,m_fileName(new char[strlen(fileName) + 1])
+	,m_data(NULL)
+	,m_fileHandle(NULL)
+	,m_mappingHandle(NULL)
+	,m_size(0)
+	,m_refCount(1)
+	,m_registryNode(NULL)
+{
+	strcpy(m_fileName, fileName);
+}
+
+dNewtonSharedGeometry::~dNewtonSharedGeometry()
+{
+	Unmap();
+	delete[] m_fileName;
+}
+
+dNewtonSharedGeometry* dNewtonSharedGeometry::FindRegistered(const char* const fileName)
+{
+	for (dList<dNewtonSharedGeometry*>::dListNode* node = m_registry.GetFirst(); node; node = node->GetNext()) {
+		dNewtonSharedGeometry* const geometry = node->GetInfo();
+		if (!strcmp(geometry->m_fileName, fileName)) {
+			geometry->m_refCount++;
+			return geometry;
+		}
+	}
+	return NULL;
+}
+
+dNewtonSharedGeometry* dNewtonSharedGeometry::Acquire(const char* const fileName)
+{
+	{
+		dNewtonBody::ScopeLock lock(&m_registryLock);
+		dNewtonSharedGeometry* const geometry = FindRegistered(fileName);
+		if (geometry) {
+			return geometry;
+		}
+	}
+
+	// mapping and validating a large file takes a while, other threads keep using the registry meanwhile
+	dNewtonSharedGeometry* const geometry = new dNewtonSharedGeometry(fileName);
+	if (!geometry->Map()) {
+		dTrace(("shared geometry %s is missing or damaged\n", fileName));
+		delete geometry;
+		return NULL;
+	}
+
+	dNewtonBody::ScopeLock lock(&m_registryLock);
+	dNewtonSharedGeometry* const registered = FindRegistered(fileName);
+	if (registered) {
+		// another thread mapped the same file first
+		delete geometry;
+		return registered;
+	}
+	geometry->m_registryNode = m_registry.Append(geometry);
+	return geometry;
+}
+
+void dNewtonSharedGeometry::Release()
+{
+	dNewtonBody::ScopeLock lock(&m_registryLock);
+	m_refCount--;
+	if (!m_refCount) {
+		m_registry.Remove(m_registryNode);
+		delete this;
+	}
+}
+
+bool dNewtonSharedGeometry::Map()
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE mapping = size.QuadPart ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_size = size.QuadPart;
+	m_data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	const int file = open(m_fileName, O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (!fstat(file, &info) && (info.st_size > 0)) {
+		void* const data = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+		m_data = (data != MAP_FAILED) ? data : NULL;
+		m_size = m_data ? info.st_size : 0;
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(file);
+#endif
+
+	if (!m_data || (m_size < (long long)sizeof(dNewtonSharedGeometryHeader))) {
+		return false;
+	}
+
+	const char* const data = (const char*)m_data;
+	m_header = (const dNewtonSharedGeometryHeader*)data;
+	if ((m_header->m_magic != D_SHARED_GEOMETRY_MAGIC) || (m_header->m_version != D_SHARED_GEOMETRY_VERSION) ||
+		(m_header->m_vertexCount < 0) || (m_header->m_triangleCount <= 0) || (m_header->m_nodeCount <= 0)) {
+		return false;
+	}
+
+	const long long vertexBytes = (long long)m_header->m_vertexCount * 3 * sizeof(float);
+	const long long triangleBytes = (long long)m_header->m_triangleCount * sizeof(dNewtonSharedTriangle);
+	const long long nodeBytes = (long long)m_header->m_nodeCount * sizeof(dNewtonSharedNode);
+	if (m_size != (long long)sizeof(dNewtonSharedGeometryHeader) + vertexBytes + triangleBytes + nodeBytes) {
+		return false;
+	}
+
+	m_vertices = (const float*)(data + sizeof(dNewtonSharedGeometryHeader));
+	m_triangles = (const dNewtonSharedTriangle*)((const char*)m_vertices + vertexBytes);
+	m_nodes = (const dNewtonSharedNode*)((const char*)m_triangles + triangleBytes);
+	return Validate();
+}
+
+void dNewtonSharedGeometry::Unmap()
+{
+#ifdef _WIN32
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mappingHandle) {
+		CloseHandle((HANDLE)m_mappingHandle);
+	}
+	if (m_fileHandle) {
+		CloseHandle((HANDLE)m_fileHandle);
+	}
+#else
+	if (m_data) {
+		munmap(m_data, size_t(m_size));
+	}
+#endif
+	m_data = NULL;
+	m_fileHandle = NULL;
+	m_mappingHandle = NULL;
+	m_header = NULL;
+	m_vertices = NULL;
+	m_triangles = NULL;
+	m_nodes = NULL;
+}
+
+bool dNewtonSharedGeometry::Validate() const
+{
+	// one pass at load time, so a damaged file can not send a query out of the mapping
+	for (int i = 0; i < m_header->m_triangleCount; i++) {
+		for (int j = 0; j < 3; j++) {
+			if ((m_triangles[i].m_index[j] < 0) || (m_triangles[i].m_index[j] >= m_header->m_vertexCount)) {
+				return false;
+			}
+		}
+	}
+	for (int i = 0; i < m_header->m_nodeCount; i++) {
+		const dNewtonSharedNode& node = m_nodes[i];
+		if (node.m_count) {
+			// written as a difference so a huge m_first can not wrap the sum
+			if ((node.m_first < 0) || (node.m_count < 0) || (node.m_first > m_header->m_triangleCount) || (node.m_count > m_header->m_triangleCount - node.m_first)) {
+				return false;
+			}
+		} else if ((i + 1 >= m_header->m_nodeCount) || (node.m_first <= i + 1) || (node.m_first >= m_header->m_nodeCount)) {
+			return false;
+		}
+	}
+
+	// children always come after their parent, so this walks the whole tree once. a query pushes the
+	// same nodes in the same order whatever it culls, a tree that fits here fits every query stack
+	int stack[D_SHARED_GEOMETRY_STACK];
+	int stackDepth = 1;
+	stack[0] = 0;
+	while (stackDepth) {
+		stackDepth--;
+		const int nodeIndex = stack[stackDepth];
+		const dNewtonSharedNode& node = m_nodes[nodeIndex];
+		if (!node.m_count) {
+			if (stackDepth + 2 > D_SHARED_GEOMETRY_STACK) {
+				return false;
+			}
+			stack[stackDepth] = node.m_first;
+			stack[stackDepth + 1] = nodeIndex + 1;
+			stackDepth += 2;
+		}
+	}
+	return true;
+}
+
+NewtonCollision* dNewtonSharedGeometry::CreateShape(NewtonWorld* const world)
+{
+	{
+		dNewtonBody::ScopeLock lock(&m_registryLock);
+		m_refCount++;
+	}
+
+	const dFloat minBox[] = {m_header->m_min[0], m_header->m_min[1], m_header->m_min[2]};
+	const dFloat maxBox[] = {m_header->m_max[0], m_header->m_max[1], m_header->m_max[2]};
+	dSharedMeshInstance* const instance = new dSharedMeshInstance(this, NewtonGetMaxThreadsCount(world));
+	return NewtonCreateUserMeshCollision(world, minBox, maxBox, instance,
+		dSharedMeshInstance::OnCollide, dSharedMeshInstance::OnRayHit, dSharedMeshInstance::OnDestroy,
+		dSharedMeshInstance::OnGetInfo, dSharedMeshInstance::OnAABBTest, NULL, NULL, 0);
+}
+
+int dNewtonSharedGeometry::CollectTriangles(const dVector& p0, const dVector& p1, int* const triangles, int maxCount) const
+{
+	int count = 0;
+	int stack[D_SHARED_GEOMETRY_STACK];
+	int stackDepth = 1;
+	stack[0] = 0;
+	while (stackDepth) {
+		stackDepth--;
+		const int nodeIndex = stack[stackDepth];
+		const dNewtonSharedNode& node = m_nodes[nodeIndex];
+		if ((node.m_max[0] < p0.m_x) || (node.m_min[0] > p1.m_x) ||
+			(node.m_max[1] < p0.m_y) || (node.m_min[1] > p1.m_y) ||
+			(node.m_max[2] < p0.m_z) || (node.m_min[2] > p1.m_z)) {
+			continue;
+		}
+
+		if (node.m_count) {
+			for (int i = node.m_first; i < node.m_first + node.m_count; i++) {
+				const dNewtonSharedTriangle& triangle = m_triangles[i];
+				const float* const v0 = &m_vertices[triangle.m_index[0] * 3];
+				const float* const v1 = &m_vertices[triangle.m_index[1] * 3];
+				const float* const v2 = &m_vertices[triangle.m_index[2] * 3];
+				bool overlap = true;
+				for (int j = 0; overlap && (j < 3); j++) {
+					const dFloat minValue = dMin(v0[j], dMin(v1[j], v2[j]));
+					const dFloat maxValue = dMax(v0[j], dMax(v1[j], v2[j]));
+					overlap = (maxValue >= p0[j]) && (minValue <= p1[j]);
+				}
+				if (overlap) {
+					if (count < maxCount) {
+						triangles[count] = i;
+					}
+					count++;
+				}
+			}
+		} else if (stackDepth + 2 <= D_SHARED_GEOMETRY_STACK) {
+			stack[stackDepth] = node.m_first;
+			stack[stackDepth + 1] = nodeIndex + 1;
+			stackDepth += 2;
+		}
+	}
+	return count;
+}
+
+dFloat dNewtonSharedGeometry::RayCast(const dVector& p0, const dVector& p1, dVector& normal, int& attribute) const
+{
+	const dVector dir(p1 - p0);
+	dFloat bestParam = 1.2f;
+
+	int stack[D_SHARED_GEOMETRY_STACK];
+	int stackDepth = 1;
+	stack[0] = 0;
+	while (stackDepth) {
+		stackDepth--;
+		const int nodeIndex = stack[stackDepth];
+		const dNewtonSharedNode& node = m_nodes[nodeIndex];
+
+		// slab test against the part of the segment still closer than the best hit
+		dFloat tmin = 0.0f;
+		dFloat tmax = dMin(bestParam, dFloat(1.0f));
+		for (int j = 0; (j < 3) && (tmin <= tmax); j++) {
+			if (dAbs(dir[j]) < 1.0e-12f) {
+				if ((p0[j] < node.m_min[j]) || (p0[j] > node.m_max[j])) {
+					tmin = 1.0f;
+					tmax = 0.0f;
+				}
+			} else {
+				const dFloat invDir = 1.0f / dir[j];
+				const dFloat t0 = (node.m_min[j] - p0[j]) * invDir;
+				const dFloat t1 = (node.m_max[j] - p0[j]) * invDir;
+				tmin = dMax(tmin, dMin(t0, t1));
+				tmax = dMin(tmax, dMax(t0, t1));
+			}
+		}
+		if (tmin > tmax) {
+			continue;
+		}
+
+		if (node.m_count) {
+			for (int i = node.m_first; i < node.m_first + node.m_count; i++) {
+				const dNewtonSharedTriangle& triangle = m_triangles[i];
+				const dVector faceNormal(triangle.m_normal[0], triangle.m_normal[1], triangle.m_normal[2], 0.0f);
+				const dFloat den = faceNormal.DotProduct3(dir);
+				if (den >= 0.0f) {
+					continue;
+				}
+
+				const float* const v0 = &m_vertices[triangle.m_index[0] * 3];
+				const float* const v1 = &m_vertices[triangle.m_index[1] * 3];
+				const float* const v2 = &m_vertices[triangle.m_index[2] * 3];
+				const dVector q0(v0[0], v0[1], v0[2], 0.0f);
+				const dFloat param = faceNormal.DotProduct3(q0 - p0) / den;
+				if ((param < 0.0f) || (param >= bestParam) || (param > 1.0f)) {
+					continue;
+				}
+
+				// inside when the hit point is on the inner side of the three edges
+				const dVector point(p0 + dir.Scale(param));
+				const dVector q1(v1[0], v1[1], v1[2], 0.0f);
+				const dVector q2(v2[0], v2[1], v2[2], 0.0f);
+				if ((faceNormal.DotProduct3((q1 - q0).CrossProduct(point - q0)) >= 0.0f) &&
+					(faceNormal.DotProduct3((q2 - q1).CrossProduct(point - q1)) >= 0.0f) &&
+					(faceNormal.DotProduct3((q0 - q2).CrossProduct(point - q2)) >= 0.0f)) {
+					bestParam = param;
+					normal = faceNormal;
+					attribute = triangle.m_attribute;
+				}
+			}
+		} else if (stackDepth + 2 <= D_SHARED_GEOMETRY_STACK) {
+			stack[stackDepth] = node.m_first;
+			stack[stackDepth + 1] = nodeIndex + 1;
+			stackDepth += 2;
+		}
+	}
+	return bestParam;
+}
+
+bool dNewtonSharedGeometry::CookMesh(const char* const fileName, const dFloat* const vertices, int vertexCount, const int* const indices, const int* const attributes, int triangleCount)
+{
+	dCookTriangle* const triangles = new dCookTriangle[dMax(triangleCount, 1)];
+	int count = 0;
+	for (int i = 0; i < triangleCount; i++) {
+		const int i0 = indices[i * 3 + 0];
+		const int i1 = indices[i * 3 + 1];
+		const int i2 = indices[i * 3 + 2];
+		if ((i0 < 0) || (i1 < 0) || (i2 < 0) || (i0 >= vertexCount) || (i1 >= vertexCount) || (i2 >= vertexCount)) {
+			delete[] triangles;
+			return false;
+		}
+
+		const dVector q0(vertices[i0 * 3 + 0], vertices[i0 * 3 + 1], vertices[i0 * 3 + 2], 0.0f);
+		const dVector q1(vertices[i1 * 3 + 0], vertices[i1 * 3 + 1], vertices[i1 * 3 + 2], 0.0f);
+		const dVector q2(vertices[i2 * 3 + 0], vertices[i2 * 3 + 1], vertices[i2 * 3 + 2], 0.0f);
+		dVector normal((q1 - q0).CrossProduct(q2 - q0));
+		const dFloat area2 = normal.DotProduct3(normal);
+		if (area2 < 1.0e-12f) {
+			// degenerated faces never produce contacts
+			continue;
+		}
+		normal = normal.Scale(1.0f / dSqrt(area2));
+
+		dCookTriangle& triangle = triangles[count];
+		triangle.m_triangle.m_index[0] = i0;
+		triangle.m_triangle.m_index[1] = i1;
+		triangle.m_triangle.m_index[2] = i2;
+		triangle.m_triangle.m_attribute = attributes ? attributes[i] : 0;
+		triangle.m_triangle.m_normal[0] = float(normal.m_x);
+		triangle.m_triangle.m_normal[1] = float(normal.m_y);
+		triangle.m_triangle.m_normal[2] = float(normal.m_z);
+
+		const dFloat diagonal = dMax(dSqrt((q1 - q0).DotProduct3(q1 - q0)), dMax(dSqrt((q2 - q1).DotProduct3(q2 - q1)), dSqrt((q0 - q2).DotProduct3(q0 - q2))));
+		triangle.m_triangle.m_faceSize = int(ceil(diagonal)) + 1;
+		for (int j = 0; j < 3; j++) {
+			triangle.m_min[j] = float(dMin(q0[j], dMin(q1[j], q2[j])));
+			triangle.m_max[j] = float(dMax(q0[j], dMax(q1[j], q2[j])));
+			triangle.m_centroid[j] = float((q0[j] + q1[j] + q2[j]) * (1.0f / 3.0f));
+		}
+		count++;
+	}
+
+	if (!count) {
+		delete[] triangles;
+		return false;
+	}
+
+	dNewtonSharedNode* const nodes = new dNewtonSharedNode[2 * count];
+	int nodeCount = 0;
+	BuildNodes(triangles, 0, count, nodes, nodeCount);
+
+	dNewtonSharedGeometryHeader header;
+	header.m_magic = D_SHARED_GEOMETRY_MAGIC;
+	header.m_version = D_SHARED_GEOMETRY_VERSION;
+	header.m_vertexCount = vertexCount;
+	header.m_triangleCount = count;
+	header.m_nodeCount = nodeCount;
+	for (int j = 0; j < 3; j++) {
+		header.m_min[j] = nodes[0].m_min[j];
+		header.m_max[j] = nodes[0].m_max[j];
+	}
+
+	bool ok = false;
+	FILE* const file = fopen(fileName, "wb");
+	if (file) {
+		ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (int i = 0; ok && (i < vertexCount); i++) {
+			const float vertex[] = {float(vertices[i * 3 + 0]), float(vertices[i * 3 + 1]), float(vertices[i * 3 + 2])};
+			ok = fwrite(vertex, sizeof(vertex), 1, file) == 1;
+		}
+		for (int i = 0; ok && (i < count); i++) {
+			ok = fwrite(&triangles[i].m_triangle, sizeof(dNewtonSharedTriangle), 1, file) == 1;
+		}
+		ok = ok && (fwrite(nodes, sizeof(dNewtonSharedNode), nodeCount, file) == size_t(nodeCount));
+		ok = (fclose(file) == 0) && ok;
+	}
+
+	delete[] nodes;
+	delete[] triangles;
+	return ok;
+}
+
+bool dNewtonSharedGeometry::CookHeightField(const char* const fileName, const dFloat* const elevations, int width, int height, dFloat cellSizeX, dFloat cellSizeZ, const int* const attributes)
+{
+	if ((width < 2) || (height < 2)) {
+		return false;
+	}
+
+	dFloat* const vertices = new dFloat[width * height * 3];
+	for (int z = 0; z < height; z++) {
+		for (int x = 0; x < width; x++) {
+			dFloat* const vertex = &vertices[(z * width + x) * 3];
+			vertex[0] = x * cellSizeX;
+			vertex[1] = elevations[z * width + x];
+			vertex[2] = z * cellSizeZ;
+		}
+	}
+
+	// same winding and diagonal as the newton heightfield, so contacts match the built in shape
+	const int cellCount = (width - 1) * (height - 1);
+	int* const indices = new int[cellCount * 2 * 3];
+	int* const faceAttributes = new int[cellCount * 2];
+	int triangle = 0;
+	for (int z = 0; z < height - 1; z++) {
+		for (int x = 0; x < width - 1; x++) {
+			const int i0 = z * width + x;
+			const int i1 = i0 + 1;
+			const int i2 = i0 + width;
+			const int i3 = i2 + 1;
+			const int attribute = attributes ? attributes[i0] : 0;
+
+			indices[triangle * 3 + 0] = i0;
+			indices[triangle * 3 + 1] = i2;
+			indices[triangle * 3 + 2] = i1;
+			faceAttributes[triangle] = attribute;
+			triangle++;
+
+			indices[triangle * 3 + 0] = i1;
+			indices[triangle * 3 + 1] = i2;
+			indices[triangle * 3 + 2] = i3;
+			faceAttributes[triangle] = attribute;
+			triangle++;
+		}
+	}
+
+	const bool ok = CookMesh(fileName, vertices, width * height, indices, faceAttributes, triangle);
+	delete[] faceAttributes;
+	delete[] indices;
+	delete[] vertices;
+	return ok;
+}
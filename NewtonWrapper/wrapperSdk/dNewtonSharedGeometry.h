@@ -0,0 +1,81 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _D_NEWTON_SHARED_GEOMETRY_H_
+#define _D_NEWTON_SHARED_GEOMETRY_H_
+
+#include "stdafx.h"
+#include "dAlloc.h"
+
+class dNewtonSharedNode;
+class dNewtonSharedTriangle;
+class dNewtonSharedGeometryHeader;
+
+// static triangle geometry cooked to a file with a bounding volume tree and mapped read only.
+// every world of the process that loads the same file uses the same mapping, newton sees it
+// through a user mesh shape, so the only per world memory is a small face buffer per thread
+class dNewtonSharedGeometry: public dAlloc
+{
+	public:
+	// offline cooking, three indices and one attribute per triangle, a NULL attribute array writes zeros.
+	// heightfields become two triangles per cell, elevations and attributes are row major along x
+	static bool CookMesh(const char* const fileName, const dFloat* const vertices, int vertexCount, const int* const indices, const int* const attributes, int triangleCount);
+	static bool CookHeightField(const char* const fileName, const dFloat* const elevations, int width, int height, dFloat cellSizeX, dFloat cellSizeZ, const int* const attributes);
+
+	// maps the file on first use, every acquire needs a release. returns NULL for a missing file
+	// or one that fails validation, including trees too deep for the query stack
+	static dNewtonSharedGeometry* Acquire(const char* const fileName);
+	void Release();
+
+	// the shape keeps its own reference to the geometry
+	NewtonCollision* CreateShape(NewtonWorld* const world);
+
+	// fills triangles with the index of every triangle touching the box, returns the full count even past maxCount
+	int CollectTriangles(const dVector& p0, const dVector& p1, int* const triangles, int maxCount) const;
+
+	// front faces only, returns the hit parameter along p0 p1 or a value larger than one
+	dFloat RayCast(const dVector& p0, const dVector& p1, dVector& normal, int& attribute) const;
+
+	const dNewtonSharedGeometryHeader* m_header;
+	const float* m_vertices;
+	const dNewtonSharedTriangle* m_triangles;
+	const dNewtonSharedNode* m_nodes;
+
+	private:
+	dNewtonSharedGeometry(const char* const fileName);
+	~dNewtonSharedGeometry();
+	bool Map();
+	void Unmap();
+	bool Validate() const;
+	static dNewtonSharedGeometry* FindRegistered(const char* const fileName);
+
+	char* m_fileName;
+	void* m_data;
+	void* m_fileHandle;
+	void* m_mappingHandle;
+	long long m_size;
+	int m_refCount;
+	dList<dNewtonSharedGeometry*>::dListNode* m_registryNode;
+
+	static dList<dNewtonSharedGeometry*> m_registry;
+	static unsigned m_registryLock;
+};
+
+#endif
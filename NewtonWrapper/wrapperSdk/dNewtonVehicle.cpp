@@ -31,7 +31,7 @@ dNewtonVehicle::dNewtonVehicle(dNewtonWorld* const world, dNewtonCollision* cons
 	dNewtonVehicleManager* const vehicleManager = world->GetVehicleManager();
 
 	dMatrix vehicleFrame(dGetIdentityMatrix());
-	NewtonApplyForceAndTorque forceCallback = NewtonBodyGetForceAndTorqueCallback(m_body);
+	NewtonApplyForceAndTorque forceCallback = NewtonBodyGetForceAndTorqueCallback((NewtonBody*)GetBody());
 
 	dFloat gravidyMag = dSqrt(world->GetGravity().DotProduct3(world->GetGravity()));
 //	m_controller = vehicleManager->CreateVehicle(m_body, vehicleFrame, forceCallback, this, gravidyMag);
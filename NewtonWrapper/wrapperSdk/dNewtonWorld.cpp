@@ -23,6 +23,7 @@
 #include "dNewtonBody.h"
 #include "dNewtonWorld.h"
 #include "dNewtonCollision.h"
+#include "dNewtonReplication.h"
 #include "dNewtonVehicleManager.h"
 
 #define D_DEFAULT_FPS 120.0f
@@ -31,6 +32,36 @@ dNewtonWorld::dNewtonWorld()
 	:dAlloc()
 	,m_world (NewtonCreate())
 	,m_collisionCache()
+	,m_shapeCache()
+	,m_shapeReleaseQueue()
+	,m_shapeCommitQueue()
+	,m_pendingChildren()
+	,m_shapeStandIn(NULL)
+	,m_bodyAddQueue()
+	,m_bodyRemoveQueue()
+	,m_kinematicMovers()
+	,m_networkBodies()
+	,m_serializedBodies()
+	,m_legacyBodies()
+	,m_fracturedBodies()
+	,m_zeroAttributes(NULL)
+	,m_zeroAttributesCount(0)
+	,m_memoryStats()
+	,m_stepProfile()
+	,m_trace(NULL)
+	,m_allocSlot(dAllocScope::AcquireSlot())
+	,m_solverSavedTag(0)
+	,m_jointCount(0)
+	,m_contactJointCounter(0)
+	,m_islandCounter(0)
+	,m_islandBodyCounter(0)
+	,m_threadCount(1)
+	,m_replicationPositionPrecision(0.001f)
+	,m_replicationVelocityPrecision(0.01f)
+	,m_stepIndex(0)
+	,m_profiling(false)
+	,m_deterministic(false)
+	,m_stateHash(0)
 	,m_materialGraph()
 	,m_realTimeInMicroSeconds(0)
 	,m_timeStepInMicroSeconds (0)
@@ -38,6 +69,7 @@ dNewtonWorld::dNewtonWorld()
 	,m_interpotationParam(0.0f)
 	,m_gravity(0.0f, 0.0f, 0.0f, 0.0f)
 	,m_asyncUpdateMode(true)
+	,m_updateInFlight(false)
 	,m_onUpdateCallback(NULL)
 	,m_vehicleManager(NULL)
 {
@@ -47,6 +79,9 @@ dNewtonWorld::dNewtonWorld()
 	// set the simplified solver mode (faster but less accurate)
 	NewtonSetSolverModel (m_world, 1);
 
+	// shapes that miss the cache during a step are instances of this one until the next safe point
+	m_shapeStandIn = NewtonCreateNull(m_world);
+
 /*
 	// by default runs on four micro threads
 	NewtonSetThreadsCount(m_world, 4);
@@ -64,6 +99,11 @@ dNewtonWorld::dNewtonWorld()
 	NewtonMaterialSetCompoundCollisionCallback(m_world, defaultMaterial, defaultMaterial, OnSubShapeAABBOverlapTest);
 	NewtonMaterialSetCollisionCallback(m_world, defaultMaterial, defaultMaterial, OnBodiesAABBOverlap, OnContactCollision);
 
+	// the listener brackets the step on the thread that runs it, newton worker threads stay uncharged
+	void* const memoryListener = NewtonWorldAddListener(m_world, "dNewtonWorldMemory", this);
+	NewtonWorldListenerSetPreUpdateCallback(m_world, memoryListener, OnPreUpdate);
+	NewtonWorldListenerSetPostUpdateCallback(m_world, memoryListener, OnPostUpdate);
+
 	// set joint serialization call back
 	dCustomJoint::Initalize(m_world);
 	SetFrameRate(D_DEFAULT_FPS);
@@ -77,6 +117,11 @@ dNewtonWorld::dNewtonWorld()
 dNewtonWorld::~dNewtonWorld()
 {
 	NewtonWaitForUpdateToFinish (m_world);
+	m_updateInFlight = false;
+	ApplyPendingCommands();
+	ReleaseSerializedBodies();
+	ReleaseFracturedBodies();
+	delete[] m_zeroAttributes;
 
 	if (m_vehicleManager) {
 		while (m_vehicleManager->GetFirst()) {
@@ -91,11 +136,31 @@ dNewtonWorld::~dNewtonWorld()
 		next = node->GetNext();
 		node->GetInfo()->DeleteShape();
 	}
+	FlushShapeCache();
+	NewtonDestroyCollision(m_shapeStandIn);
 
 	if (m_world) {
 		NewtonDestroy(m_world);
 		m_world = NULL;
 	}
+
+	if (m_trace) {
+		delete m_trace;
+		m_trace = NULL;
+	}
+	dAllocScope::ReleaseSlot(m_allocSlot);
+}
+
+void dNewtonWorld::OnPreUpdate(const NewtonWorld* const world, void* const listenerUserData, dFloat timestep)
+{
+	dNewtonWorld* const me = (dNewtonWorld*)listenerUserData;
+	me->m_solverSavedTag = dAllocScope::SetThreadTag(me->m_allocSlot, dAllocScope::m_solver);
+}
+
+void dNewtonWorld::OnPostUpdate(const NewtonWorld* const world, void* const listenerUserData, dFloat timestep)
+{
+	dNewtonWorld* const me = (dNewtonWorld*)listenerUserData;
+	dAllocScope::RestoreThreadTag(me->m_solverSavedTag);
 }
 
 long long dNewtonWorld::GetMaterialKey(int materialID0, int materialID1) const
@@ -103,7 +168,412 @@ long long dNewtonWorld::GetMaterialKey(int materialID0, int materialID1) const
 	if (materialID0 > materialID1) {
 		dSwap(materialID0, materialID1);
 	}
-	return (long long (materialID1) << 32) + long long(materialID0);
+	return ((long long)materialID1 << 32) + (long long)materialID0;
+}
+
+dNewtonShapeKey::dNewtonShapeKey(int type)
+	:m_hash(HashBytes(14695981039346656037ULL, &type, sizeof(type)))
+	,m_digest(0)
+	,m_type(type)
+	,m_size(0)
+{
+	memset(m_params, 0, sizeof(m_params));
+}
+
+void dNewtonShapeKey::AddData(const void* const data, int sizeInBytes)
+{
+	const unsigned char* const bytes = (const unsigned char*)data;
+	const int stored = dMin(sizeInBytes, int(sizeof(m_params)) - dMin(m_size, int(sizeof(m_params))));
+	if (stored > 0) {
+		memcpy(&m_params[m_size], bytes, stored);
+	}
+
+	// the digest uses a different mix, two buffers must collide in both before they are taken as equal
+	for (int i = stored; i < sizeInBytes; i++) {
+		m_digest = (((m_digest << 5) | (m_digest >> 59)) ^ bytes[i]) * 0x9e3779b97f4a7c15ULL;
+	}
+	m_hash = HashBytes(m_hash, data, sizeInBytes);
+	m_size += sizeInBytes;
+}
+
+bool dNewtonShapeKey::IsEqual(const dNewtonShapeKey& key) const
+{
+	return (m_hash == key.m_hash) && (m_digest == key.m_digest) && (m_type == key.m_type) && (m_size == key.m_size) && !memcmp(m_params, key.m_params, sizeof(m_params));
+}
+
+unsigned long long dNewtonShapeKey::HashBytes(unsigned long long hash, const void* const data, int sizeInBytes)
+{
+	const unsigned char* const bytes = (const unsigned char*)data;
+	for (int i = 0; i < sizeInBytes; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+NewtonCollision* dNewtonWorld::FindCachedShape(const dNewtonShapeKey& key) const
+{
+	dTree<dCachedShape, unsigned long long>::dTreeNode* const node = m_shapeCache.Find(key.m_hash);
+	return (node && node->GetInfo().m_key.IsEqual(key)) ? node->GetInfo().m_shape : NULL;
+}
+
+dNewtonShapeBuild::dNewtonShapeBuild(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes)
+	:dAlloc()
+	,m_key(key)
+	,m_create(create)
+	,m_data(NULL)
+	,m_size(0)
+{
+	// the caller buffers go away with the call, the build keeps its own copy
+	if (data && (sizeInBytes > 0)) {
+		m_data = new char[sizeInBytes];
+		memcpy(m_data, data, sizeInBytes);
+		m_size = sizeInBytes;
+	}
+}
+
+dNewtonShapeBuild::~dNewtonShapeBuild()
+{
+	delete[] m_data;
+}
+
+bool dNewtonWorld::AddCachedShape(const dNewtonShapeKey& key, NewtonCollision* const shape)
+{
+	// the cache keeps one reference to the prototype, every wrapper gets its own instance of it.
+	// a different shape already under the same hash keeps its slot and the new one stays uncached
+	if (!shape || m_shapeCache.Find(key.m_hash)) {
+		return false;
+	}
+	dCachedShape entry;
+	entry.m_key = key;
+	entry.m_shape = shape;
+	m_shapeCache.Insert(entry, key.m_hash);
+	return true;
+}
+
+NewtonCollision* dNewtonWorld::CreateCachedShape(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes)
+{
+	NewtonCollision* const prototype = FindCachedShape(key);
+	if (prototype) {
+		return NewtonCollisionCreateInstance(prototype);
+	}
+
+	NewtonCollision* const shape = create(m_world, key, data, sizeInBytes);
+	return AddCachedShape(key, shape) ? NewtonCollisionCreateInstance(shape) : shape;
+}
+
+NewtonCollision* dNewtonWorld::CommitShapeBuild(const dNewtonShapeBuild& build, NewtonCollision* const standIn)
+{
+	dAssert(!m_updateInFlight);
+	const dAllocScope scope(m_allocSlot, dAllocScope::m_shapes);
+	NewtonCollision* const shape = CreateCachedShape(build.m_key, build.m_create, build.m_data, build.m_size);
+	if (!shape) {
+		// a shape newton refuses, as a flat hull, stays a null shape
+		return standIn;
+	}
+
+	dMatrix matrix;
+	dFloat scale[3];
+	NewtonCollisionGetMatrix(standIn, &matrix[0][0]);
+	NewtonCollisionGetScale(standIn, &scale[0], &scale[1], &scale[2]);
+	NewtonCollisionSetMatrix(shape, &matrix[0][0]);
+	NewtonCollisionSetScale(shape, scale[0], scale[1], scale[2]);
+	NewtonCollisionSetMode(shape, NewtonCollisionGetMode(standIn));
+	NewtonCollisionSetUserData(shape, NewtonCollisionGetUserData(standIn));
+	NewtonDestroyCollision(standIn);
+	return shape;
+}
+
+void dNewtonWorld::CommitPendingShapes()
+{
+	while (m_shapeCommitQueue.GetFirst()) {
+		m_shapeCommitQueue.GetFirst()->GetInfo()->FlushPendingShape();
+	}
+}
+
+void dNewtonWorld::AddPendingChild(NewtonCollision* const parent, const dNewtonCollision* const child)
+{
+	dPendingChild& entry = m_pendingChildren.Append()->GetInfo();
+	entry.m_parent = parent;
+	entry.m_child = child;
+}
+
+void dNewtonWorld::CommitPendingChildren()
+{
+	// one add remove block per compound or scene, the children keep the order they were added in
+	while (m_pendingChildren.GetFirst()) {
+		NewtonCollision* const parent = m_pendingChildren.GetFirst()->GetInfo().m_parent;
+		const bool compound = (NewtonCollisionGetType(parent) == SERIALIZE_ID_COMPOUND);
+		if (compound) {
+			NewtonCompoundCollisionBeginAddRemove(parent);
+		} else {
+			NewtonSceneCollisionBeginAddRemove(parent);
+		}
+
+		dList<dPendingChild>::dListNode* next;
+		for (dList<dPendingChild>::dListNode* node = m_pendingChildren.GetFirst(); node; node = next) {
+			next = node->GetNext();
+			const dPendingChild& entry = node->GetInfo();
+			if (entry.m_parent == parent) {
+				if (compound) {
+					NewtonCompoundCollisionAddSubCollision(parent, entry.m_child->m_shape);
+				} else {
+					NewtonSceneCollisionAddSubCollision(parent, entry.m_child->m_shape);
+				}
+				m_pendingChildren.Remove(node);
+			}
+		}
+
+		if (compound) {
+			NewtonCompoundCollisionEndAddRemove(parent);
+		} else {
+			NewtonSceneCollisionEndAddRemove(parent);
+		}
+	}
+}
+
+void dNewtonWorld::CancelPendingShape(dNewtonCollision* const collision)
+{
+	if (collision->m_commitNode) {
+		m_shapeCommitQueue.Remove(collision->m_commitNode);
+		collision->m_commitNode = NULL;
+	}
+	if (collision->m_pendingBuild) {
+		delete collision->m_pendingBuild;
+		collision->m_pendingBuild = NULL;
+	}
+
+	// a parent that went to a queued body with DetachPendingCollision keeps its children
+	dList<dPendingChild>::dListNode* next;
+	for (dList<dPendingChild>::dListNode* node = m_pendingChildren.GetFirst(); node; node = next) {
+		next = node->GetNext();
+		const dPendingChild& entry = node->GetInfo();
+		if ((entry.m_child == collision) || (collision->m_shape && (entry.m_parent == collision->m_shape))) {
+			m_pendingChildren.Remove(node);
+		}
+	}
+}
+
+void dNewtonWorld::FlushShapeCache()
+{
+	dTree<dCachedShape, unsigned long long>::Iterator iter(m_shapeCache);
+	for (iter.Begin(); iter; iter++) {
+		ReleaseShape(iter.GetNode()->GetInfo().m_shape);
+	}
+	m_shapeCache.RemoveAll();
+}
+
+// heightfields without an attribute map read this one, newton copies it so it only has to grow
+const char* dNewtonWorld::GetZeroAttributes(int count)
+{
+	if (m_zeroAttributesCount < count) {
+		delete[] m_zeroAttributes;
+		m_zeroAttributes = new char[count];
+		memset(m_zeroAttributes, 0, count);
+		m_zeroAttributesCount = count;
+	}
+	return m_zeroAttributes;
+}
+
+void dNewtonWorld::ReleaseShape(NewtonCollision* const shape)
+{
+	// shapes can not be destroyed while an asynchronous update is running,
+	// so they are queued and released at the next safe point instead of stalling the caller.
+	if (m_updateInFlight) {
+		m_shapeReleaseQueue.Append(shape);
+	} else {
+		NewtonDestroyCollision(shape);
+	}
+}
+
+void dNewtonWorld::DetachPendingCollision(dNewtonCollision* const collision)
+{
+	// a body waiting in the add queue takes over the shape of a wrapper destroyed before the safe point
+	for (dList<dNewtonBody*>::dListNode* node = m_bodyAddQueue.GetFirst(); node; node = node->GetNext()) {
+		dNewtonBody* const body = node->GetInfo();
+		if (body->m_pendingCollision == collision) {
+			body->m_pendingCollision = NULL;
+			body->m_pendingShape = collision->m_shape;
+			body->m_pendingBuild = collision->m_pendingBuild;
+			collision->m_pendingBuild = NULL;
+			NewtonCollisionSetUserData(collision->m_shape, NULL);
+			m_collisionCache.Remove(collision->m_collisionCacheNode);
+			collision->m_collisionCacheNode = NULL;
+			collision->m_shape = NULL;
+			break;
+		}
+	}
+}
+
+void dNewtonWorld::DestroyBody(dNewtonBody* const ownedBody)
+{
+	if (m_updateInFlight && ownedBody->m_body) {
+		// the caller no longer owns the user data, contacts reported before the safe point must not see it
+		ownedBody->m_userData = NULL;
+		if (!ownedBody->m_commandNode) {
+			ownedBody->m_commandNode = m_bodyRemoveQueue.Append(ownedBody);
+		}
+	} else {
+		delete ownedBody;
+	}
+}
+
+void dNewtonWorld::CreateBodies(const void* const descriptors, int count, void* const bodiesOut)
+{
+	const dNewtonBodyDesc* const descs = (const dNewtonBodyDesc*)descriptors;
+	dNewtonBody** const bodies = (dNewtonBody**)bodiesOut;
+
+	// all bodies go through the same path, so a batch issued during a step lands in the command queue as a whole
+	for (int i = 0; i < count; i++) {
+		const dNewtonBodyDesc& desc = descs[i];
+		const dMatrix matrix(desc.m_matrix);
+
+		dNewtonBody* body;
+		if (desc.m_kinematic) {
+			body = new dNewtonKinematicBody(this, desc.m_collision, matrix);
+		} else {
+			body = new dNewtonDynamicBody(this, desc.m_collision, matrix, desc.m_mass);
+		}
+		body->SetVelocity(desc.m_velocity[0], desc.m_velocity[1], desc.m_velocity[2]);
+		body->SetOmega(desc.m_omega[0], desc.m_omega[1], desc.m_omega[2]);
+		bodies[i] = body;
+	}
+}
+
+void* dNewtonWorld::GetMemoryStats()
+{
+	// every counter here can be read while a step is running
+	dAllocStats allocStats;
+	dAlloc::GetStats(allocStats);
+	m_memoryStats.m_currentBytes = allocStats.m_currentBytes;
+	m_memoryStats.m_peakBytes = allocStats.m_peakBytes;
+	m_memoryStats.m_reservedBytes = allocStats.m_reservedBytes;
+	m_memoryStats.m_liveAllocations = allocStats.m_liveAllocations;
+	m_memoryStats.m_totalAllocations = allocStats.m_totalAllocations;
+	m_memoryStats.m_bodyBytes = dAllocScope::GetBytes(m_allocSlot, dAllocScope::m_bodies);
+	m_memoryStats.m_shapeBytes = dAllocScope::GetBytes(m_allocSlot, dAllocScope::m_shapes);
+	m_memoryStats.m_jointBytes = dAllocScope::GetBytes(m_allocSlot, dAllocScope::m_joints);
+	m_memoryStats.m_solverBytes = dAllocScope::GetBytes(m_allocSlot, dAllocScope::m_solver);
+
+	m_memoryStats.m_bodyCount = NewtonWorldGetBodyCount(m_world);
+	m_memoryStats.m_shapeCount = m_collisionCache.GetCount() + m_shapeCache.GetCount();
+	m_memoryStats.m_jointCount = m_jointCount;
+	m_memoryStats.m_constraintCount = NewtonWorldGetConstraintCount(m_world);
+
+	// contact joints can only be walked while the world is idle, during a step the last count stays
+	if (!m_updateInFlight) {
+		int contactCount = 0;
+		for (NewtonBody* body = NewtonWorldGetFirstBody(m_world); body; body = NewtonWorldGetNextBody(m_world, body)) {
+			for (NewtonJoint* joint = NewtonBodyGetFirstContactJoint(body); joint; joint = NewtonBodyGetNextContactJoint(body, joint)) {
+				// every contact joint is seen from both bodies
+				if (NewtonJointGetBody0(joint) == body) {
+					contactCount += NewtonContactJointGetContactCount(joint);
+				}
+			}
+		}
+		m_memoryStats.m_contactCount = contactCount;
+	}
+	return &m_memoryStats;
+}
+
+void dNewtonWorld::SetProfiling(bool mode)
+{
+	WaitForUpdateToFinish();
+	m_profiling = mode;
+	m_contactJointCounter = 0;
+	m_islandCounter = 0;
+	m_islandBodyCounter = 0;
+	memset(&m_stepProfile, 0, sizeof(m_stepProfile));
+	NewtonSetIslandUpdateEvent(m_world, mode ? OnIslandUpdate : NULL);
+}
+
+void* dNewtonWorld::GetStepProfile()
+{
+	return &m_stepProfile;
+}
+
+void dNewtonWorld::SetTracing(int eventCount)
+{
+	WaitForUpdateToFinish();
+	if (m_trace) {
+		delete m_trace;
+		m_trace = NULL;
+	}
+	if (eventCount > 0) {
+		m_trace = new dNewtonTrace(eventCount);
+	}
+}
+
+bool dNewtonWorld::SaveTrace(const char* const fileName)
+{
+	// newton threads may still be writing events while a step is running
+	WaitForUpdateToFinish();
+	return m_trace ? m_trace->Save(fileName) : false;
+}
+
+int dNewtonWorld::OnIslandUpdate(const NewtonWorld* const newtonWorld, const void* islandHandle, int bodyCount)
+{
+	dNewtonWorld* const world = (dNewtonWorld*)NewtonWorldGetUserData(newtonWorld);
+	NewtonAtomicAdd(&world->m_islandCounter, 1);
+	NewtonAtomicAdd(&world->m_islandBodyCounter, bodyCount);
+	return 1;
+}
+
+// called once the step is known to be finished, the counters were filled by the worker threads
+void dNewtonWorld::CollectStepProfile()
+{
+	if (m_profiling) {
+		m_stepProfile.m_updateTime = NewtonGetLastUpdateTime(m_world) * 1000.0f;
+		m_stepProfile.m_bodyCount = NewtonWorldGetBodyCount(m_world);
+		m_stepProfile.m_constraintCount = NewtonWorldGetConstraintCount(m_world);
+		m_stepProfile.m_contactJointCount = m_contactJointCounter;
+		m_stepProfile.m_islandCount = m_islandCounter;
+		m_stepProfile.m_islandBodyCount = m_islandBodyCounter;
+		m_contactJointCounter = 0;
+		m_islandCounter = 0;
+		m_islandBodyCounter = 0;
+	}
+}
+
+void dNewtonWorld::WaitForUpdateToFinish()
+{
+	if (m_updateInFlight) {
+		dNewtonTraceScope scope(m_trace, "WaitForUpdateToFinish", dNewtonTrace::m_mainThread);
+		NewtonWaitForUpdateToFinish(m_world);
+		m_updateInFlight = false;
+		CollectStepProfile();
+		ApplyPendingCommands();
+	}
+}
+
+void dNewtonWorld::ApplyPendingCommands()
+{
+	dAssert(!m_updateInFlight);
+
+	// removes go first, a body destroyed in the same frame it was queued never reaches newton
+	while (m_bodyRemoveQueue.GetFirst()) {
+		dList<dNewtonBody*>::dListNode* const node = m_bodyRemoveQueue.GetFirst();
+		dNewtonBody* const body = node->GetInfo();
+		m_bodyRemoveQueue.Remove(node);
+		body->m_commandNode = NULL;
+		delete body;
+	}
+
+	// shapes go before the bodies that use them, a compound has its late children before a body copies it
+	CommitPendingShapes();
+	CommitPendingChildren();
+
+	while (m_bodyAddQueue.GetFirst()) {
+		dList<dNewtonBody*>::dListNode* const node = m_bodyAddQueue.GetFirst();
+		dNewtonBody* const body = node->GetInfo();
+		m_bodyAddQueue.Remove(node);
+		body->m_commandNode = NULL;
+		body->CommitPendingBody();
+	}
+
+	for (dList<NewtonCollision*>::dListNode* node = m_shapeReleaseQueue.GetFirst(); node; node = node->GetNext()) {
+		NewtonDestroyCollision(node->GetInfo());
+	}
+	m_shapeReleaseQueue.RemoveAll();
 }
 
 void dNewtonWorld::SetCallbacks(OnWorldUpdateCallback forceCallback, OnWorldBodyTransfromUpdateCallback tranformCallback)
@@ -184,8 +654,9 @@ unsigned dNewtonWorld::rayPreFilterCallback(const NewtonBody* const body, const
 
 	if (collision)
 	{
+		// a shape whose wrapper is gone is on layer zero
 		dNewtonCollision* dCol = static_cast<dNewtonCollision*>(NewtonCollisionGetUserData(collision));
-		int layer = dCol->m_layer;
+		int layer = dCol ? dCol->m_layer : 0;
 		
 		if (layer & hitInfo->layermask) {
 			return 0;
@@ -230,7 +701,82 @@ void dNewtonWorld::SetSolverMode(int mode)
 
 void dNewtonWorld::SetThreadsCount(int threads)
 {
-	NewtonSetThreadsCount(m_world, dClamp (threads, 0, 8));
+	m_threadCount = dClamp (threads, 0, 8);
+	if (!m_deterministic) {
+		NewtonSetThreadsCount(m_world, m_threadCount);
+	}
+}
+
+void dNewtonWorld::SetDeterministic(bool mode)
+{
+	WaitForUpdateToFinish();
+	m_deterministic = mode;
+
+	// with a single thread the island and contact order only depends on the scene,
+	// the cached contacts and broadphase pairs are dropped so both peers start from the same state
+	NewtonSetThreadsCount(m_world, mode ? 1 : m_threadCount);
+	if (mode) {
+		NewtonInvalidateCache(m_world);
+	}
+}
+
+bool dNewtonWorld::GetDeterministic() const
+{
+	return m_deterministic;
+}
+
+long long dNewtonWorld::GetStepIndex() const
+{
+	return m_stepIndex;
+}
+
+long long dNewtonWorld::GetStateHash()
+{
+	// the bodies are being integrated, the last complete hash is the only consistent answer
+	if (m_updateInFlight) {
+		return m_stateHash;
+	}
+
+	// the body hashes are mixed and summed, so the body list order does not matter
+	unsigned long long stateHash = 0;
+	for (NewtonBody* body = NewtonWorldGetFirstBody(m_world); body; body = NewtonWorldGetNextBody(m_world, body)) {
+		dMatrix matrix;
+		dFloat veloc[3];
+		dFloat omega[3];
+		NewtonBodyGetMatrix(body, &matrix[0][0]);
+		NewtonBodyGetVelocity(body, veloc);
+		NewtonBodyGetOmega(body, omega);
+		const int sleeping = NewtonBodyGetSleepState(body);
+
+		// the body identity goes in first, so two bodies swapping states still change the hash.
+		// network id, then scene id, then newton's creation order id, tagged so they can not collide
+		const dNewtonBody* const wrapper = (dNewtonBody*)NewtonBodyGetUserData(body);
+		int identity[2];
+		if (wrapper && (wrapper->m_networkID >= 0)) {
+			identity[0] = 0;
+			identity[1] = wrapper->m_networkID;
+		} else if (wrapper && (wrapper->m_sceneID >= 0)) {
+			identity[0] = 1;
+			identity[1] = wrapper->m_sceneID;
+		} else {
+			identity[0] = 2;
+			identity[1] = NewtonBodyGetID(body);
+		}
+
+		unsigned long long hash = 14695981039346656037ULL;
+		hash = dNewtonShapeKey::HashBytes(hash, identity, sizeof(identity));
+		hash = dNewtonShapeKey::HashBytes(hash, &matrix[0][0], sizeof(dMatrix));
+		hash = dNewtonShapeKey::HashBytes(hash, veloc, sizeof(veloc));
+		hash = dNewtonShapeKey::HashBytes(hash, omega, sizeof(omega));
+		hash = dNewtonShapeKey::HashBytes(hash, &sleeping, sizeof(sleeping));
+
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		stateHash += hash;
+	}
+	m_stateHash = (long long)stateHash;
+	return m_stateHash;
 }
 
 void dNewtonWorld::SetBroadPhase(int broadphase)
@@ -327,7 +873,7 @@ void* dNewtonWorld::GetBody0UserData(void* const contact) const
 	NewtonJoint* const contactJoint = (NewtonJoint*)contact;
 	NewtonBody* const body = NewtonJointGetBody0(contactJoint);
 	dNewtonBody* const dBody = (dNewtonBody*)NewtonBodyGetUserData(body);
-	return dBody->GetUserData();
+	return dBody ? dBody->GetUserData() : NULL;
 }
 
 void* dNewtonWorld::GetBody1UserData(void* const contact) const
@@ -335,7 +881,7 @@ void* dNewtonWorld::GetBody1UserData(void* const contact) const
 	NewtonJoint* const contactJoint = (NewtonJoint*)contact;
 	NewtonBody* const body = NewtonJointGetBody1(contactJoint);
 	dNewtonBody* const dBody = (dNewtonBody*)NewtonBodyGetUserData(body);
-	return dBody->GetUserData();
+	return dBody ? dBody->GetUserData() : NULL;
 }
 
 int dNewtonWorld::OnSubShapeAABBOverlapTest(const NewtonMaterial* const material, const NewtonBody* const body0, const void* const collisionNode0, const NewtonBody* const body1, const void* const collisionNode1, int threadIndex)
@@ -346,14 +892,29 @@ int dNewtonWorld::OnSubShapeAABBOverlapTest(const NewtonMaterial* const material
 int dNewtonWorld::OnBodiesAABBOverlap(const NewtonMaterial* const material, const NewtonBody* const bodyPtr0, const NewtonBody* const bodyPtr1, int threadIndex)
 {
 	dNewtonWorld* const world = (dNewtonWorld*)NewtonMaterialGetMaterialPairUserData(material);
+	dNewtonTraceScope scope(world->m_trace, "OnBodiesAABBOverlap", threadIndex);
 	NewtonCollision* const newtonCollision0 = (NewtonCollision*)NewtonBodyGetCollision(bodyPtr0);
 	NewtonCollision* const newtonCollision1 = (NewtonCollision*)NewtonBodyGetCollision(bodyPtr1);
 	dNewtonCollision* const collision0 = (dNewtonCollision*)NewtonCollisionGetUserData(newtonCollision0);
 	dNewtonCollision* const collision1 = (dNewtonCollision*)NewtonCollisionGetUserData(newtonCollision1);
-	const dMaterialProperties materialProp = world->FindMaterial(collision0->m_materialID, collision1->m_materialID);
+	// a body can outlive the wrapper of its shape, that shape uses material zero
+	const int materialID0 = collision0 ? collision0->m_materialID : 0;
+	const int materialID1 = collision1 ? collision1->m_materialID : 0;
+	const dMaterialProperties materialProp = world->FindMaterial(materialID0, materialID1);
 	return materialProp.m_collisionEnable ? 1 : 0;
 }
 
+// newton reports one face attribute per contact, it belongs to the shape made of faces, not to the other one
+static int GetContactMaterialID(const dNewtonCollision* const collision, const NewtonCollision* const shape, int faceAttribute)
+{
+	if (!collision) {
+		return 0;
+	}
+	const int type = NewtonCollisionGetType(shape);
+	const bool hasFaces = (type == SERIALIZE_ID_HEIGHTFIELD) || (type == SERIALIZE_ID_TREE) || (type == SERIALIZE_ID_USERMESH);
+	return collision->GetMaterialID(hasFaces ? faceAttribute : -1);
+}
+
 void dNewtonWorld::OnContactCollision(const NewtonJoint* contactJoint, dFloat timestep, int threadIndex)
 {
 	NewtonBody* const body0 = NewtonJointGetBody0(contactJoint);
@@ -364,6 +925,10 @@ void dNewtonWorld::OnContactCollision(const NewtonJoint* contactJoint, dFloat ti
 //	dbody1->m_onCollision(dbody0);
 
 	dNewtonWorld* const world = (dNewtonWorld*)NewtonWorldGetUserData(NewtonBodyGetWorld(body0));
+	dNewtonTraceScope scope(world->m_trace, "OnContactCollision", threadIndex);
+	if (world->m_profiling) {
+		NewtonAtomicAdd(&world->m_contactJointCounter, 1);
+	}
 
 	const dMaterialProperties* lastMaterialProp = NULL;
 	for (void* contact = NewtonContactJointGetFirstContact(contactJoint); contact; contact = NewtonContactJointGetNextContact(contactJoint, contact)) {
@@ -373,7 +938,10 @@ void dNewtonWorld::OnContactCollision(const NewtonJoint* contactJoint, dFloat ti
 		NewtonCollision* const newtonCollision1 = (NewtonCollision*)NewtonContactGetCollision1(contact);
 		dNewtonCollision* const collision0 = (dNewtonCollision*)NewtonCollisionGetUserData(newtonCollision0);
 		dNewtonCollision* const collision1 = (dNewtonCollision*)NewtonCollisionGetUserData(newtonCollision1);
-		const dMaterialProperties* const currentMaterialProp = &world->FindMaterial(collision0->m_materialID, collision1->m_materialID);
+		const int faceAttribute = int(NewtonMaterialGetContactFaceAttribute(material));
+		const int materialID0 = GetContactMaterialID(collision0, newtonCollision0, faceAttribute);
+		const int materialID1 = GetContactMaterialID(collision1, newtonCollision1, faceAttribute);
+		const dMaterialProperties* const currentMaterialProp = &world->FindMaterial(materialID0, materialID1);
 		dMaterialProperties materialProp(*currentMaterialProp);
 		if (currentMaterialProp != lastMaterialProp) {
 			lastMaterialProp = currentMaterialProp;
@@ -388,7 +956,11 @@ void dNewtonWorld::OnContactCollision(const NewtonJoint* contactJoint, dFloat ti
 
 void dNewtonWorld::Update(dFloat timestepInSeconds)
 {
+	dNewtonTraceScope scope(m_trace, "Update", dNewtonTrace::m_mainThread);
 	const int maxInterations = 1;
+	const dLong frameStartTime = m_profiling ? dNewtonGetTimeInMicroseconds() : 0;
+	m_stepProfile.m_stepCount = 0;
+
 	dLong timestepMicroSeconds = dClamp((dLong)(double(timestepInSeconds) * 1000000.0f), dLong(0), m_timeStepInMicroSeconds);
 	m_realTimeInMicroSeconds += timestepMicroSeconds * maxInterations;
 
@@ -405,30 +977,788 @@ void dNewtonWorld::Update(dFloat timestepInSeconds)
 
 	// call every frame update
 	m_interpotationParam = dFloat(double(m_realTimeInMicroSeconds) / double(m_timeStepInMicroSeconds));
-	m_onTransformCallback();
+	const dLong transformStartTime = m_profiling ? dNewtonGetTimeInMicroseconds() : 0;
+	{
+		dNewtonTraceScope transformScope(m_trace, "OnTransformCallback", dNewtonTrace::m_mainThread);
+		m_onTransformCallback();
+	}
+
+	if (m_profiling) {
+		const dLong frameEndTime = dNewtonGetTimeInMicroseconds();
+		m_stepProfile.m_transformCallbackTime = dFloat(frameEndTime - transformStartTime) * 0.001f;
+		m_stepProfile.m_frameTime = dFloat(frameEndTime - frameStartTime) * 0.001f;
+	}
+}
+
+#define D_SERIALIZED_SCENE_MAGIC	0x4e575343
+#define D_SERIALIZED_SCENE_VERSION	1
+#define D_SERIALIZED_BODY_MAGIC		0x4e574231
+#define D_SCENE_NAME_LENGTH			1024
+
+// first bytes of a scene file, newton's own stream follows it
+class dNewtonSceneHeader
+{
+	public:
+	int m_magic;
+	int m_version;
+	int m_payloadSize;
+};
+
+// written after newton's own data for every body of a serialized scene,
+// followed by one dNewtonSerializedShape per shape in dNewtonCollisionSerialized::CollectShapes order
+class dNewtonSerializedBody
+{
+	public:
+	int m_magic;
+	int m_sceneID;
+	int m_networkID;
+	int m_shapeCount;
+};
+
+// bodies without a scene id, or with one already taken, can not be claimed and are deleted after the load.
+// a legacy file is newton's stream alone, its bodies have no record and are claimed in file order
+class dNewtonSceneLoader
+{
+	public:
+	dNewtonWorld* m_world;
+	dList<dNewtonBody*> m_unclaimed;
+	bool m_valid;
+	bool m_legacy;
+};
+
+void dNewtonWorld::OnBodySerialize(NewtonBody* const body, void* const userData, NewtonSerializeCallback function, void* const serializeHandle)
+{
+	dNewtonBody* const wrapper = (dNewtonBody*)NewtonBodyGetUserData(body);
+	dList<NewtonCollision*> shapes;
+	dNewtonCollisionSerialized::CollectShapes(NewtonBodyGetCollision(body), shapes);
+
+	dNewtonSerializedBody record;
+	record.m_magic = D_SERIALIZED_BODY_MAGIC;
+	record.m_sceneID = wrapper ? wrapper->m_sceneID : -1;
+	record.m_networkID = wrapper ? wrapper->m_networkID : -1;
+	record.m_shapeCount = shapes.GetCount();
+	function(serializeHandle, &record, sizeof(record));
+
+	for (dList<NewtonCollision*>::dListNode* node = shapes.GetFirst(); node; node = node->GetNext()) {
+		const dNewtonCollision* const collision = (dNewtonCollision*)NewtonCollisionGetUserData(node->GetInfo());
+		dNewtonSerializedShape data;
+		data.m_materialID = collision ? collision->m_materialID : 0;
+		data.m_layer = collision ? collision->m_layer : 0;
+		function(serializeHandle, &data, sizeof(data));
+	}
+}
+
+void dNewtonWorld::OnBodyDeserialize(NewtonBody* const body, void* const userData, NewtonDeserializeCallback function, void* const serializeHandle)
+{
+	dNewtonSceneLoader* const loader = (dNewtonSceneLoader*)userData;
+	dNewtonWorld* const world = loader->m_world;
+
+	dNewtonSerializedBody record;
+	if (loader->m_legacy) {
+		record.m_magic = D_SERIALIZED_BODY_MAGIC;
+		record.m_sceneID = -1;
+		record.m_networkID = -1;
+		record.m_shapeCount = 0;
+	} else {
+		function(serializeHandle, &record, sizeof(record));
+	}
+	if (record.m_magic != D_SERIALIZED_BODY_MAGIC) {
+		// the header matched but the stream did not, nothing after this point can be trusted
+		loader->m_valid = false;
+		record.m_sceneID = -1;
+		record.m_networkID = -1;
+		record.m_shapeCount = 0;
+	}
+
+	dList<NewtonCollision*> shapes;
+	dNewtonCollisionSerialized::CollectShapes(NewtonBodyGetCollision(body), shapes);
+	if (!loader->m_legacy && (record.m_shapeCount != shapes.GetCount())) {
+		loader->m_valid = false;
+	}
+
+	// every saved record is read even when the shapes do not match, so the stream stays in step
+	dNewtonCollisionSerialized* collision = NULL;
+	dList<NewtonCollision*>::dListNode* node = shapes.GetFirst();
+	for (int i = 0; i < record.m_shapeCount; i++) {
+		dNewtonSerializedShape data;
+		function(serializeHandle, &data, sizeof(data));
+		if (!node) {
+			continue;
+		}
+		if (!collision) {
+			collision = new dNewtonCollisionSerialized(world, node->GetInfo(), body, data);
+		} else {
+			collision->AddSubShape(node->GetInfo(), data);
+		}
+		node = node->GetNext();
+	}
+	for (; node; node = node->GetNext()) {
+		dNewtonSerializedShape data;
+		memset(&data, 0, sizeof(data));
+		if (!collision) {
+			collision = new dNewtonCollisionSerialized(world, node->GetInfo(), body, data);
+		} else {
+			collision->AddSubShape(node->GetInfo(), data);
+		}
+	}
+
+	dNewtonBody* wrapper;
+	if (NewtonBodyGetType(body) == NEWTON_KINEMATIC_BODY) {
+		wrapper = new dNewtonKinematicBody(world, body, collision);
+	} else {
+		wrapper = new dNewtonDynamicBody(world, body, collision);
+	}
+	wrapper->SetNetworkID(record.m_networkID);
+	wrapper->m_sceneID = record.m_sceneID;
+
+	if (loader->m_legacy) {
+		world->m_legacyBodies.Append(wrapper);
+	} else if ((record.m_sceneID < 0) || !world->m_serializedBodies.Insert(wrapper, record.m_sceneID)) {
+		loader->m_unclaimed.Append(wrapper);
+	}
+}
+
+// newton only reads and writes whole named files, its stream goes through a scratch file next to the scene
+static bool GetScratchName(char* const scratchName, const char* const sceneName)
+{
+	if (strlen(sceneName) + 5 > D_SCENE_NAME_LENGTH) {
+		return false;
+	}
+	strcpy(scratchName, sceneName);
+	strcat(scratchName, ".tmp");
+	return true;
+}
+
+static bool CopyFileBytes(FILE* const dst, FILE* const src, long size)
+{
+	char buffer[4096];
+	while (size > 0) {
+		const size_t count = size_t(dMin(size, long(sizeof(buffer))));
+		if ((fread(buffer, 1, count, src) != count) || (fwrite(buffer, 1, count, dst) != count)) {
+			return false;
+		}
+		size -= long(count);
+	}
+	return true;
 }
 
 void dNewtonWorld::SaveSerializedScene(char* const sceneName)
 {
-	NewtonSerializeToFile(m_world, sceneName, NULL, NULL);
+	char scratchName[D_SCENE_NAME_LENGTH];
+	if (!GetScratchName(scratchName, sceneName)) {
+		return;
+	}
+
+	WaitForUpdateToFinish();
+	NewtonSerializeToFile(m_world, scratchName, OnBodySerialize, this);
+
+	FILE* const payload = fopen(scratchName, "rb");
+	if (payload) {
+		fseek(payload, 0, SEEK_END);
+		const long size = ftell(payload);
+		fseek(payload, 0, SEEK_SET);
+
+		FILE* const file = fopen(sceneName, "wb");
+		if (file) {
+			dNewtonSceneHeader header;
+			header.m_magic = D_SERIALIZED_SCENE_MAGIC;
+			header.m_version = D_SERIALIZED_SCENE_VERSION;
+			header.m_payloadSize = int(size);
+			const bool written = (fwrite(&header, sizeof(header), 1, file) == 1) && CopyFileBytes(file, payload, size);
+			fclose(file);
+			if (!written) {
+				remove(sceneName);
+			}
+		}
+		fclose(payload);
+	}
+	remove(scratchName);
+}
+
+bool dNewtonWorld::LoadSerializedScene(const char* const sceneName)
+{
+	char scratchName[D_SCENE_NAME_LENGTH];
+	if (!GetScratchName(scratchName, sceneName)) {
+		return false;
+	}
+
+	FILE* const file = fopen(sceneName, "rb");
+	if (!file) {
+		return false;
+	}
+
+	// files saved before the header was added are newton's stream alone and go to newton as they are,
+	// a file with our header but another version or a wrong size is rejected before newton reads it
+	dNewtonSceneHeader header;
+	const bool hasHeader = (fread(&header, sizeof(header), 1, file) == 1) && (header.m_magic == D_SERIALIZED_SCENE_MAGIC);
+	const bool legacy = !hasHeader;
+	bool valid = legacy || (header.m_version == D_SERIALIZED_SCENE_VERSION);
+	if (hasHeader && valid) {
+		fseek(file, 0, SEEK_END);
+		valid = (ftell(file) == long(sizeof(header)) + header.m_payloadSize);
+		fseek(file, long(sizeof(header)), SEEK_SET);
+	}
+	if (hasHeader && valid) {
+		FILE* const payload = fopen(scratchName, "wb");
+		valid = payload && CopyFileBytes(payload, file, header.m_payloadSize);
+		if (payload) {
+			fclose(payload);
+		}
+	}
+	fclose(file);
+	if (!valid) {
+		remove(scratchName);
+		return false;
+	}
+
+	WaitForUpdateToFinish();
+	ReleaseSerializedBodies();
+
+	dNewtonSceneLoader loader;
+	loader.m_world = this;
+	loader.m_valid = true;
+	loader.m_legacy = legacy;
+	{
+		// a loaded scene is charged to its bodies, shapes included
+		const dAllocScope scope(m_allocSlot, dAllocScope::m_bodies);
+		NewtonDeserializeFromFile(m_world, legacy ? sceneName : scratchName, OnBodyDeserialize, &loader);
+	}
+	remove(scratchName);
+
+	for (dList<dNewtonBody*>::dListNode* node = loader.m_unclaimed.GetFirst(); node; node = node->GetNext()) {
+		delete node->GetInfo();
+	}
+
+	// the game recreates its joints through the wrapper, drop the ones newton saved with the bodies
+	dTree<dNewtonBody*, int>::Iterator iter(m_serializedBodies);
+	for (iter.Begin(); iter; iter++) {
+		DestroySavedJoints(iter.GetNode()->GetInfo()->m_body);
+	}
+	for (dList<dNewtonBody*>::dListNode* node = m_legacyBodies.GetFirst(); node; node = node->GetNext()) {
+		DestroySavedJoints(node->GetInfo()->m_body);
+	}
+
+	if (!loader.m_valid) {
+		ReleaseSerializedBodies();
+	}
+	return loader.m_valid;
+}
+
+void dNewtonWorld::DestroySavedJoints(NewtonBody* const body)
+{
+	for (NewtonJoint* joint = NewtonBodyGetFirstJoint(body); joint; joint = NewtonBodyGetFirstJoint(body)) {
+		NewtonDestroyJoint(m_world, joint);
+	}
+}
+
+dNewtonBody* dNewtonWorld::TakeSerializedBody(int sceneID)
+{
+	// a legacy scene has no ids, the bodies go out in the order they were saved
+	if (m_legacyBodies.GetFirst()) {
+		dNewtonBody* const body = m_legacyBodies.GetFirst()->GetInfo();
+		m_legacyBodies.Remove(m_legacyBodies.GetFirst());
+		return body;
+	}
+
+	dTree<dNewtonBody*, int>::dTreeNode* const node = m_serializedBodies.Find(sceneID);
+	if (!node) {
+		return NULL;
+	}
+	dNewtonBody* const body = node->GetInfo();
+	m_serializedBodies.Remove(node);
+	return body;
+}
+
+void dNewtonWorld::ReleaseSerializedBodies()
+{
+	while (m_serializedBodies.GetRoot()) {
+		dTree<dNewtonBody*, int>::dTreeNode* const node = m_serializedBodies.GetRoot();
+		dNewtonBody* const body = node->GetInfo();
+		m_serializedBodies.Remove(node);
+		delete body;
+	}
+	while (m_legacyBodies.GetFirst()) {
+		dNewtonBody* const body = m_legacyBodies.GetFirst()->GetInfo();
+		m_legacyBodies.Remove(m_legacyBodies.GetFirst());
+		delete body;
+	}
+}
+
+// copies the wrapper data of the source child, the new wrapper outlives the collider that made the source
+dNewtonSerializedShape dNewtonWorld::GetShapeData(const NewtonCollision* const shape)
+{
+	dNewtonSerializedShape data;
+	const dNewtonCollision* const source = (dNewtonCollision*)NewtonCollisionGetUserData(shape);
+	data.m_materialID = source ? source->m_materialID : 0;
+	data.m_layer = source ? source->m_layer : 0;
+	return data;
+}
+
+int dNewtonWorld::FractureBody(dNewtonBody* const body, const int* const childGroups, int childCount)
+{
+	// the unclaimed fragments of the last fracture can still be in the step
+	WaitForUpdateToFinish();
+	ReleaseFracturedBodies();
+
+	NewtonBody* const newtonBody = body ? body->m_body : NULL;
+	if (!newtonBody || !childGroups || (NewtonBodyGetType(newtonBody) != NEWTON_DYNAMIC_BODY)) {
+		return 0;
+	}
+
+	const dAllocScope scope(m_allocSlot, dAllocScope::m_bodies);
+	NewtonCollision* const compound = NewtonBodyGetCollision(newtonBody);
+	if (NewtonCollisionGetType(compound) != SERIALIZE_ID_COMPOUND) {
+		return 0;
+	}
+
+	int nodeCount = 0;
+	for (void* node = NewtonCompoundCollisionGetFirstNode(compound); node; node = NewtonCompoundCollisionGetNextNode(compound, node)) {
+		nodeCount++;
+	}
+
+	// sort the children by group, and sum the volume of each group to share the mass
+	void** const nodes = new void*[nodeCount];
+	int* const groups = new int[nodeCount];
+	dTree<dFloat, int> groupVolumes;
+	dFloat totalVolume = 0.0f;
+	int stayCount = 0;
+	int index = 0;
+	for (void* node = NewtonCompoundCollisionGetFirstNode(compound); node; node = NewtonCompoundCollisionGetNextNode(compound, node)) {
+		const int group = (index < childCount) ? dMax(childGroups[index], 0) : 0;
+		const dFloat volume = NewtonConvexCollisionCalculateVolume(NewtonCompoundCollisionGetCollisionFromNode(compound, node));
+		nodes[index] = node;
+		groups[index] = group;
+		totalVolume += volume;
+		if (group) {
+			dTree<dFloat, int>::dTreeNode* groupNode = groupVolumes.Find(group);
+			if (!groupNode) {
+				groupNode = groupVolumes.Insert(0.0f, group);
+			}
+			groupNode->GetInfo() += volume;
+		} else {
+			stayCount++;
+		}
+		index++;
+	}
+
+	if (!stayCount || !groupVolumes.GetCount()) {
+		delete[] groups;
+		delete[] nodes;
+		return 0;
+	}
+
+	dMatrix matrix;
+	dVector com(0.0f);
+	dVector veloc(0.0f);
+	dVector omega(0.0f);
+	dVector angularDamping(0.0f);
+	dFloat mass;
+	dFloat Ixx;
+	dFloat Iyy;
+	dFloat Izz;
+	NewtonBodyGetMatrix(newtonBody, &matrix[0][0]);
+	NewtonBodyGetCentreOfMass(newtonBody, &com[0]);
+	NewtonBodyGetVelocity(newtonBody, &veloc[0]);
+	NewtonBodyGetOmega(newtonBody, &omega[0]);
+	NewtonBodyGetAngularDamping(newtonBody, &angularDamping[0]);
+	NewtonBodyGetMass(newtonBody, &mass, &Ixx, &Iyy, &Izz);
+	const dFloat linearDamping = NewtonBodyGetLinearDamping(newtonBody);
+	const dVector comWorld(matrix.TransformVector(com));
+	const dNewtonSerializedShape compoundData(GetShapeData(compound));
+
+	// every group is one new compound built in a single add remove block, the children keep their local matrix
+	dFloat fragmentsMass = 0.0f;
+	dTree<dFloat, int>::Iterator iter(groupVolumes);
+	for (iter.Begin(); iter; iter++) {
+		const int group = iter.GetKey();
+		NewtonCollision* const fragmentShape = NewtonCreateCompoundCollision(m_world, 0);
+		NewtonCompoundCollisionBeginAddRemove(fragmentShape);
+		for (int i = 0; i < nodeCount; i++) {
+			if (groups[i] == group) {
+				NewtonCompoundCollisionAddSubCollision(fragmentShape, NewtonCompoundCollisionGetCollisionFromNode(compound, nodes[i]));
+			}
+		}
+		NewtonCompoundCollisionEndAddRemove(fragmentShape);
+
+		NewtonBody* const fragment = NewtonCreateDynamicBody(m_world, fragmentShape, &matrix[0][0]);
+		ReleaseShape(fragmentShape);
+
+		const dFloat fragmentMass = (totalVolume > 0.0f) ? mass * iter.GetNode()->GetInfo() / totalVolume : mass / nodeCount;
+		NewtonCollision* const fragmentCollision = NewtonBodyGetCollision(fragment);
+		NewtonBodySetMassProperties(fragment, fragmentMass, fragmentCollision);
+		fragmentsMass += fragmentMass;
+
+		// the fragment moves the way its center of mass moved as part of the whole body
+		dVector fragmentCom(0.0f);
+		NewtonBodyGetCentreOfMass(fragment, &fragmentCom[0]);
+		dVector fragmentVeloc(veloc + omega.CrossProduct(matrix.TransformVector(fragmentCom) - comWorld));
+		fragmentVeloc.m_w = 0.0f;
+		NewtonBodySetVelocity(fragment, &fragmentVeloc[0]);
+		NewtonBodySetOmega(fragment, &omega[0]);
+		NewtonBodySetLinearDamping(fragment, linearDamping);
+		NewtonBodySetAngularDamping(fragment, &angularDamping[0]);
+
+		// the copied children still point at the wrappers of the source body, they get their own
+		dNewtonCollisionSerialized* const collision = new dNewtonCollisionSerialized(this, fragmentCollision, fragment, compoundData);
+		for (void* node = NewtonCompoundCollisionGetFirstNode(fragmentCollision); node; node = NewtonCompoundCollisionGetNextNode(fragmentCollision, node)) {
+			NewtonCollision* const child = NewtonCompoundCollisionGetCollisionFromNode(fragmentCollision, node);
+			collision->AddSubShape(child, GetShapeData(child));
+		}
+		m_fracturedBodies.Insert(new dNewtonDynamicBody(this, fragment, collision), group);
+	}
+
+	// the source body loses all moving children in one add remove block
+	NewtonCompoundCollisionBeginAddRemove(compound);
+	for (int i = 0; i < nodeCount; i++) {
+		if (groups[i]) {
+			NewtonCompoundCollisionRemoveSubCollision(compound, nodes[i]);
+		}
+	}
+	NewtonCompoundCollisionEndAddRemove(compound);
+	delete[] groups;
+	delete[] nodes;
+
+	// what is left keeps the rest of the mass, its velocity follows the shift of the center of mass
+	NewtonBodySetMassProperties(newtonBody, dMax(mass - fragmentsMass, mass / nodeCount), compound);
+	dVector newCom(0.0f);
+	NewtonBodyGetCentreOfMass(newtonBody, &newCom[0]);
+	dVector newVeloc(veloc + omega.CrossProduct(matrix.TransformVector(newCom) - comWorld));
+	newVeloc.m_w = 0.0f;
+	NewtonBodySetVelocity(newtonBody, &newVeloc[0]);
+	body->InitForceAccumulators();
+
+	dNewtonBody::RefreshBroadphaseBounds(newtonBody);
+	return m_fracturedBodies.GetCount();
+}
+
+dNewtonBody* dNewtonWorld::TakeFracturedBody(int group)
+{
+	dTree<dNewtonBody*, int>::dTreeNode* const node = m_fracturedBodies.Find(group);
+	if (!node) {
+		return NULL;
+	}
+	dNewtonBody* const body = node->GetInfo();
+	m_fracturedBodies.Remove(node);
+	return body;
+}
+
+void dNewtonWorld::ReleaseFracturedBodies()
+{
+	while (m_fracturedBodies.GetRoot()) {
+		dTree<dNewtonBody*, int>::dTreeNode* const node = m_fracturedBodies.GetRoot();
+		dNewtonBody* const body = node->GetInfo();
+		m_fracturedBodies.Remove(node);
+		delete body;
+	}
+}
+
+#define D_STATE_SNAPSHOT_MAGIC	0x4e575332
+
+// state snapshot layout, the header is followed by one record per body in newton list order
+class dNewtonStateHeader
+{
+	public:
+	int m_magic;
+	int m_bodyCount;
+	long long m_stepIndex;
+	long long m_realTimeInMicroSeconds;
+};
+
+class dNewtonBodyState
+{
+	public:
+	int m_id;
+	int m_sleepState;
+	dFloat m_matrix[16];
+	dFloat m_veloc[3];
+	dFloat m_omega[3];
+
+	// the MoveTo target of a kinematic body, m_moving is zero for every other body
+	int m_moving;
+	dFloat m_targetPosit[3];
+	dFloat m_targetRotation[4];
+	dFloat m_targetTime;
+};
+
+// static bodies never change, they are left out of the snapshot
+static bool IsStaticBody(const NewtonBody* const body)
+{
+	dFloat mass;
+	dFloat Ixx;
+	dFloat Iyy;
+	dFloat Izz;
+	if (NewtonBodyGetType(body) == NEWTON_KINEMATIC_BODY) {
+		return false;
+	}
+	NewtonBodyGetMass(body, &mass, &Ixx, &Iyy, &Izz);
+	return mass == 0.0f;
+}
+
+// every kinematic body the wrapper creates is a dNewtonKinematicBody
+static dNewtonKinematicBody* GetKinematicWrapper(const NewtonBody* const body)
+{
+	if (NewtonBodyGetType(body) != NEWTON_KINEMATIC_BODY) {
+		return NULL;
+	}
+	return (dNewtonKinematicBody*)NewtonBodyGetUserData(body);
+}
+
+int dNewtonWorld::GetStateSize() const
+{
+	return int (sizeof(dNewtonStateHeader) + (NewtonWorldGetBodyCount(m_world) + m_bodyAddQueue.GetCount()) * sizeof(dNewtonBodyState));
+}
+
+int dNewtonWorld::CaptureState(void* const buffer, int bufferSize)
+{
+	WaitForUpdateToFinish();
+
+	char* const data = (char*)buffer;
+	dNewtonBodyState* const states = (dNewtonBodyState*)(data + sizeof(dNewtonStateHeader));
+	const int capacity = (bufferSize - int(sizeof(dNewtonStateHeader))) / int(sizeof(dNewtonBodyState));
+	if (!buffer || (capacity < 0)) {
+		return 0;
+	}
+
+	int count = 0;
+	for (NewtonBody* body = NewtonWorldGetFirstBody(m_world); body; body = NewtonWorldGetNextBody(m_world, body)) {
+		if (!IsStaticBody(body)) {
+			if (count >= capacity) {
+				return 0;
+			}
+			dNewtonBodyState& state = states[count];
+			state.m_id = NewtonBodyGetID(body);
+			state.m_sleepState = NewtonBodyGetSleepState(body);
+			NewtonBodyGetMatrix(body, state.m_matrix);
+			NewtonBodyGetVelocity(body, state.m_veloc);
+			NewtonBodyGetOmega(body, state.m_omega);
+
+			state.m_moving = 0;
+			const dNewtonKinematicBody* const kinematic = GetKinematicWrapper(body);
+			if (kinematic) {
+				state.m_moving = kinematic->m_moverNode ? 1 : 0;
+				state.m_targetPosit[0] = kinematic->m_targetPosit.m_x;
+				state.m_targetPosit[1] = kinematic->m_targetPosit.m_y;
+				state.m_targetPosit[2] = kinematic->m_targetPosit.m_z;
+				state.m_targetRotation[0] = kinematic->m_targetRotation.m_q0;
+				state.m_targetRotation[1] = kinematic->m_targetRotation.m_q1;
+				state.m_targetRotation[2] = kinematic->m_targetRotation.m_q2;
+				state.m_targetRotation[3] = kinematic->m_targetRotation.m_q3;
+				state.m_targetTime = kinematic->m_targetTime;
+			}
+			count++;
+		}
+	}
+
+	dNewtonStateHeader header;
+	header.m_magic = D_STATE_SNAPSHOT_MAGIC;
+	header.m_bodyCount = count;
+	header.m_stepIndex = m_stepIndex;
+	header.m_realTimeInMicroSeconds = m_realTimeInMicroSeconds;
+	memcpy(data, &header, sizeof(header));
+	return int (sizeof(dNewtonStateHeader) + count * sizeof(dNewtonBodyState));
+}
+
+bool dNewtonWorld::RestoreState(const void* const buffer, int bufferSize)
+{
+	WaitForUpdateToFinish();
+
+	dNewtonStateHeader header;
+	const char* const data = (const char*)buffer;
+	if (!buffer || (bufferSize < int(sizeof(dNewtonStateHeader)))) {
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	// the count comes from the caller's buffer, it is checked by division so a bad one can not wrap
+	const int capacity = (bufferSize - int(sizeof(dNewtonStateHeader))) / int(sizeof(dNewtonBodyState));
+	if ((header.m_magic != D_STATE_SNAPSHOT_MAGIC) || (header.m_bodyCount < 0) || (header.m_bodyCount > capacity)) {
+		return false;
+	}
+
+	// records line up with the body list unless bodies were added or removed since the capture,
+	// only then the bodies are looked up by id
+	dTree<NewtonBody*, int> bodyMap;
+	NewtonBody* body = NewtonWorldGetFirstBody(m_world);
+	const dNewtonBodyState* const states = (const dNewtonBodyState*)(data + sizeof(dNewtonStateHeader));
+	for (int i = 0; i < header.m_bodyCount; i++) {
+		const dNewtonBodyState& state = states[i];
+		while (body && IsStaticBody(body)) {
+			body = NewtonWorldGetNextBody(m_world, body);
+		}
+
+		NewtonBody* target = NULL;
+		if (body && (NewtonBodyGetID(body) == state.m_id)) {
+			target = body;
+			body = NewtonWorldGetNextBody(m_world, body);
+		} else {
+			if (!bodyMap.GetCount()) {
+				for (NewtonBody* ptr = NewtonWorldGetFirstBody(m_world); ptr; ptr = NewtonWorldGetNextBody(m_world, ptr)) {
+					bodyMap.Insert(ptr, NewtonBodyGetID(ptr));
+				}
+			}
+			dTree<NewtonBody*, int>::dTreeNode* const node = bodyMap.Find(state.m_id);
+			target = node ? node->GetInfo() : NULL;
+			body = NULL;
+		}
+
+		if (target) {
+			NewtonBodySetMatrix(target, state.m_matrix);
+			NewtonBodySetVelocity(target, state.m_veloc);
+			NewtonBodySetOmega(target, state.m_omega);
+			NewtonBodySetSleepState(target, state.m_sleepState);
+
+			dNewtonBody* const wrapper = (dNewtonBody*)NewtonBodyGetUserData(target);
+			if (wrapper) {
+				wrapper->ResetInterpolation(dMatrix(state.m_matrix));
+			}
+
+			dNewtonKinematicBody* const kinematic = GetKinematicWrapper(target);
+			if (kinematic) {
+				kinematic->m_targetPosit = dVector(state.m_targetPosit[0], state.m_targetPosit[1], state.m_targetPosit[2], 1.0f);
+				kinematic->m_targetRotation = dQuaternion(state.m_targetRotation[0], state.m_targetRotation[1], state.m_targetRotation[2], state.m_targetRotation[3]);
+				kinematic->m_targetTime = state.m_targetTime;
+				if (state.m_moving && !kinematic->m_moverNode) {
+					kinematic->m_moverNode = m_kinematicMovers.Append(kinematic);
+				} else if (!state.m_moving && kinematic->m_moverNode) {
+					m_kinematicMovers.Remove(kinematic->m_moverNode);
+					kinematic->m_moverNode = NULL;
+				}
+			}
+		}
+	}
+
+	m_stepIndex = header.m_stepIndex;
+	m_realTimeInMicroSeconds = dLong(header.m_realTimeInMicroSeconds);
+
+	// newton has no way to save contacts, the cached ones belong to the state being discarded.
+	// the first step after a restore starts cold, see the note on RestoreState
+	NewtonInvalidateCache(m_world);
+	return true;
+}
+
+void dNewtonWorld::SetReplicationPrecision(dFloat positionPrecision, dFloat velocityPrecision)
+{
+	m_replicationPositionPrecision = dMax(positionPrecision, dFloat(1.0e-5f));
+	m_replicationVelocityPrecision = dMax(velocityPrecision, dFloat(1.0e-5f));
+}
+
+int dNewtonWorld::GetReplicationStateSize() const
+{
+	return dNewtonReplication::GetSnapshotSize(m_networkBodies.GetCount());
+}
+
+int dNewtonWorld::CaptureReplicationState(void* const snapshot, int snapshotSize)
+{
+	WaitForUpdateToFinish();
+	if (!snapshot || (snapshotSize < GetReplicationStateSize())) {
+		return 0;
+	}
+
+	// the tree walks the bodies in network id order, which the delta encoder relies on
+	int count = 0;
+	dNewtonReplicatedBody* const bodies = (dNewtonReplicatedBody*)((char*)snapshot + sizeof(dNewtonReplicationHeader));
+	dTree<dNewtonBody*, int>::Iterator iter(m_networkBodies);
+	for (iter.Begin(); iter; iter++) {
+		const dNewtonBody* const body = *iter;
+		if (body->m_body) {
+			dMatrix matrix;
+			dVector veloc(0.0f);
+			dVector omega(0.0f);
+			NewtonBodyGetMatrix(body->m_body, &matrix[0][0]);
+			NewtonBodyGetVelocity(body->m_body, &veloc[0]);
+			NewtonBodyGetOmega(body->m_body, &omega[0]);
+			const bool sleeping = NewtonBodyGetSleepState(body->m_body) ? true : false;
+			bodies[count].Quantize(iter.GetKey(), matrix, veloc, omega, sleeping, m_replicationPositionPrecision, m_replicationVelocityPrecision);
+			count++;
+		}
+	}
+
+	dNewtonReplicationHeader header;
+	header.m_bodyCount = count;
+	header.m_stepIndex = m_stepIndex;
+	header.m_positionPrecision = m_replicationPositionPrecision;
+	header.m_velocityPrecision = m_replicationVelocityPrecision;
+	return dNewtonReplication::WriteSnapshotHeader(snapshot, header);
+}
+
+int dNewtonWorld::EncodeDelta(const void* const baseline, int baselineSize, const void* const snapshot, int snapshotSize, void* const delta, int deltaSize) const
+{
+	return dNewtonReplication::EncodeDelta(baseline, baselineSize, snapshot, snapshotSize, delta, deltaSize);
+}
+
+int dNewtonWorld::ApplyDelta(const void* const baseline, int baselineSize, const void* const delta, int deltaSize, void* const snapshot, int snapshotSize)
+{
+	WaitForUpdateToFinish();
+	const int size = dNewtonReplication::DecodeDelta(baseline, baselineSize, delta, deltaSize, snapshot, snapshotSize);
+	if (!size) {
+		return 0;
+	}
+
+	dNewtonReplicationHeader header;
+	const dNewtonReplicatedBody* bodies = NULL;
+	dNewtonReplication::ReadSnapshot(snapshot, size, header, &bodies);
+	for (int i = 0; i < header.m_bodyCount; i++) {
+		const dNewtonReplicatedBody& state = bodies[i];
+		dTree<dNewtonBody*, int>::dTreeNode* const node = m_networkBodies.Find(state.m_networkID);
+		dNewtonBody* const body = node ? node->GetInfo() : NULL;
+		if (body && body->m_body) {
+			dMatrix matrix;
+			dVector veloc;
+			dVector omega;
+			state.Dequantize(matrix, veloc, omega, header.m_positionPrecision, header.m_velocityPrecision);
+			NewtonBodySetMatrix(body->m_body, &matrix[0][0]);
+			NewtonBodySetVelocity(body->m_body, &veloc[0]);
+			NewtonBodySetOmega(body->m_body, &omega[0]);
+			NewtonBodySetSleepState(body->m_body, (state.m_flags & dNewtonReplicatedBody::m_sleeping) ? 1 : 0);
+			body->ResetInterpolation(matrix);
+		}
+	}
+	return size;
+}
+
+void dNewtonWorld::UpdateKinematicBodies()
+{
+	dList<dNewtonKinematicBody*>::dListNode* next;
+	for (dList<dNewtonKinematicBody*>::dListNode* node = m_kinematicMovers.GetFirst(); node; node = next) {
+		next = node->GetNext();
+		node->GetInfo()->UpdateTarget(m_timeStep);
+	}
 }
 
 void dNewtonWorld::UpdateWorld()
 {
+	dNewtonTraceScope scope(m_trace, "UpdateWorld", dNewtonTrace::m_mainThread);
+	const dLong startTime = m_profiling ? dNewtonGetTimeInMicroseconds() : 0;
 	for (NewtonBody* bodyPtr = NewtonWorldGetFirstBody(m_world); bodyPtr; bodyPtr = NewtonWorldGetNextBody(m_world, bodyPtr)) {
 		dNewtonBody* const body = (dNewtonBody*)NewtonBodyGetUserData(bodyPtr);
 		body->InitForceAccumulators();
 	}
 
 	// every rigid body update
-	m_onUpdateCallback(m_timeStep);
-
-	if (m_asyncUpdateMode) 
 	{
-		NewtonWaitForUpdateToFinish(m_world);
+		dNewtonTraceScope callbackScope(m_trace, "OnUpdateCallback", dNewtonTrace::m_mainThread);
+		m_onUpdateCallback(m_timeStep);
+	}
+	const dLong callbackTime = m_profiling ? dNewtonGetTimeInMicroseconds() : 0;
+
+	// this is the only safe point of the frame, commit everything queued while the last step was running
+	WaitForUpdateToFinish();
+	ReleaseFracturedBodies();
+	UpdateKinematicBodies();
+
+	if (m_profiling) {
+		const dLong waitTime = dNewtonGetTimeInMicroseconds();
+		m_stepProfile.m_forceCallbackTime = dFloat(callbackTime - startTime) * 0.001f;
+		m_stepProfile.m_waitTime = dFloat(waitTime - callbackTime) * 0.001f;
+		m_stepProfile.m_stepCount++;
+	}
+
+	m_stepIndex++;
+	if (m_asyncUpdateMode && !m_deterministic) {
+		m_updateInFlight = true;
 		NewtonUpdateAsync(m_world, m_timeStep);
 	} else {
 		NewtonUpdate(m_world, m_timeStep);
+		CollectStepProfile();
 	}
 }
 
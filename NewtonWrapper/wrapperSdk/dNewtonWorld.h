@@ -23,11 +23,14 @@
 
 #include "stdafx.h"
 #include "dAlloc.h"
+#include "dNewtonProfiler.h"
 
 class NewtonWorld;
 class dNewtonBody;
+class dNewtonKinematicBody;
 class dNewtonCollision;
 class dNewtonCollisionBox;
+class dNewtonSerializedShape;
 class dNewtonVehicleManager;
 
 
@@ -66,6 +69,78 @@ public:
 
 };
 
+// packed body description for dNewtonWorld::CreateBodies, the layout is mirrored on the managed side.
+// every descriptor needs its own collision, the body takes it over the same way the body constructors do.
+class dNewtonBodyDesc
+{
+	public:
+	dFloat m_matrix[16];
+	dFloat m_velocity[3];
+	dFloat m_omega[3];
+	dFloat m_mass;	// not used by kinematic bodies
+	int m_kinematic;
+	dNewtonCollision* m_collision;
+};
+
+// content key of a cached shape prototype. the first bytes of the parameters are kept and compared
+// verbatim, anything past them, as a hull vertex cloud, is compared by size and a second digest.
+class dNewtonShapeKey
+{
+	public:
+	dNewtonShapeKey(int type = 0);
+	void AddData(const void* const data, int sizeInBytes);
+	bool IsEqual(const dNewtonShapeKey& key) const;
+
+	// 64 bit FNV-1a, shared by everything that hashes raw bytes
+	static unsigned long long HashBytes(unsigned long long hash, const void* const data, int sizeInBytes);
+
+	unsigned long long m_hash;
+	unsigned long long m_digest;
+	int m_type;
+	int m_size;
+	unsigned char m_params[32];
+};
+
+// builds the prototype of a cached shape, the parameters that fit are read back from the key,
+// data is whatever did not, as a hull vertex cloud
+typedef NewtonCollision* (*dNewtonCreateShape)(NewtonWorld* const world, const dNewtonShapeKey& key, const void* const data, int sizeInBytes);
+
+// a shape cache miss made while a step is in flight. newton adds every new primitive to a shape list
+// the solver threads read, so the prototype is created at the next safe point and the wrapper holds
+// a null stand in until then
+class dNewtonShapeBuild: public dAlloc
+{
+	public:
+	dNewtonShapeBuild(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes);
+	~dNewtonShapeBuild();
+
+	dNewtonShapeKey m_key;
+	dNewtonCreateShape m_create;
+	char* m_data;
+	int m_size;
+};
+
+// mirrored on the managed side, the allocator numbers are process wide, the per category bytes
+// and the counts belong to the world
+class dNewtonMemoryStats
+{
+	public:
+	long long m_currentBytes;
+	long long m_peakBytes;
+	long long m_reservedBytes;
+	long long m_liveAllocations;
+	long long m_totalAllocations;
+	long long m_bodyBytes;
+	long long m_shapeBytes;
+	long long m_jointBytes;
+	long long m_solverBytes;
+	int m_bodyCount;
+	int m_shapeCount;
+	int m_jointCount;
+	int m_constraintCount;
+	int m_contactCount;
+};
+
 class dNewtonWorld: public dAlloc
 {
 	public:
@@ -92,6 +167,46 @@ class dNewtonWorld: public dAlloc
 	void SetBroadPhase(int broadphase);
 	void SetSubSteps(int subSteps);
 
+	// lockstep and replay mode: one solver thread, no async update, caches reset when switched on.
+	// that is all it controls, identical results also need the same build and cpu float mode on
+	// every peer and the bodies, joints and materials created in the same order, since newton
+	// solves islands in creation order.
+	// the requested thread count and async mode come back when it is turned off
+	void SetDeterministic(bool mode);
+	bool GetDeterministic() const;
+
+	// hash of the dynamic state of every body keyed by its network id, scene id or creation order,
+	// independent of the order newton keeps them in. compare it between peers at the same step index
+	// to detect a desync.
+	// it does not wait for an async step, while one runs it returns the last computed hash
+	long long GetStateHash();
+	long long GetStepIndex() const;
+
+	// in memory snapshot of the dynamic state for rollback: pose, velocities and sleep state
+	// of every non static body, the MoveTo target of kinematic bodies, plus the step index and
+	// the frame time accumulator. contacts are not part of it, newton can not save them, so the
+	// first step after a restore starts without warm started contacts. a rollback is therefore
+	// not bit exact against the original run, peers restoring the same snapshot still agree.
+	// joint internal state is not captured either: dCustomJoint can serialize itself but not be
+	// restored in place, so limits, motors and angle integration of joints keep their current
+	// values and a rollback through a driven or limited joint can diverge.
+	// GetStateSize is an upper bound for the buffer, CaptureState returns the bytes written
+	// or zero when the buffer is too small. the buffer should be 8 byte aligned
+	int GetStateSize() const;
+	int CaptureState(void* const buffer, int bufferSize);
+	bool RestoreState(const void* const buffer, int bufferSize);
+
+	// replication: the server captures one quantized snapshot of the bodies with a network id per tick,
+	// then encodes it for every client against the last snapshot that client acknowledged.
+	// the client decodes against its copy of that baseline, gets the new snapshot to keep as the next
+	// baseline and the bodies are moved to it. a NULL baseline sends the full state.
+	// all calls return the bytes written, zero when a buffer is too small or the data does not match
+	void SetReplicationPrecision(dFloat positionPrecision, dFloat velocityPrecision);
+	int GetReplicationStateSize() const;
+	int CaptureReplicationState(void* const snapshot, int snapshotSize);
+	int EncodeDelta(const void* const baseline, int baselineSize, const void* const snapshot, int snapshotSize, void* const delta, int deltaSize) const;
+	int ApplyDelta(const void* const baseline, int baselineSize, const void* const delta, int deltaSize, void* const snapshot, int snapshotSize);
+
 	long long GetMaterialKey(int materialID0, int materialID1) const;
 	void SetDefaultMaterial(float restitution, float staticFriction, float kineticFriction, bool collisionEnable);
 	void SetMaterialInteraction(int materialID0, int materialID1, float restitution, float staticFriction, float kineticFriction, bool collisionEnable);
@@ -114,11 +229,97 @@ class dNewtonWorld: public dAlloc
 	static float rayFilterCallback(const NewtonBody* const body, const NewtonCollision* const shapeHit, const dFloat* const hitContact, const dFloat* const hitNormal, dLong collisionID, void* const userData, dFloat intersectParam);
 	static unsigned rayPreFilterCallback(const NewtonBody* const body, const NewtonCollision* const collision, void* const userData);
 
+	// body command buffer: adds and removes issued while a step is running are recorded
+	// and applied together at the next safe point, so spawning never stalls the caller.
+	// DestroyBody takes ownership of the wrapper and deletes it once newton let go of it.
+	void DestroyBody(dNewtonBody* const ownedBody);
+	void WaitForUpdateToFinish();
+
+	// builds count bodies from a contiguous dNewtonBodyDesc array in one call,
+	// bodiesOut receives one dNewtonBody pointer per descriptor
+	void CreateBodies(const void* const descriptors, int count, void* const bodiesOut);
+
+	// memory and object counters, the contact count walks every body, so this is not meant for every frame.
+	// joints are the ones created through the wrapper and not yet destroyed, a growing count is a leak
+	void* GetMemoryStats();
+
+	// per step timings and counts, collecting them costs a few clock reads and atomic adds per step
+	void SetProfiling(bool mode);
+	void* GetStepProfile();
+
+	// records the update and every callback into a ring of eventCount events, zero turns tracing off.
+	// SaveTrace writes the ring as chrome trace json (chrome://tracing, perfetto, tracy import)
+	void SetTracing(int eventCount);
+	bool SaveTrace(const char* const fileName);
+
 	dNewtonVehicleManager* GetVehicleManager() const;
+
+	// the scene file keeps the wrapper data of every body next to newton's own: scene id, network id,
+	// material and layer of each shape, behind a versioned header. loading adds the bodies with their
+	// shapes already built, the game claims each one by scene id and takes ownership of it.
+	// files saved before the header, like Demos/scene_01.bin, still load: their bodies have no ids and
+	// default materials, and TakeSerializedBody hands them out in file order, which is the order the
+	// scene created them in. a legacy scene with bodies that never claim, vehicles and kinematic bodies,
+	// binds out of step and has to be saved again. bodies nobody claimed are deleted by ReleaseSerializedBodies
 	void SaveSerializedScene(char* const sceneName);
+	bool LoadSerializedScene(const char* const sceneName);
+	dNewtonBody* TakeSerializedBody(int sceneID);
+	void ReleaseSerializedBodies();
+
+	// splits a dynamic compound body in one step. childGroups holds a group per compound child in node order,
+	// children in group zero or past the array stay with the body, every other group becomes a new body that
+	// keeps the velocity its children had and takes a share of the mass by volume. the body keeps at least one
+	// child or nothing happens. returns the number of new bodies, the game claims each with TakeFracturedBody
+	// and owns it right away, bodies nobody claimed are deleted at the next safe point of UpdateWorld
+	int FractureBody(dNewtonBody* const body, const int* const childGroups, int childCount);
+	dNewtonBody* TakeFracturedBody(int group);
+	void ReleaseFracturedBodies();
+
+	// release the shared shape prototypes, shapes already in use keep their geometry alive
+	void FlushShapeCache();
 
 	private:
+	class dCachedShape
+	{
+		public:
+		dNewtonShapeKey m_key;
+		NewtonCollision* m_shape;
+	};
+
+	class dPendingChild
+	{
+		public:
+		NewtonCollision* m_parent;
+		const dNewtonCollision* m_child;
+	};
+
 	void UpdateWorld();
+	void ApplyPendingCommands();
+	void UpdateKinematicBodies();
+	void CollectStepProfile();
+	static int OnIslandUpdate(const NewtonWorld* const world, const void* islandHandle, int bodyCount);
+	static void OnPreUpdate(const NewtonWorld* const world, void* const listenerUserData, dFloat timestep);
+	static void OnPostUpdate(const NewtonWorld* const world, void* const listenerUserData, dFloat timestep);
+	static void OnBodySerialize(NewtonBody* const body, void* const userData, NewtonSerializeCallback function, void* const serializeHandle);
+	static void OnBodyDeserialize(NewtonBody* const body, void* const userData, NewtonDeserializeCallback function, void* const serializeHandle);
+	static dNewtonSerializedShape GetShapeData(const NewtonCollision* const shape);
+	void DestroySavedJoints(NewtonBody* const body);
+
+	NewtonCollision* FindCachedShape(const dNewtonShapeKey& key) const;
+	bool AddCachedShape(const dNewtonShapeKey& key, NewtonCollision* const shape);
+	NewtonCollision* CreateCachedShape(const dNewtonShapeKey& key, dNewtonCreateShape create, const void* const data, int sizeInBytes);
+
+	// the built shape takes the offset, scale, mode and user data of the stand in, which is destroyed
+	NewtonCollision* CommitShapeBuild(const dNewtonShapeBuild& build, NewtonCollision* const standIn);
+	void CommitPendingShapes();
+
+	// a child still waiting for its shape joins its compound or scene once it is built
+	void AddPendingChild(NewtonCollision* const parent, const dNewtonCollision* const child);
+	void CommitPendingChildren();
+	void CancelPendingShape(dNewtonCollision* const collision);
+	void ReleaseShape(NewtonCollision* const shape);
+	void DetachPendingCollision(dNewtonCollision* const collision);
+	const char* GetZeroAttributes(int count);
 
 	const dMaterialProperties& FindMaterial(int id0, int id1) const;
 	static void OnContactCollision(const NewtonJoint* contactJoint, dFloat timestep, int threadIndex);
@@ -127,6 +328,36 @@ class dNewtonWorld: public dAlloc
 
 	NewtonWorld* m_world;
 	dList<dNewtonCollision*> m_collisionCache;
+	dTree<dCachedShape, unsigned long long> m_shapeCache;
+	dList<NewtonCollision*> m_shapeReleaseQueue;
+	dList<dNewtonCollision*> m_shapeCommitQueue;
+	dList<dPendingChild> m_pendingChildren;
+	NewtonCollision* m_shapeStandIn;
+	dList<dNewtonBody*> m_bodyAddQueue;
+	dList<dNewtonBody*> m_bodyRemoveQueue;
+	dList<dNewtonKinematicBody*> m_kinematicMovers;
+	dTree<dNewtonBody*, int> m_networkBodies;
+	dTree<dNewtonBody*, int> m_serializedBodies;
+	dList<dNewtonBody*> m_legacyBodies;
+	dTree<dNewtonBody*, int> m_fracturedBodies;
+	char* m_zeroAttributes;
+	int m_zeroAttributesCount;
+	dNewtonMemoryStats m_memoryStats;
+	dNewtonStepProfile m_stepProfile;
+	dNewtonTrace* m_trace;
+	int m_allocSlot;
+	int m_solverSavedTag;
+	int m_jointCount;
+	int m_contactJointCounter;
+	int m_islandCounter;
+	int m_islandBodyCounter;
+	int m_threadCount;
+	dFloat m_replicationPositionPrecision;
+	dFloat m_replicationVelocityPrecision;
+	long long m_stepIndex;
+	bool m_profiling;
+	bool m_deterministic;
+	long long m_stateHash;
 	dTree<dMaterialProperties, long long> m_materialGraph;
 	dLong m_realTimeInMicroSeconds;
 	dLong m_timeStepInMicroSeconds;
@@ -136,6 +367,7 @@ class dNewtonWorld: public dAlloc
 
 	dVector  m_gravity;
 	bool m_asyncUpdateMode;
+	bool m_updateInFlight;
 	OnWorldUpdateCallback m_onUpdateCallback;
 	OnWorldBodyTransfromUpdateCallback m_onTransformCallback;
 	dMaterialProperties m_defaultMaterial;
@@ -144,11 +376,17 @@ class dNewtonWorld: public dAlloc
 	rayHitInfo hitInfo;
 
 	friend class dNewtonBody;
+	friend class dNewtonJoint;
 	friend class dNewtonCollision;
 	friend class dNewtonDynamicBody;
 	friend class dNewtonCollisionBox;
 	friend class dNewtonKinematicBody;
 	friend class dNewtonCollisionMesh;
+	friend class dNewtonCollisionCooked;
+	friend class dNewtonCollisionSharedMesh;
+	friend class dNewtonCollisionChunkedMesh;
+	friend class dNewtonWorldPartition;
+	friend class dNewtonCollisionTiledHeightField;
 	friend class dNewtonCollisionNull;
 	friend class dNewtonCollisionCone;
 	friend class dNewtonCollisionScene;
@@ -0,0 +1,376 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "stdafx.h"
+#include "dNewtonBody.h"
+#include "dNewtonWorld.h"
+#include "dNewtonCollision.h"
+#include "dNewtonSharedGeometry.h"
+#include "dNewtonWorldPartition.h"
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// wraps the shape of a resident chunk, contacts read the material and layer of the scene child from it
+class dNewtonPartitionShape: public dNewtonCollision
+{
+	public:
+	dNewtonPartitionShape(dNewtonWorld* const world, NewtonCollision* const shape, int materialID, int layer)
+		:dNewtonCollision(world, 0)
+	{
+		SetShape(shape);
+		m_materialID = materialID;
+		m_layer = layer;
+	}
+};
+
+class dNewtonPartitionChunk: public dAlloc
+{
+	public:
+	enum dState
+	{
+		m_unloaded,
+		m_loading,
+		m_ready,
+		m_resident,
+		m_failed,
+	};
+
+	dNewtonPartitionChunk(const char* const fileName, const dVector& minBox, const dVector& maxBox, int materialID, int layer)
+		:dAlloc()
+		,m_fileName(new char[strlen(fileName) + 1])
+		,m_minBox(minBox)
+		,m_maxBox(maxBox)
+		,m_geometry(NULL)
+		,m_collision(NULL)
+		,m_sceneNode(NULL)
+		,m_materialID(materialID)
+		,m_layer(layer)
+		,m_state(m_unloaded)
+		,m_cancel(false)
+	{
+		strcpy(m_fileName, fileName);
+	}
+
+	~dNewtonPartitionChunk()
+	{
+		dAssert(!m_geometry && !m_collision);
+		delete[] m_fileName;
+	}
+
+	void ReleaseGeometry()
+	{
+		if (m_geometry) {
+			m_geometry->Release();
+			m_geometry = NULL;
+		}
+	}
+
+	char* m_fileName;
+	dVector m_minBox;
+	dVector m_maxBox;
+	// written by the loader thread, read by the main thread only after the loader handed the chunk back
+	dNewtonSharedGeometry* m_geometry;
+	dNewtonPartitionShape* m_collision;
+	void* m_sceneNode;
+	int m_materialID;
+	int m_layer;
+	dState m_state;
+	bool m_cancel;
+};
+
+// one background thread that maps and validates chunk files, so page faults and disk reads never hit the step
+class dNewtonPartitionLoader: public dAlloc
+{
+	public:
+	dNewtonPartitionLoader()
+		:dAlloc()
+		,m_requests()
+		,m_done()
+		,m_lock()
+		,m_wakeUp()
+		,m_thread()
+		,m_quit(false)
+	{
+		m_thread = std::thread(&dNewtonPartitionLoader::Run, this);
+	}
+
+	~dNewtonPartitionLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_quit = true;
+		}
+		m_wakeUp.notify_one();
+		m_thread.join();
+	}
+
+	void Request(dNewtonPartitionChunk* const chunk)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_requests.Append(chunk);
+		}
+		m_wakeUp.notify_one();
+	}
+
+	void CollectDone(dList<dNewtonPartitionChunk*>& chunks)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		while (m_done.GetFirst()) {
+			chunks.Append(m_done.GetFirst()->GetInfo());
+			m_done.Remove(m_done.GetFirst());
+		}
+	}
+
+	private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		for (;;) {
+			m_wakeUp.wait(lock, [this]() { return m_quit || m_requests.GetFirst(); });
+			if (m_quit) {
+				break;
+			}
+
+			dNewtonPartitionChunk* const chunk = m_requests.GetFirst()->GetInfo();
+			m_requests.Remove(m_requests.GetFirst());
+			lock.unlock();
+			chunk->m_geometry = dNewtonSharedGeometry::Acquire(chunk->m_fileName);
+			lock.lock();
+			m_done.Append(chunk);
+		}
+	}
+
+	dList<dNewtonPartitionChunk*> m_requests;
+	dList<dNewtonPartitionChunk*> m_done;
+	std::mutex m_lock;
+	std::condition_variable m_wakeUp;
+	std::thread m_thread;
+	bool m_quit;
+};
+
+
+dNewtonWorldPartition::dNewtonWorldPartition(dNewtonWorld* const world, dNewtonCollisionScene* const scene, dFloat loadRadius, dFloat unloadRadius, int maxChunksPerUpdate)
+	:dAlloc()
+	,m_world(world)
+	,m_scene(scene)
+	,m_loader(new dNewtonPartitionLoader())
+	,m_chunks()
+	,m_readyList()
+	,m_loadRadius(loadRadius)
+	,m_unloadRadius(dMax(loadRadius, unloadRadius))
+	,m_focusCount(0)
+	,m_maxChunksPerUpdate(dMax(maxChunksPerUpdate, 1))
+	,m_residentCount(0)
+	,m_pendingCount(0)
+{
+}
+
+dNewtonWorldPartition::~dNewtonWorldPartition()
+{
+	// the loader finishes the file it is on, requests it did not start come back without geometry
+	delete m_loader;
+
+	bool sceneChanged = false;
+	dTree<dNewtonPartitionChunk*, int>::Iterator iter(m_chunks);
+	for (iter.Begin(); iter; iter++) {
+		dNewtonPartitionChunk* const chunk = iter.GetNode()->GetInfo();
+		if (chunk->m_state == dNewtonPartitionChunk::m_resident) {
+			if (!sceneChanged) {
+				m_world->WaitForUpdateToFinish();
+				m_scene->BeginAddRemoveCollision();
+				sceneChanged = true;
+			}
+			m_scene->RemoveCollision(chunk->m_sceneNode);
+			delete chunk->m_collision;
+			chunk->m_collision = NULL;
+		}
+		chunk->ReleaseGeometry();
+		delete chunk;
+	}
+	if (sceneChanged) {
+		m_scene->EndAddRemoveCollision();
+		RefreshSceneBody();
+	}
+}
+
+int dNewtonWorldPartition::AddChunk(const char* const fileName, const dVector minBox, const dVector maxBox, int materialID, int layer)
+{
+	const int chunkID = m_chunks.GetCount();
+	m_chunks.Insert(new dNewtonPartitionChunk(fileName, minBox, maxBox, materialID, layer), chunkID);
+	return chunkID;
+}
+
+void dNewtonWorldPartition::ClearFocusPoints()
+{
+	m_focusCount = 0;
+}
+
+void dNewtonWorldPartition::AddFocusPoint(dFloat x, dFloat y, dFloat z)
+{
+	if (m_focusCount < D_PARTITION_MAX_FOCUS_POINTS) {
+		m_focusPoints[m_focusCount] = dVector(x, y, z, 0.0f);
+		m_focusCount++;
+	}
+}
+
+bool dNewtonWorldPartition::IsChunkResident(int chunkID) const
+{
+	dTree<dNewtonPartitionChunk*, int>::dTreeNode* const node = m_chunks.Find(chunkID);
+	return node && (node->GetInfo()->m_state == dNewtonPartitionChunk::m_resident);
+}
+
+int dNewtonWorldPartition::GetResidentCount() const
+{
+	return m_residentCount;
+}
+
+int dNewtonWorldPartition::GetPendingCount() const
+{
+	return m_pendingCount;
+}
+
+dFloat dNewtonWorldPartition::DistanceSquared(const dNewtonPartitionChunk& chunk) const
+{
+	// distance from the closest focus point to the chunk box, zero inside the box
+	dFloat dist2 = 1.0e20f;
+	for (int i = 0; i < m_focusCount; i++) {
+		const dVector& point = m_focusPoints[i];
+		dFloat sum = 0.0f;
+		for (int j = 0; j < 3; j++) {
+			const dFloat offset = dMax(dMax(chunk.m_minBox[j] - point[j], point[j] - chunk.m_maxBox[j]), dFloat(0.0f));
+			sum += offset * offset;
+		}
+		dist2 = dMin(dist2, sum);
+	}
+	return dist2;
+}
+
+void dNewtonWorldPartition::RefreshSceneBody()
+{
+	NewtonBody* const body = m_scene->m_ownerBody;
+	if (body) {
+		dNewtonBody::RefreshBroadphaseBounds(body);
+	}
+}
+
+void dNewtonWorldPartition::Update()
+{
+	const dFloat load2 = m_loadRadius * m_loadRadius;
+	const dFloat unload2 = m_unloadRadius * m_unloadRadius;
+
+	dList<dNewtonPartitionChunk*> unloadList;
+	dTree<dNewtonPartitionChunk*, int>::Iterator iter(m_chunks);
+	for (iter.Begin(); iter; iter++) {
+		dNewtonPartitionChunk* const chunk = iter.GetNode()->GetInfo();
+		const dFloat dist2 = DistanceSquared(*chunk);
+		switch (chunk->m_state)
+		{
+			case dNewtonPartitionChunk::m_unloaded:
+			{
+				if (dist2 <= load2) {
+					chunk->m_state = dNewtonPartitionChunk::m_loading;
+					chunk->m_cancel = false;
+					m_pendingCount++;
+					m_loader->Request(chunk);
+				}
+				break;
+			}
+
+			case dNewtonPartitionChunk::m_loading:
+			case dNewtonPartitionChunk::m_ready:
+			{
+				// a chunk the focus left while it was loading is dropped when it comes back
+				chunk->m_cancel = (dist2 > unload2);
+				break;
+			}
+
+			case dNewtonPartitionChunk::m_resident:
+			{
+				if (dist2 > unload2) {
+					unloadList.Append(chunk);
+				}
+				break;
+			}
+
+			case dNewtonPartitionChunk::m_failed:
+				break;
+		}
+	}
+
+	dList<dNewtonPartitionChunk*> doneList;
+	m_loader->CollectDone(doneList);
+	for (dList<dNewtonPartitionChunk*>::dListNode* node = doneList.GetFirst(); node; node = node->GetNext()) {
+		dNewtonPartitionChunk* const chunk = node->GetInfo();
+		if (!chunk->m_geometry) {
+			// a missing or damaged file is not tried again every frame
+			chunk->m_state = dNewtonPartitionChunk::m_failed;
+			m_pendingCount--;
+		} else {
+			chunk->m_state = dNewtonPartitionChunk::m_ready;
+			m_readyList.Append(chunk);
+		}
+	}
+
+	// ready chunks past the budget wait for the next update, so a fast camera never causes one long stall
+	dList<dNewtonPartitionChunk*> addList;
+	while (m_readyList.GetFirst() && (addList.GetCount() < m_maxChunksPerUpdate)) {
+		dNewtonPartitionChunk* const chunk = m_readyList.GetFirst()->GetInfo();
+		m_readyList.Remove(m_readyList.GetFirst());
+		m_pendingCount--;
+		if (chunk->m_cancel) {
+			chunk->ReleaseGeometry();
+			chunk->m_state = dNewtonPartitionChunk::m_unloaded;
+		} else {
+			addList.Append(chunk);
+		}
+	}
+
+	if (!addList.GetCount() && !unloadList.GetCount()) {
+		return;
+	}
+
+	m_world->WaitForUpdateToFinish();
+	m_scene->BeginAddRemoveCollision();
+	for (dList<dNewtonPartitionChunk*>::dListNode* node = unloadList.GetFirst(); node; node = node->GetNext()) {
+		dNewtonPartitionChunk* const chunk = node->GetInfo();
+		m_scene->RemoveCollision(chunk->m_sceneNode);
+		delete chunk->m_collision;
+		chunk->m_collision = NULL;
+		chunk->m_sceneNode = NULL;
+		chunk->m_state = dNewtonPartitionChunk::m_unloaded;
+		m_residentCount--;
+	}
+
+	for (dList<dNewtonPartitionChunk*>::dListNode* node = addList.GetFirst(); node; node = node->GetNext()) {
+		// the shape holds its own reference to the mapping, the chunk lets go of the loader's one
+		dNewtonPartitionChunk* const chunk = node->GetInfo();
+		NewtonCollision* const shape = chunk->m_geometry->CreateShape(m_world->m_world);
+		chunk->ReleaseGeometry();
+		chunk->m_collision = new dNewtonPartitionShape(m_world, shape, chunk->m_materialID, chunk->m_layer);
+		chunk->m_sceneNode = m_scene->AddCollision(chunk->m_collision);
+		chunk->m_state = dNewtonPartitionChunk::m_resident;
+		m_residentCount++;
+	}
+	m_scene->EndAddRemoveCollision();
+	RefreshSceneBody();
+}
@@ -0,0 +1,76 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef _D_NEWTON_WORLD_PARTITION_H_
+#define _D_NEWTON_WORLD_PARTITION_H_
+
+#include "stdafx.h"
+#include "dAlloc.h"
+
+class dNewtonWorld;
+class dNewtonCollisionScene;
+class dNewtonPartitionChunk;
+class dNewtonPartitionLoader;
+
+#define D_PARTITION_MAX_FOCUS_POINTS	8
+
+// streams the static chunks of a scene body in and out around a few focus points. every chunk is a
+// geometry file cooked with dNewtonCollisionSharedMesh, a background thread maps and validates it and
+// the scene only takes it at Update, so the world never waits on the disk. chunks load inside the load
+// radius and leave past the unload radius, the gap between the two keeps a chunk on the border from flipping
+class dNewtonWorldPartition: public dAlloc
+{
+	public:
+	dNewtonWorldPartition(dNewtonWorld* const world, dNewtonCollisionScene* const scene, dFloat loadRadius, dFloat unloadRadius, int maxChunksPerUpdate);
+	virtual ~dNewtonWorldPartition();
+
+	// returns the chunk id, materials and layers apply to every face of the chunk
+	int AddChunk(const char* const fileName, const dVector minBox, const dVector maxBox, int materialID, int layer);
+
+	void ClearFocusPoints();
+	void AddFocusPoint(dFloat x, dFloat y, dFloat z);
+
+	// call once per frame from the thread that updates the world. chunks the loader finished are added
+	// to the scene, at most maxChunksPerUpdate of them, and chunks past the unload radius are removed
+	void Update();
+
+	bool IsChunkResident(int chunkID) const;
+	int GetResidentCount() const;
+	int GetPendingCount() const;
+
+	private:
+	dFloat DistanceSquared(const dNewtonPartitionChunk& chunk) const;
+	void RefreshSceneBody();
+
+	dNewtonWorld* m_world;
+	dNewtonCollisionScene* m_scene;
+	dNewtonPartitionLoader* m_loader;
+	dTree<dNewtonPartitionChunk*, int> m_chunks;
+	dList<dNewtonPartitionChunk*> m_readyList;
+	dVector m_focusPoints[D_PARTITION_MAX_FOCUS_POINTS];
+	dFloat m_loadRadius;
+	dFloat m_unloadRadius;
+	int m_focusCount;
+	int m_maxChunksPerUpdate;
+	int m_residentCount;
+	int m_pendingCount;
+};
+
+#endif